@@ -44,6 +44,12 @@ Copyright (c) 1995-2000 Andrew Johnson
 #define CAN_IDENTIFIERS 2048
 #define CAN_DATA_SIZE 8
 
+/* 29-bit extended identifiers are flagged with CAN_EXTENDED */
+#define CAN_EXTENDED 0x80000000
+#define CAN_EXT_IDENTIFIERS 0x20000000
+#define CAN_ID_VALID(id) (((id) & CAN_EXTENDED) ? \
+	((id) & ~CAN_EXTENDED) < CAN_EXT_IDENTIFIERS : (id) < CAN_IDENTIFIERS)
+
 #define CAN_BUS_OK 0
 #define CAN_BUS_ERROR 1
 #define CAN_BUS_OFF 2
@@ -58,11 +64,11 @@ Copyright (c) 1995-2000 Andrew Johnson
 #define S_can_noDevice		(M_can| 3) /*CAN bus name does not exist*/
 #define S_can_noMessage 	(M_can| 4) /*no matching CAN message callback*/
 
-typedef epicsUInt16 canID_t;
+typedef epicsUInt32 canID_t;
 typedef struct canBusID_s *canBusID_t;
 
 typedef struct {
-    canID_t identifier;		/* 0 .. 2047 with holes! */
+    canID_t identifier;		/* 0 .. 2047 with holes, or CAN_EXTENDED | ID */
     enum {
 	SEND = 0, RTR = 1
     } rtr;			/* Remote Transmission Request */
@@ -94,6 +100,10 @@ epicsShareFunc int canBusRestart(const char *busName);
 epicsShareFunc int canRead(canBusID_t busID, canMessage_t *pmessage, double timeout);
 epicsShareFunc int canWrite(canBusID_t busID, const canMessage_t *pmessage,
 		    double timeout);
+epicsShareFunc int canCyclic(canBusID_t busID, const canMessage_t *pmessage,
+		     double period, double phase);
+epicsShareFunc int canCyclicUpdate(canBusID_t busID,
+			   const canMessage_t *pmessage);
 epicsShareFunc int canMessage(canBusID_t busID, canID_t identifier,
 		      canMsgCallback_t callback, void *pprivate);
 epicsShareFunc int canMsgDelete(canBusID_t busID, canID_t identifier,
@@ -101,6 +111,7 @@ epicsShareFunc int canMsgDelete(canBusID_t busID, canID_t identifier,
 epicsShareFunc int canSignal(canBusID_t busID, canSigCallback_t callback,
 		     void *pprivate);
 epicsShareFunc int canIoParse(char *canString, canIo_t *pcanIo);
+epicsShareFunc void *canBusAlloc(canBusID_t busID, size_t size);
 
 
 #endif /* INCcanBusH */
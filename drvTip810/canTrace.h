@@ -0,0 +1,83 @@
+/*******************************************************************************
+
+Project:
+    CAN Bus Driver for EPICS
+
+File:
+    canTrace.h
+
+Description:
+    CANbus trace buffer entry and dump file formats
+
+Author:
+    Andrew Johnson <Andrew.N.Johnson@gmail.com>
+Created:
+    18 October 2026
+
+Copyright (c) 1995-2000 Andrew Johnson
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*******************************************************************************/
+
+
+#ifndef INCcanTraceH
+#define INCcanTraceH
+
+#include "epicsTypes.h"
+#include "canBus.h"
+
+
+/* A trace file holds one canTraceHeader_t followed by header.entries
+ * canTraceEntry_t structures, oldest first.  Everything is written in
+ * the byte order of the IOC; readers detect this from the magic number.
+ */
+
+#define CAN_TRACE_MAGIC 	0x43414e54	/* "CANT" */
+#define CAN_TRACE_VERSION	1
+
+/* Entry types, in the low bits of canTraceEntry_t.type */
+
+#define CAN_TRACE_RX		0	/* message received */
+#define CAN_TRACE_TX		1	/* message transmitted */
+#define CAN_TRACE_EVENT 	2	/* bus error state change */
+#define CAN_TRACE_TYPE		0x03	/* mask for the above */
+#define CAN_TRACE_RTR		0x80	/* flag, remote transmission request */
+
+typedef struct canTraceEntry_s {
+    epicsUInt64 stamp;		/* epicsMonotonicGet() time in ns */
+    epicsUInt32 identifier;	/* CAN identifier incl. CAN_EXTENDED flag */
+    epicsUInt8 type;		/* CAN_TRACE_xx plus flags */
+    epicsUInt8 length;		/* data length code */
+    epicsUInt8 status;		/* controller interrupt/status bits */
+    epicsUInt8 event;		/* CAN_BUS_xx for CAN_TRACE_EVENT */
+    epicsUInt8 data[CAN_DATA_SIZE];
+} canTraceEntry_t;
+
+typedef struct canTraceHeader_s {
+    epicsUInt32 magic;		/* CAN_TRACE_MAGIC */
+    epicsUInt16 version;	/* CAN_TRACE_VERSION */
+    epicsUInt16 entrySize;	/* sizeof(canTraceEntry_t) */
+    epicsUInt32 entries;	/* number of entries in the file */
+    epicsUInt32 lost;		/* older entries overwritten */
+    epicsInt32 busRate;		/* Kbits/sec, as given to t810Create */
+    epicsUInt32 refSec;		/* wall clock time at refStamp, */
+    epicsUInt32 refNsec;	/*  an epicsTimeStamp */
+    epicsUInt32 spare;
+    epicsUInt64 refStamp;	/* epicsMonotonicGet() at dump time */
+    char busName[32];
+} canTraceHeader_t;
+
+#endif /* INCcanTraceH */
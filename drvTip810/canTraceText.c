@@ -0,0 +1,182 @@
+/*******************************************************************************
+
+Project:
+    CAN Bus Driver for EPICS
+
+File:
+    canTraceText.c
+
+Description:
+    Host program to convert a CANbus trace dump file into text
+
+Author:
+    Andrew Johnson <Andrew.N.Johnson@gmail.com>
+Created:
+    18 October 2026
+
+Copyright (c) 1995-2000 Andrew Johnson
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epicsTypes.h>
+#include <epicsTime.h>
+
+#include "canBus.h"
+#include "canTrace.h"
+
+
+static int swapped;
+
+static epicsUInt16 get16(epicsUInt16 value) {
+    if (!swapped) return value;
+    return (epicsUInt16) ((value >> 8) | (value << 8));
+}
+
+static epicsUInt32 get32(epicsUInt32 value) {
+    if (!swapped) return value;
+    return (value >> 24) | ((value >> 8) & 0xff00) |
+	   ((value << 8) & 0xff0000) | (value << 24);
+}
+
+static epicsUInt64 get64(epicsUInt64 value) {
+    if (!swapped) return value;
+    return ((epicsUInt64) get32((epicsUInt32) value) << 32) |
+	   get32((epicsUInt32) (value >> 32));
+}
+
+int main (
+    int argc,
+    char *argv[]
+) {
+    static const char *typeName[] = { "Rx", "Tx", "Event", "?" };
+    static const char *eventName[] = { "Bus OK", "Bus Error", "Bus Off" };
+    canTraceHeader_t header;
+    canTraceEntry_t entry;
+    epicsTimeStamp ref;
+    epicsUInt64 refStamp, first = 0, prev = 0;
+    FILE *in, *out = stdout;
+    epicsUInt32 n, entries;
+    int i;
+
+    if (argc < 2 || argc > 3) {
+	fprintf(stderr, "Usage: %s tracefile [textfile]\n", argv[0]);
+	return 1;
+    }
+
+    in = fopen(argv[1], "rb");
+    if (in == NULL) {
+	perror(argv[1]);
+	return 1;
+    }
+    if (fread(&header, sizeof(header), 1, in) != 1) {
+	fprintf(stderr, "%s: Can't read trace header\n", argv[1]);
+	return 1;
+    }
+
+    /* Files are written in the IOC's byte order */
+    swapped = (header.magic != CAN_TRACE_MAGIC);
+    if (get32(header.magic) != CAN_TRACE_MAGIC ||
+	get16(header.version) != CAN_TRACE_VERSION ||
+	get16(header.entrySize) != sizeof(canTraceEntry_t)) {
+	fprintf(stderr, "%s: Not a version %d CAN trace file\n",
+		argv[1], CAN_TRACE_VERSION);
+	return 1;
+    }
+
+    if (argc == 3) {
+	out = fopen(argv[2], "w");
+	if (out == NULL) {
+	    perror(argv[2]);
+	    return 1;
+	}
+    }
+
+    entries = get32(header.entries);
+    ref.secPastEpoch = get32(header.refSec);
+    ref.nsec = get32(header.refNsec);
+    refStamp = get64(header.refStamp);
+    header.busName[sizeof(header.busName) - 1] = '\0';
+
+    fprintf(out, "# CAN bus '%s', %d Kbits/sec, %u entries, %u lost\n",
+	    header.busName, (int) get32((epicsUInt32) header.busRate),
+	    entries, get32(header.lost));
+    fprintf(out, "# Time                          Delta(us)  Type   "
+	    "ID     DLC  Data                     Status\n");
+
+    for (n = 0; n < entries; n++) {
+	epicsTimeStamp when = ref;
+	epicsUInt64 stamp;
+	char timeText[40];
+	int type;
+
+	if (fread(&entry, sizeof(entry), 1, in) != 1) {
+	    fprintf(stderr, "%s: File truncated after %u entries\n",
+		    argv[1], n);
+	    break;
+	}
+	stamp = get64(entry.stamp);
+	if (n == 0) first = prev = stamp;
+
+	epicsTimeAddSeconds(&when, ((double) stamp - (double) refStamp) / 1e9);
+	epicsTimeToStrftime(timeText, sizeof(timeText),
+			    "%Y/%m/%d %H:%M:%S.%06f", &when);
+
+	type = entry.type & CAN_TRACE_TYPE;
+	fprintf(out, "%s %10.1f  %-5s  ", timeText,
+		(double) (stamp - prev) / 1000.0, typeName[type]);
+
+	if (type == CAN_TRACE_EVENT) {
+	    fprintf(out, "%-39s", entry.event <= CAN_BUS_OFF ?
+		    eventName[entry.event] : "Unknown");
+	} else {
+	    epicsUInt32 id = get32(entry.identifier);
+
+	    if (id & CAN_EXTENDED) {
+		fprintf(out, "0x%08xX  %u    ", id & ~CAN_EXTENDED,
+			entry.length);
+	    } else {
+		fprintf(out, "0x%03x  %u    ", id, entry.length);
+	    }
+	    if (entry.type & CAN_TRACE_RTR) {
+		fprintf(out, "%-24s ", "RTR");
+	    } else {
+		for (i = 0; i < CAN_DATA_SIZE; i++) {
+		    if (i < entry.length)
+			fprintf(out, "%02x ", entry.data[i]);
+		    else
+			fprintf(out, "   ");
+		}
+		fprintf(out, " ");
+	    }
+	}
+	fprintf(out, "0x%02x\n", entry.status);
+	prev = stamp;
+    }
+
+    if (entries > 1) {
+	fprintf(out, "# Trace spans %.6f seconds\n",
+		(double) (prev - first) / 1e9);
+    }
+
+    fclose(in);
+    if (out != stdout) fclose(out);
+    return 0;
+}
@@ -57,6 +57,7 @@ Copyright (c) 1995-2000 Andrew Johnson
 #include <epicsExport.h>
 
 #include "canBus.h"
+#include "devCan.h"
 
 
 #define CONVERT 0
@@ -64,8 +65,9 @@ Copyright (c) 1995-2000 Andrew Johnson
 
 
 typedef struct aiCanPrivate_s {
-    CALLBACK callback;
+    devCanRequest_t request;
     struct aiCanPrivate_s *nextPrivate;
+    devCanBus_t *pbus;
     epicsTimerId timId;
     IOSCANPVT ioscanpvt;
     dbCommon *prec;
@@ -77,21 +79,11 @@ typedef struct aiCanPrivate_s {
     int status;
 } aiCanPrivate_t;
 
-typedef struct aiCanBus_s {
-    CALLBACK callback;
-    struct aiCanBus_s *nextBus;
-    aiCanPrivate_t *firstPrivate;
-    void *canBusID;
-    int status;
-} aiCanBus_t;
-
 static long init_ai(struct dbCommon *prec);
 static long get_ioint_info(int cmd, struct dbCommon *prec, IOSCANPVT *ppvt);
 static long read_ai(struct aiRecord *prec);
 static long special_linconv(struct aiRecord *prec, int after);
-static void ProcessCallback(CALLBACK *pcallback);
 static void aiMessage(void *private, const canMessage_t *pmessage);
-static void busSignal(void *private, int status);
 static void busCallback(CALLBACK *pCallback);
 
 #ifndef HAS_aidset
@@ -114,15 +106,14 @@ aidset devAiCan = {
 };
 epicsExportAddress(dset, devAiCan);
 
-static aiCanBus_t *firstBus;
-
 
 static long init_ai (
     struct dbCommon *pcommon
 ) {
     struct aiRecord *prec = (struct aiRecord *) pcommon;
     aiCanPrivate_t *pcanAi;
-    aiCanBus_t *pbus;
+    devCanBus_t *pbus;
+    canIo_t inp;
     int status;
     epicsUInt32 fsd;
 
@@ -132,7 +123,11 @@ static long init_ai (
 	return S_db_badField;
     }
 
-    pcanAi = malloc(sizeof(aiCanPrivate_t));
+    /* Convert the address string into members of the canIo structure */
+    status = canIoParse(prec->inp.value.instio.string, &inp);
+
+    /* Allocate the private structure from the bus memory pool */
+    pcanAi = canBusAlloc(inp.canBusID, sizeof(aiCanPrivate_t));
     if (pcanAi == NULL) {
 	return S_dev_noMemory;
     }
@@ -140,9 +135,7 @@ static long init_ai (
     pcanAi->prec = (dbCommon *) prec;
     pcanAi->ioscanpvt = NULL;
     pcanAi->status = NO_ALARM;
-
-    /* Convert the address string into members of the canIo structure */
-    status = canIoParse(prec->inp.value.instio.string, &pcanAi->inp);
+    pcanAi->inp = inp;
     if (status) {
 	if (canSilenceErrors) {
 	    pcanAi->inp.canBusID = NULL;
@@ -210,39 +203,17 @@ static long init_ai (
 		fsd, prec->eslo, prec->roff, pcanAi->mask, pcanAi->sign);
     #endif
 
-    /* Find the bus matching this record */
-    for (pbus = firstBus; pbus != NULL; pbus = pbus->nextBus) {
-	if (pbus->canBusID == pcanAi->inp.canBusID) break;
-    }
-
-    /* If not found, create one */
-    if (pbus == NULL) {
-	pbus = malloc(sizeof (aiCanBus_t));
-	if (pbus == NULL) return S_dev_noMemory;
-
-	/* Fill it in */
-	pbus->firstPrivate = NULL;
-	pbus->canBusID = pcanAi->inp.canBusID;
-	callbackSetUser(pbus, &pbus->callback);
-	callbackSetCallback(busCallback, &pbus->callback);
-	callbackSetPriority(priorityMedium, &pbus->callback);
-
-	/* and add it to the list of busses we know about */
-	pbus->nextBus = firstBus;
-	firstBus = pbus;
-
-	/* Ask driver for error signals */
-	canSignal(pbus->canBusID, busSignal, pbus);
-    }
+    /* Find the bus matching this record, or create one */
+    pbus = devCanBusFind(pcanAi->inp.canBusID, busCallback);
+    if (pbus == NULL) return S_dev_noMemory;
+    pcanAi->pbus = pbus;
 
     /* Insert private record structure into linked list for this CANbus */
     pcanAi->nextPrivate = pbus->firstPrivate;
     pbus->firstPrivate = pcanAi;
 
-    /* Set the callback parameters for asynchronous processing */
-    callbackSetUser(prec, &pcanAi->callback);
-    callbackSetCallback(ProcessCallback, &pcanAi->callback);
-    callbackSetPriority(prec->prio, &pcanAi->callback);
+    /* Set the request parameters for asynchronous processing */
+    devCanRequestInit(&pcanAi->request, (dbCommon *) prec);
 
     /* and create a timer for CANbus RTR timeouts */
     pcanAi->timId = epicsTimerQueueCreateTimer(canTimerQ,
@@ -361,16 +332,6 @@ static long special_linconv (
     return 0;
 }
 
-static void ProcessCallback(CALLBACK *pcallback)
-{
-    dbCommon *pRec;
-
-    callbackGetUser(pRec, pcallback);
-    dbScanLock(pRec);
-    (*pRec->rset->process)(pRec);
-    dbScanUnlock(pRec);
-}
-
 static void aiMessage (
     void *private,
     const canMessage_t *pmessage
@@ -414,41 +375,18 @@ static void aiMessage (
 
     if (pcanAi->prec->scan == SCAN_IO_EVENT) {
 	pcanAi->status = NO_ALARM;
-	scanIoRequest(pcanAi->ioscanpvt);
+	devCanIoRequest(pcanAi->pbus, &pcanAi->request, pcanAi->ioscanpvt);
     } else if (pcanAi->status == TIMEOUT_ALARM) {
 	pcanAi->status = NO_ALARM;
 	epicsTimerCancel(pcanAi->timId);
-	callbackRequest(&pcanAi->callback);
-    }
-}
-
-static void busSignal (
-    void *private,
-    int status
-) {
-    aiCanBus_t *pbus = private;
-
-    if (!interruptAccept) return;
-
-    switch(status) {
-	case CAN_BUS_OK:
-	    pbus->status = NO_ALARM;
-	    break;
-	case CAN_BUS_ERROR:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
-	case CAN_BUS_OFF:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
+	devCanCallbackRequest(pcanAi->pbus, &pcanAi->request);
     }
 }
 
 static void busCallback (
     CALLBACK *pCallback
 ) {
-    aiCanBus_t *pbus;
+    devCanBus_t *pbus;
     aiCanPrivate_t *pcanAi;
 
     callbackGetUser(pbus, pCallback);
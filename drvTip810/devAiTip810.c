@@ -0,0 +1,218 @@
+/*******************************************************************************
+
+Project:
+    CAN Bus Driver for EPICS
+
+File:
+    devAiTip810.c
+
+Description:
+    TIP810 Latency and Bus Load Analogue Input device support
+
+Author:
+    Andrew Johnson <Andrew.N.Johnson@gmail.com>
+Created:
+    18 October 2026
+
+Copyright (c) 1995-2000 Andrew Johnson
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <epicsTypes.h>
+#include <dbDefs.h>
+#include <dbAccess.h>
+#include <recSup.h>
+#include <recGbl.h>
+#include <alarm.h>
+#include <devSup.h>
+#include <devLib.h>
+#include <aiRecord.h>
+#include <epicsExport.h>
+
+#include "canBus.h"
+#include "drvTip810.h"
+
+
+#define KIND_LATENCY	0
+#define KIND_LOAD	1
+
+typedef struct aiTip810Private_s {
+    canBusID_t busID;
+    int kind;		/* KIND_LATENCY or KIND_LOAD */
+    int stage;		/* latency stage or load direction */
+    int stat;		/* latency statistic or load period */
+} aiTip810Private_t;
+
+/* Create the dset for devAiTip810 */
+static long init_ai(struct dbCommon *prec);
+static long read_ai(struct aiRecord *prec);
+
+#ifndef HAS_aidset
+typedef struct {
+    dset common;
+    long (*read_ai)(struct aiRecord *prec);
+    long (*special_linconv)(struct aiRecord *prec, int after);
+} aidset;
+#endif
+aidset devAiTip810 = {
+    {
+        6,
+        NULL,
+        NULL,
+        init_ai,
+        NULL
+    },
+    read_ai,
+    NULL
+};
+epicsExportAddress(dset, devAiTip810);
+
+static long init_ai(
+    struct dbCommon *pcommon
+) {
+    static const struct {
+	char	*string;
+	int	kind;
+	int	value;
+    } tipStage[] = {
+	{ "RX_QUEUE",	KIND_LATENCY,	T810_LAT_RX_QUEUE },
+	{ "RX_CALLBACK",	KIND_LATENCY,	T810_LAT_RX_CALLBACK },
+	{ "RTR_REPLY",	KIND_LATENCY,	T810_LAT_RTR_REPLY },
+	{ "TX_COMPLETE",	KIND_LATENCY,	T810_LAT_TX_COMPLETE },
+	{ "ISR",	KIND_LATENCY,	T810_LAT_ISR },
+	{ "RX_LOAD",	KIND_LOAD,	T810_LOAD_RX },
+	{ "TX_LOAD",	KIND_LOAD,	T810_LOAD_TX },
+	{ NULL,		0,		0 }
+    }, tipStat[] = {
+	{ "COUNT",	KIND_LATENCY,	T810_STAT_COUNT },
+	{ "MEAN",	KIND_LATENCY,	T810_STAT_MEAN },
+	{ "P50",	KIND_LATENCY,	T810_STAT_P50 },
+	{ "P90",	KIND_LATENCY,	T810_STAT_P90 },
+	{ "P99",	KIND_LATENCY,	T810_STAT_P99 },
+	{ "MAX",	KIND_LATENCY,	T810_STAT_MAX },
+	{ "1S",		KIND_LOAD,	T810_LOAD_1S },
+	{ "10S",	KIND_LOAD,	T810_LOAD_10S },
+	{ "60S",	KIND_LOAD,	T810_LOAD_60S },
+	{ NULL,		0,		0 }
+    };
+
+    struct aiRecord *prec = (struct aiRecord *) pcommon;
+    aiTip810Private_t *pcanAi;
+    char *canString;
+    char *name;
+    char *statName;
+    char separator;
+    canBusID_t busID;
+    size_t len;
+    int kind = -1;
+    int stage = -1;
+    int stat = -1;
+    int i;
+    long status;
+
+    /* ai.inp must be an INST_IO */
+    if (prec->inp.type != INST_IO) goto error;
+
+    canString = ((struct instio *)&(prec->inp.value))->string;
+
+    /* Strip leading whitespace & non-alphanumeric chars */
+    while (!isalnum(0xff & *canString)) {
+	if (*canString++ == '\0') goto error;
+    }
+
+    /* First part of string is the bus name */
+    name = canString;
+
+    /* find the end of the busName */
+    canString = strpbrk(canString, "/:");
+    if (canString == NULL || *canString == '\0') goto error;
+
+    /* Temporarily truncate string after name and look up t810 device */
+    separator = *canString;
+    *canString = '\0';
+    status = canOpen(name, &busID);
+    *canString++ = separator;
+    if (status) goto error;
+
+    /* Then comes <stage>_<statistic>, e.g. RX_QUEUE_P99 or TX_LOAD_10S */
+    statName = strrchr(canString, '_');
+    if (statName == NULL) goto error;
+    len = statName++ - canString;
+
+    for (i=0; tipStage[i].string != NULL; i++)
+	if (strlen(tipStage[i].string) == len &&
+	    strncmp(canString, tipStage[i].string, len) == 0) {
+	    kind  = tipStage[i].kind;
+	    stage = tipStage[i].value;
+	}
+
+    for (i=0; tipStat[i].string != NULL; i++)
+	if (tipStat[i].kind == kind &&
+	    strcmp(statName, tipStat[i].string) == 0)
+	    stat = tipStat[i].value;
+
+    if (stage >= 0 && stat >= 0) {
+	pcanAi = (aiTip810Private_t *) malloc(sizeof(aiTip810Private_t));
+	if (pcanAi == NULL) return S_dev_noMemory;
+	pcanAi->busID = busID;
+	pcanAi->kind  = kind;
+	pcanAi->stage = stage;
+	pcanAi->stat  = stat;
+	prec->dpvt = pcanAi;
+	return 0;
+    }
+
+error:
+    if (canSilenceErrors) {
+	prec->pact = TRUE;
+	return 0;
+    } else {
+	recGblRecordError(S_db_badField,(void *)prec,
+			  "devAiTip810: Bad INP field type or value");
+	return S_db_badField;
+    }
+}
+
+static long read_ai(struct aiRecord *prec)
+{
+    aiTip810Private_t *pcanAi = (aiTip810Private_t *) prec->dpvt;
+    double value;
+    int status;
+
+    if (pcanAi == NULL) {
+	prec->pact = TRUE;
+	return S_dev_noDevice;
+    }
+
+    if (pcanAi->kind == KIND_LOAD)
+	status = t810LoadGet(pcanAi->busID, pcanAi->stage, pcanAi->stat, &value);
+    else
+	status = t810LatencyGet(pcanAi->busID, pcanAi->stage, pcanAi->stat,
+				&value);
+    if (status) {
+	recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
+	return S_dev_noDevice;
+    }
+
+    prec->val = value;
+    prec->udf = FALSE;
+    return 2;	/* Don't convert */
+}
@@ -58,13 +58,16 @@ Copyright (c) 1995-2000 Andrew Johnson
 #include <epicsExport.h>
 
 #include "canBus.h"
+#include "devCan.h"
 
 
 #define DO_NOT_CONVERT	2
 
 
 typedef struct aoCanPrivate_s {
+    devCanRequest_t request;
     struct aoCanPrivate_s *nextPrivate;
+    devCanBus_t *pbus;
     IOSCANPVT ioscanpvt;
     dbCommon *prec;
     canIo_t out;
@@ -74,20 +77,11 @@ typedef struct aoCanPrivate_s {
     int status;
 } aoCanPrivate_t;
 
-typedef struct aoCanBus_s {
-    CALLBACK callback;
-    struct aoCanBus_s *nextBus;
-    aoCanPrivate_t *firstPrivate;
-    void *canBusID;
-    int status;
-} aoCanBus_t;
-
 static long init_ao(struct dbCommon *prec);
 static long get_ioint_info(int cmd, struct dbCommon *prec, IOSCANPVT *ppvt);
 static long write_ao(struct aoRecord *prec);
 static long special_linconv(struct aoRecord *prec, int after);
 static void aoMessage(void *private, const canMessage_t *pmessage);
-static void busSignal(void *private, int status);
 static void busCallback(CALLBACK *pCallback);
 
 #ifndef HAS_aodset
@@ -110,15 +104,14 @@ aodset devAoCan = {
 };
 epicsExportAddress(dset, devAoCan);
 
-static aoCanBus_t *firstBus;
-
 
 static long init_ao (
     struct dbCommon *pcommon
 ) {
     struct aoRecord *prec = (struct aoRecord *) pcommon;
     aoCanPrivate_t *pcanAo;
-    aoCanBus_t *pbus;
+    devCanBus_t *pbus;
+    canIo_t out;
     int status;
     epicsUInt32 fsd;
 
@@ -128,7 +121,11 @@ static long init_ao (
 	return S_db_badField;
     }
 
-    pcanAo = malloc(sizeof(aoCanPrivate_t));
+    /* Convert the parameter string into members of the canIo structure */
+    status = canIoParse(prec->out.value.instio.string, &out);
+
+    /* Allocate the private structure from the bus memory pool */
+    pcanAo = canBusAlloc(out.canBusID, sizeof(aoCanPrivate_t));
     if (pcanAo == NULL) {
 	return S_dev_noMemory;
     }
@@ -136,9 +133,7 @@ static long init_ao (
     pcanAo->prec = (dbCommon *) prec;
     pcanAo->ioscanpvt = NULL;
     pcanAo->status = NO_ALARM;
-
-    /* Convert the parameter string into members of the canIo structure */
-    status = canIoParse(prec->out.value.instio.string, &pcanAo->out);
+    pcanAo->out = out;
     if (status) {
 	if (canSilenceErrors) {
 	    pcanAo->out.canBusID = NULL;
@@ -203,35 +198,18 @@ static long init_ao (
 		fsd, prec->eslo, prec->roff, pcanAo->mask, pcanAo->sign);
     #endif
 
-    /* Find the bus matching this record */
-    for (pbus = firstBus; pbus != NULL; pbus = pbus->nextBus) {
-    	if (pbus->canBusID == pcanAo->out.canBusID) break;
-    }
-
-    /* If not found, create one */
-    if (pbus == NULL) {
-	pbus = malloc(sizeof (aoCanBus_t));
-	if (pbus == NULL) return S_dev_noMemory;
-
-	/* Fill it in */
-	pbus->firstPrivate = NULL;
-	pbus->canBusID = pcanAo->out.canBusID;
-	callbackSetUser(pbus, &pbus->callback);
-	callbackSetCallback(busCallback, &pbus->callback);
-	callbackSetPriority(priorityMedium, &pbus->callback);
-
-	/* and add it to the list of busses we know about */
-	pbus->nextBus = firstBus;
-	firstBus = pbus;
-
-	/* Ask driver for error signals */
-	canSignal(pbus->canBusID, busSignal, pbus);
-    }
+    /* Find the bus matching this record, or create one */
+    pbus = devCanBusFind(pcanAo->out.canBusID, busCallback);
+    if (pbus == NULL) return S_dev_noMemory;
+    pcanAo->pbus = pbus;
 
     /* Insert private record structure into linked list for this CANbus */
     pcanAo->nextPrivate = pbus->firstPrivate;
     pbus->firstPrivate = pcanAo;
 
+    /* Set the request parameters for I/O Interrupt processing */
+    devCanRequestInit(&pcanAo->request, (dbCommon *) prec);
+
     /* Register the message handler with the Canbus driver */
     canMessage(pcanAo->out.canBusID, pcanAo->out.identifier, aoMessage, pcanAo);
 
@@ -335,8 +313,12 @@ static long write_ao (
 			    pcanAo->data);
 		#endif
 
-		status = canWrite(pcanAo->out.canBusID, &message, 
-				  pcanAo->out.timeout);
+		/* Cyclic messages only need their payload updating */
+		status = canCyclicUpdate(pcanAo->out.canBusID, &message);
+		if (status == S_can_noMessage) {
+		    status = canWrite(pcanAo->out.canBusID, &message,
+				      pcanAo->out.timeout);
+		}
 		if (status) {
 		    #ifdef DEBUG
 			printf("canAo %s: canWrite status=%#x\n", 
@@ -384,37 +366,14 @@ static void aoMessage (
     if (pcanAo->prec->scan == SCAN_IO_EVENT &&
 	pmessage->rtr == RTR) {
 	pcanAo->status = NO_ALARM;
-	scanIoRequest(pcanAo->ioscanpvt);
-    }
-}
-
-static void busSignal (
-    void *private,
-    int status
-) {
-    aoCanBus_t *pbus = private;
-
-    if (!interruptAccept) return;
-
-    switch(status) {
-	case CAN_BUS_OK:
-	    pbus->status = NO_ALARM;
-	    break;
-	case CAN_BUS_ERROR:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
-	case CAN_BUS_OFF:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
+	devCanIoRequest(pcanAo->pbus, &pcanAo->request, pcanAo->ioscanpvt);
     }
 }
 
 static void busCallback (
     CALLBACK *pCallback
 ) {
-    aoCanBus_t *pbus;
+    devCanBus_t *pbus;
     aoCanPrivate_t *pcanAo;
 
     callbackGetUser(pbus, pCallback);
@@ -54,6 +54,7 @@ Copyright (c) 1995-2000 Andrew Johnson
 #include <epicsExport.h>
 
 #include "canBus.h"
+#include "devCan.h"
 
 
 #define CONVERT 0
@@ -61,8 +62,9 @@ Copyright (c) 1995-2000 Andrew Johnson
 
 
 typedef struct biCanPrivate_s {
-    CALLBACK callback;
+    devCanRequest_t request;
     struct biCanPrivate_s *nextPrivate;
+    devCanBus_t *pbus;
     epicsTimerId timId;
     IOSCANPVT ioscanpvt;
     struct dbCommon *prec;
@@ -71,20 +73,10 @@ typedef struct biCanPrivate_s {
     int status;
 } biCanPrivate_t;
 
-typedef struct biCanBus_s {
-    CALLBACK callback;
-    struct biCanBus_s *nextBus;
-    biCanPrivate_t *firstPrivate;
-    void *canBusID;
-    int status;
-} biCanBus_t;
-
 static long init_bi(struct dbCommon *prec);
 static long get_ioint_info(int cmd, struct dbCommon *prec, IOSCANPVT *ppvt);
 static long read_bi(struct biRecord *prec);
-static void ProcessCallback(CALLBACK *pcallback);
 static void biMessage(void *private, const canMessage_t *pmessage);
-static void busSignal(void *private, int status);
 static void busCallback(CALLBACK *pcallback);
 
 #ifndef HAS_bidset
@@ -105,15 +97,14 @@ bidset devBiCan = {
 };
 epicsExportAddress(dset, devBiCan);
 
-static biCanBus_t *firstBus;
-
 
 static long init_bi (
     struct dbCommon *pcommon
 ) {
     struct biRecord *prec = (struct biRecord *) pcommon;
     biCanPrivate_t *pcanBi;
-    biCanBus_t *pbus;
+    devCanBus_t *pbus;
+    canIo_t inp;
     int status;
 
     if (prec->inp.type != INST_IO) {
@@ -122,7 +113,11 @@ static long init_bi (
 	return S_db_badField;
     }
 
-    pcanBi = malloc(sizeof(biCanPrivate_t));
+    /* Convert the address string into members of the canIo structure */
+    status = canIoParse(prec->inp.value.instio.string, &inp);
+
+    /* Allocate the private structure from the bus memory pool */
+    pcanBi = canBusAlloc(inp.canBusID, sizeof(biCanPrivate_t));
     if (pcanBi == NULL) {
 	return S_dev_noMemory;
     }
@@ -130,9 +125,7 @@ static long init_bi (
     pcanBi->prec = (dbCommon *) prec;
     pcanBi->ioscanpvt = NULL;
     pcanBi->status = NO_ALARM;
-
-    /* Convert the address string into members of the canIo structure */
-    status = canIoParse(prec->inp.value.instio.string, &pcanBi->inp);
+    pcanBi->inp = inp;
     if (status ||
 	pcanBi->inp.parameter < 0 ||
 	pcanBi->inp.parameter > 7) {
@@ -162,39 +155,17 @@ static long init_bi (
 		pcanBi->inp.parameter, prec->mask);
     #endif
 
-    /* Find the bus matching this record */
-    for (pbus = firstBus; pbus != NULL; pbus = pbus->nextBus) {
-    	if (pbus->canBusID == pcanBi->inp.canBusID) break;
-    }
-
-    /* If not found, create one */
-    if (pbus == NULL) {
-	pbus = malloc(sizeof (biCanBus_t));
-	if (pbus == NULL) return S_dev_noMemory;
-
-	/* Fill it in */
-	pbus->firstPrivate = NULL;
-	pbus->canBusID = pcanBi->inp.canBusID;
-	callbackSetUser(pbus, &pbus->callback);
-	callbackSetCallback(busCallback, &pbus->callback);
-	callbackSetPriority(priorityMedium, &pbus->callback);
-
-	/* and add it to the list of busses we know about */
-	pbus->nextBus = firstBus;
-	firstBus = pbus;
-
-	/* Ask driver for error signals */
-	canSignal(pbus->canBusID, busSignal, pbus);
-    }
+    /* Find the bus matching this record, or create one */
+    pbus = devCanBusFind(pcanBi->inp.canBusID, busCallback);
+    if (pbus == NULL) return S_dev_noMemory;
+    pcanBi->pbus = pbus;
 
     /* Insert private record structure into linked list for this CANbus */
     pcanBi->nextPrivate = pbus->firstPrivate;
     pbus->firstPrivate = pcanBi;
 
-    /* Set the callback parameters for asynchronous processing */
-    callbackSetUser(prec, &pcanBi->callback);
-    callbackSetCallback(ProcessCallback, &pcanBi->callback);
-    callbackSetPriority(prec->prio, &pcanBi->callback);
+    /* Set the request parameters for asynchronous processing */
+    devCanRequestInit(&pcanBi->request, (dbCommon *) prec);
 
     /* and create a timer for CANbus RTR timeouts */
     pcanBi->timId = epicsTimerQueueCreateTimer(canTimerQ,
@@ -284,16 +255,6 @@ static long read_bi (
     }
 }
 
-static void ProcessCallback(CALLBACK *pcallback)
-{
-    dbCommon    *pRec;
-
-    callbackGetUser(pRec, pcallback);
-    dbScanLock(pRec);
-    (*pRec->rset->process)(pRec);
-    dbScanUnlock(pRec);
-}
-
 static void biMessage (
     void *private,
     const canMessage_t *pmessage
@@ -309,41 +270,18 @@ static void biMessage (
 
     if (pcanBi->prec->scan == SCAN_IO_EVENT) {
 	pcanBi->status = NO_ALARM;
-	scanIoRequest(pcanBi->ioscanpvt);
+	devCanIoRequest(pcanBi->pbus, &pcanBi->request, pcanBi->ioscanpvt);
     } else if (pcanBi->status == TIMEOUT_ALARM) {
 	pcanBi->status = NO_ALARM;
 	epicsTimerCancel(pcanBi->timId);
-	callbackRequest(&pcanBi->callback);
-    }
-}
-
-static void busSignal (
-    void *private,
-    int status
-) {
-    biCanBus_t *pbus = private;
-
-    if (!interruptAccept) return;
-
-    switch(status) {
-	case CAN_BUS_OK:
-	    pbus->status = NO_ALARM;
-	    break;
-	case CAN_BUS_ERROR:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
-	case CAN_BUS_OFF:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
+	devCanCallbackRequest(pcanBi->pbus, &pcanBi->request);
     }
 }
 
 static void busCallback (
     CALLBACK *pCallback
 ) {
-    biCanBus_t *pbus;
+    devCanBus_t *pbus;
     biCanPrivate_t *pcanBi;
 
     callbackGetUser(pbus, pCallback);
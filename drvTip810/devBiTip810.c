@@ -9,6 +9,10 @@ File:
 Description:
     TIP810 Status Binary Input device support
 
+    Records using I/O Interrupt scanning are processed whenever the driver
+    signals a change in the bus error state, through a single canSignal()
+    handler and scan list shared by all the records on each bus.
+
 Author:
     Andrew Johnson <Andrew.N.Johnson@gmail.com>
 Created:
@@ -40,6 +44,7 @@ Copyright (c) 1995-2000 Andrew Johnson
 #include <epicsTimer.h>
 #include <dbDefs.h>
 #include <dbAccess.h>
+#include <dbScan.h>
 #include <recSup.h>
 #include <recGbl.h>
 #include <alarm.h>
@@ -53,8 +58,17 @@ Copyright (c) 1995-2000 Andrew Johnson
 #include "pca82c200.h"
 
 
+typedef struct biTipBus_s {
+    struct biTipBus_s *pnext;	/* To next bus */
+    canBusID_t busID;
+    IOSCANPVT ioscanpvt;	/* Records to process on status change */
+} biTipBus_t;
+
+static biTipBus_t *firstBus;
+
 /* Create the dset for devBiTip810 */
 static long init_bi(struct dbCommon *prec);
+static long get_ioint_info(int cmd, struct dbCommon *prec, IOSCANPVT *ppvt);
 static long read_bi(struct biRecord *prec);
 
 #ifndef HAS_bidset
@@ -69,12 +83,43 @@ bidset devBiTip810 = {
         NULL,
         NULL,
         init_bi,
-        NULL
+        get_ioint_info
     },
     read_bi
 };
 epicsExportAddress(dset, devBiTip810);
 
+
+static void busSignal (
+    void *pprivate,
+    int status
+) {
+    biTipBus_t *pbus = pprivate;
+
+    scanIoRequest(pbus->ioscanpvt);
+}
+
+static biTipBus_t *findBus (
+    canBusID_t busID
+) {
+    biTipBus_t *pbus;
+
+    for (pbus = firstBus; pbus != NULL; pbus = pbus->pnext) {
+	if (pbus->busID == busID) return pbus;
+    }
+
+    pbus = canBusAlloc(busID, sizeof(biTipBus_t));
+    if (pbus == NULL) return NULL;
+
+    pbus->busID = busID;
+    scanIoInit(&pbus->ioscanpvt);
+    if (canSignal(busID, busSignal, pbus)) return NULL;
+
+    pbus->pnext = firstBus;
+    firstBus = pbus;
+    return pbus;
+}
+
 static long init_bi(
     struct dbCommon *pcommon
 ) {
@@ -132,8 +177,8 @@ static long init_bi(
 	    prec->mask = tipState[i].mask;
 
     if (prec->mask) {
-	prec->dpvt = busID;
-	return 0;
+	prec->dpvt = findBus(busID);
+	if (prec->dpvt != NULL) return 0;
     }
 
 error:
@@ -147,13 +192,28 @@ error:
     }
 }
 
+static long get_ioint_info (
+    int cmd,
+    struct dbCommon *pcommon,
+    IOSCANPVT *ppvt
+) {
+    biTipBus_t *pbus = pcommon->dpvt;
+
+    if (pbus == NULL) return S_dev_noDevice;
+
+    *ppvt = pbus->ioscanpvt;
+    return 0;
+}
+
 static long read_bi(struct biRecord *prec)
 {
-    if (prec->dpvt == NULL || prec->mask == 0) {
+    biTipBus_t *pbus = prec->dpvt;
+
+    if (pbus == NULL || prec->mask == 0) {
 	prec->pact = TRUE;
 	return S_dev_noDevice;
     }
 
-    prec->rval = t810Status((canBusID_t) prec->dpvt) & prec->mask;
+    prec->rval = t810Status(pbus->busID) & prec->mask;
     return 0;
 }
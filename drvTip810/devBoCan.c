@@ -54,13 +54,16 @@ Copyright (c) 1995-2000 Andrew Johnson
 #include <epicsExport.h>
 
 #include "canBus.h"
+#include "devCan.h"
 
 
 #define DO_NOT_CONVERT	2
 
 
 typedef struct boCanPrivate_s {
+    devCanRequest_t request;
     struct boCanPrivate_s *nextPrivate;
+    devCanBus_t *pbus;
     IOSCANPVT ioscanpvt;
     dbCommon *prec;
     canIo_t out;
@@ -68,19 +71,10 @@ typedef struct boCanPrivate_s {
     int status;
 } boCanPrivate_t;
 
-typedef struct boCanBus_s {
-    CALLBACK callback;
-    struct boCanBus_s *nextBus;
-    boCanPrivate_t *firstPrivate;
-    void *canBusID;
-    int status;
-} boCanBus_t;
-
 static long init_bo(struct dbCommon *prec);
 static long get_ioint_info(int cmd, struct dbCommon *prec, IOSCANPVT *ppvt);
 static long write_bo(struct boRecord *prec);
 static void boMessage(void *private, const canMessage_t *pmessage);
-static void busSignal(void *private, int status);
 static void busCallback(CALLBACK *pCallback);
 
 #ifndef HAS_bodset
@@ -101,15 +95,14 @@ bodset devBoCan = {
 };
 epicsExportAddress(dset, devBoCan);
 
-static boCanBus_t *firstBus;
-
 
 static long init_bo (
     struct dbCommon *pcommon
 ) {
     struct boRecord *prec = (struct boRecord *) pcommon;
     boCanPrivate_t *pcanBo;
-    boCanBus_t *pbus;
+    devCanBus_t *pbus;
+    canIo_t out;
     int status;
 
     if (prec->out.type != INST_IO) {
@@ -118,7 +111,11 @@ static long init_bo (
 	return S_db_badField;
     }
 
-    pcanBo = malloc(sizeof(boCanPrivate_t));
+    /* Convert the parameter string into members of the canIo structure */
+    status = canIoParse(prec->out.value.instio.string, &out);
+
+    /* Allocate the private structure from the bus memory pool */
+    pcanBo = canBusAlloc(out.canBusID, sizeof(boCanPrivate_t));
     if (pcanBo == NULL) {
 	return S_dev_noMemory;
     }
@@ -126,9 +123,7 @@ static long init_bo (
     pcanBo->prec = (dbCommon *) prec;
     pcanBo->ioscanpvt = NULL;
     pcanBo->status = NO_ALARM;
-
-    /* Convert the parameter string into members of the canIo structure */
-    status = canIoParse(prec->out.value.instio.string, &pcanBo->out);
+    pcanBo->out = out;
     if (status ||
 	pcanBo->out.parameter < 0 ||
 	pcanBo->out.parameter > 7) {
@@ -157,35 +152,18 @@ static long init_bo (
 	printf("  bit=%ld, mask=%#lx\n", pcanBo->out.parameter, prec->mask);
     #endif
 
-    /* Find the bus matching this record */
-    for (pbus = firstBus; pbus != NULL; pbus = pbus->nextBus) {
-    	if (pbus->canBusID == pcanBo->out.canBusID) break;
-    }
-
-    /* If not found, create one */
-    if (pbus == NULL) {
-	pbus = malloc(sizeof (boCanBus_t));
-	if (pbus == NULL) return S_dev_noMemory;
-
-	/* Fill it in */
-	pbus->firstPrivate = NULL;
-	pbus->canBusID = pcanBo->out.canBusID;
-	callbackSetUser(pbus, &pbus->callback);
-	callbackSetCallback(busCallback, &pbus->callback);
-	callbackSetPriority(priorityMedium, &pbus->callback);
-
-	/* and add it to the list of busses we know about */
-	pbus->nextBus = firstBus;
-	firstBus = pbus;
-
-	/* Ask driver for error signals */
-	canSignal(pbus->canBusID, busSignal, pbus);
-    }
+    /* Find the bus matching this record, or create one */
+    pbus = devCanBusFind(pcanBo->out.canBusID, busCallback);
+    if (pbus == NULL) return S_dev_noMemory;
+    pcanBo->pbus = pbus;
 
     /* Insert private record structure into linked list for this CANbus */
     pcanBo->nextPrivate = pbus->firstPrivate;
     pbus->firstPrivate = pcanBo;
 
+    /* Set the request parameters for I/O Interrupt processing */
+    devCanRequestInit(&pcanBo->request, (dbCommon *) prec);
+
     /* Register the message handler with the Canbus driver */
     canMessage(pcanBo->out.canBusID, pcanBo->out.identifier, boMessage, pcanBo);
 
@@ -250,8 +228,12 @@ static long write_bo (
 			    pcanBo->data);
 		#endif
 
-		status = canWrite(pcanBo->out.canBusID, &message, 
-				  pcanBo->out.timeout);
+		/* Cyclic messages only need their payload updating */
+		status = canCyclicUpdate(pcanBo->out.canBusID, &message);
+		if (status == S_can_noMessage) {
+		    status = canWrite(pcanBo->out.canBusID, &message,
+				      pcanBo->out.timeout);
+		}
 		if (status) {
 		    #ifdef DEBUG
 			printf("canBo %s: canWrite status=%#x\n",
@@ -281,37 +263,14 @@ static void boMessage (
     if (pcanBo->prec->scan == SCAN_IO_EVENT &&
 	pmessage->rtr == RTR) {
 	pcanBo->status = NO_ALARM;
-	scanIoRequest(pcanBo->ioscanpvt);
-    }
-}
-
-static void busSignal (
-    void *private,
-    int status
-) {
-    boCanBus_t *pbus = private;
-
-    if (!interruptAccept) return;
-
-    switch(status) {
-	case CAN_BUS_OK:
-	    pbus->status = NO_ALARM;
-	    break;
-	case CAN_BUS_ERROR:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
-	case CAN_BUS_OFF:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
+	devCanIoRequest(pcanBo->pbus, &pcanBo->request, pcanBo->ioscanpvt);
     }
 }
 
 static void busCallback (
     CALLBACK *pCallback
 ) {
-    boCanBus_t *pbus;
+    devCanBus_t *pbus;
     boCanPrivate_t *pcanBo;
 
     callbackGetUser(pbus, pCallback);
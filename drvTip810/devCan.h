@@ -0,0 +1,87 @@
+/*******************************************************************************
+
+Project:
+    CAN Bus Driver for EPICS
+
+File:
+    devCan.h
+
+Description:
+    Definitions shared by the CANbus device support modules
+
+Author:
+    Andrew Johnson <Andrew.N.Johnson@gmail.com>
+Created:
+    18 October 2026
+
+Copyright (c) 1995-2000 Andrew Johnson
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*******************************************************************************/
+
+
+#ifndef INCdevCanH
+#define INCdevCanH
+
+#include <callback.h>
+#include <dbScan.h>
+
+#include "canBus.h"
+
+struct dbCommon;
+
+
+/* Each device support module keeps one of these for every bus it uses,
+ * holding the list of its record private structures on that bus.  The
+ * busCallback routine is called from the shared bus error thread to
+ * process those records after a bus error signal; it also identifies the
+ * device support module that owns the structure.
+ */
+
+typedef struct devCanBus_s {
+    CALLBACK callback;			/* Must be first */
+    struct devCanBus_s *nextBus;	/* Hash chain */
+    struct devCanBus_s *nextSame;	/* Other modules on this bus */
+    struct devCanSig_s *psig;		/* Shared per-bus data */
+    CALLBACKFUNC busCallback;		/* Owner's error callback */
+    void *firstPrivate;			/* Owner's record list */
+    canBusID_t canBusID;
+    int status;
+} devCanBus_t;
+
+/* Input and output records that are processed as a result of a received
+ * message embed one of these in their private structure, initialised by
+ * devCanRequestInit.  A request is only ever queued once, so a bus queue
+ * can't overflow; requests made while it is still waiting are merged.
+ */
+
+typedef struct devCanRequest_s {
+    CALLBACK callback;			/* Must be first */
+    struct devCanRequest_s *nextRequest;	/* Bus queue link */
+    int queued;				/* On the bus queue */
+} devCanRequest_t;
+
+devCanBus_t *devCanBusFind(canBusID_t canBusID, CALLBACKFUNC busCallback);
+void devCanBusReport(void);
+void devCanRequestInit(devCanRequest_t *preq, struct dbCommon *prec);
+void devCanCallbackRequest(devCanBus_t *pbus, devCanRequest_t *preq);
+void devCanIoRequest(devCanBus_t *pbus, devCanRequest_t *preq,
+		     IOSCANPVT ioscanpvt);
+int devCanBusQueue(const char *busName, int priority);
+
+extern double devCanErrorInterval;
+
+#endif /* INCdevCanH */
@@ -0,0 +1,635 @@
+/*******************************************************************************
+
+Project:
+    CAN Bus Driver for EPICS
+
+File:
+    devCanBus.c
+
+Description:
+    Bus registry and error signal handling shared by the CANbus device
+    support modules
+
+    Bus error signals are coalesced per bus: the driver's signal only marks
+    the bus as pending and wakes a low priority thread, which processes the
+    records of every device support module on that bus at most once per
+    devCanErrorInterval seconds.  Errors arriving while a bus is already
+    pending are counted as suppressed.
+
+    A bus can also be given its own request queue and worker thread with
+    devCanBusQueue, which is then used instead of the EPICS callback and
+    I/O Interrupt scan queues to process the records triggered by received
+    messages.  Each record is queued at most once, so the queue can't
+    overflow; requests for a record already waiting are merged into it.
+
+Author:
+    Andrew Johnson <Andrew.N.Johnson@gmail.com>
+Created:
+    18 October 2026
+
+Copyright (c) 1995-2000 Andrew Johnson
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*******************************************************************************/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <epicsTypes.h>
+#include <epicsTime.h>
+#include <epicsEvent.h>
+#include <epicsInterrupt.h>
+#include <epicsThread.h>
+#include <dbAccess.h>
+#include <dbCommon.h>
+#include <recSup.h>
+#include <callback.h>
+#include <alarm.h>
+#include <devLib.h>
+#include <iocsh.h>
+#include <epicsExport.h>
+
+#include "canBus.h"
+#include "devCan.h"
+
+
+#define BUS_HASH_SIZE 64	/* Must be a power of 2 */
+
+/* One of these per bus, shared by all the device support modules */
+
+typedef struct devCanSig_s {
+    struct devCanSig_s *nextSig;	/* To next bus */
+    devCanBus_t *firstBus;		/* Modules using this bus */
+    canBusID_t canBusID;
+    volatile int pending;		/* Error seen, fan-out not yet done */
+    epicsUInt64 lastFanout;		/* Monotonic time of last fan-out */
+    unsigned long signals;		/* Error signals received */
+    unsigned long fanouts;		/* Times records were processed */
+    unsigned long suppressed;		/* Signals merged into a pending one */
+    const char *busName;		/* Set by devCanBusQueue */
+    epicsEventId queueEvent;		/* Wakes worker, NULL if no queue */
+    devCanRequest_t *firstRequest;	/* Request queue */
+    devCanRequest_t *lastRequest;
+    int queueLength;
+    int queueMax;			/* Highest number queued */
+    unsigned long requested;		/* Requests made */
+    unsigned long merged;		/* Requests for a record already queued */
+} devCanSig_t;
+
+static devCanBus_t *busHash[BUS_HASH_SIZE];
+static devCanSig_t *firstSig;
+static epicsEventId fanoutEvent;
+
+double devCanErrorInterval = 1.0;
+epicsExportAddress(double, devCanErrorInterval);
+
+static void busSignal(void *private, int status);
+static void fanoutTask(void *parm);
+static void requestCallback(CALLBACK *pcallback);
+static void requestQueue(devCanSig_t *psig, devCanRequest_t *preq);
+static void queueTask(void *parm);
+
+
+/*******************************************************************************
+
+Routine:
+    findSig
+
+Purpose:
+    Return the shared signal structure for a bus
+
+Description:
+    Creates the structure and registers its error signal handler with the
+    driver the first time a bus is seen.  The fan-out thread is started
+    with the first bus.
+
+Returns:
+    Pointer to the structure, or NULL on failure.
+
+*/
+
+static devCanSig_t *findSig (
+    canBusID_t canBusID
+) {
+    devCanSig_t *psig;
+
+    for (psig = firstSig; psig != NULL; psig = psig->nextSig) {
+	if (psig->canBusID == canBusID) return psig;
+    }
+
+    if (fanoutEvent == NULL) {
+	fanoutEvent = epicsEventCreate(epicsEventEmpty);
+	if (fanoutEvent == NULL) return NULL;
+	epicsThreadCreate("canBusErr", epicsThreadPriorityLow,
+			  epicsThreadGetStackSize(epicsThreadStackSmall),
+			  fanoutTask, NULL);
+    }
+
+    psig = canBusAlloc(canBusID, sizeof (devCanSig_t));
+    if (psig == NULL) return NULL;
+
+    psig->canBusID = canBusID;
+    if (canSignal(canBusID, busSignal, psig)) return NULL;
+
+    psig->nextSig = firstSig;
+    firstSig = psig;
+    return psig;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    devCanBusFind
+
+Purpose:
+    Return the bus structure for a device support module and bus
+
+Description:
+    Looks up the bus structure for the given bus ID and device support
+    module (identified by its busCallback routine) in a hash table,
+    creating a new one and attaching it to the bus's shared error signal
+    handler if none exists.  Only called from init_record, so no locking
+    is needed.
+
+Returns:
+    Pointer to the bus structure, or NULL if it can't be allocated.
+
+*/
+
+devCanBus_t *devCanBusFind (
+    canBusID_t canBusID,
+    CALLBACKFUNC busCallback
+) {
+    size_t key = (size_t) canBusID;
+    devCanBus_t **phead;
+    devCanBus_t *pbus;
+    devCanSig_t *psig;
+
+    /* Bus IDs are heap pointers, so ignore the low bits */
+    key = (key >> 4) ^ (key >> 12);
+    phead = &busHash[key & (BUS_HASH_SIZE - 1)];
+
+    for (pbus = *phead; pbus != NULL; pbus = pbus->nextBus) {
+	if (pbus->canBusID == canBusID &&
+	    pbus->busCallback == busCallback) return pbus;
+    }
+
+    /* Not found, create one */
+    psig = findSig(canBusID);
+    if (psig == NULL) return NULL;
+
+    pbus = canBusAlloc(canBusID, sizeof (devCanBus_t));
+    if (pbus == NULL) return NULL;
+
+    /* Fill it in */
+    pbus->firstPrivate = NULL;
+    pbus->canBusID = canBusID;
+    pbus->busCallback = busCallback;
+    pbus->status = NO_ALARM;
+    callbackSetUser(pbus, &pbus->callback);
+    callbackSetCallback(busCallback, &pbus->callback);
+
+    /* and add it to the table of busses we know about */
+    pbus->nextBus = *phead;
+    *phead = pbus;
+
+    /* Attach it to the bus error fan-out */
+    pbus->psig = psig;
+    pbus->nextSame = psig->firstBus;
+    psig->firstBus = pbus;
+    return pbus;
+}
+
+static void busSignal (
+    void *private,
+    int status
+) {
+    devCanSig_t *psig = private;
+    int key, wake;
+
+    if (!interruptAccept) return;
+
+    switch(status) {
+	case CAN_BUS_OK:
+	    break;
+	case CAN_BUS_ERROR:
+	case CAN_BUS_OFF:
+	    key = epicsInterruptLock();
+	    psig->signals++;
+	    wake = !psig->pending;
+	    if (wake) {
+		psig->pending = TRUE;
+	    } else {
+		psig->suppressed++;
+	    }
+	    epicsInterruptUnlock(key);
+	    if (wake) epicsEventSignal(fanoutEvent);
+	    break;
+    }
+}
+
+
+/*******************************************************************************
+
+Routine:
+    fanoutTask
+
+Purpose:
+    Process the records on buses which have signalled an error
+
+Description:
+    Runs at low priority.  When woken it processes all the records on each
+    pending bus, unless that bus was processed less than
+    devCanErrorInterval seconds ago, in which case it sleeps until the
+    interval expires; any further errors in the meantime are merged into
+    the pending one.  Every record on the bus gets COMM_ALARM once, no
+    matter how many transitions occurred.  The pending flag and counters
+    are shared with busSignal, which may run at interrupt level, so they
+    are only changed with interrupts locked.
+
+*/
+
+static void fanoutTask (
+    void *parm
+) {
+    double delay = -1.0;
+
+    for (;;) {
+	epicsUInt64 now, interval;
+	devCanSig_t *psig;
+
+	if (delay < 0.0) {
+	    epicsEventMustWait(fanoutEvent);
+	} else {
+	    epicsEventWaitWithTimeout(fanoutEvent, delay);
+	}
+
+	now = epicsMonotonicGet();
+	interval = devCanErrorInterval > 0.0 ?
+		   (epicsUInt64) (devCanErrorInterval * 1e9) : 0;
+	delay = -1.0;
+
+	for (psig = firstSig; psig != NULL; psig = psig->nextSig) {
+	    devCanBus_t *pbus;
+	    int key;
+
+	    if (!psig->pending) continue;
+
+	    if (psig->fanouts && now - psig->lastFanout < interval) {
+		double wait = (interval - (now - psig->lastFanout)) * 1e-9;
+		if (delay < 0.0 || wait < delay) delay = wait;
+		continue;
+	    }
+
+	    key = epicsInterruptLock();
+	    psig->pending = FALSE;
+	    psig->fanouts++;
+	    epicsInterruptUnlock(key);
+	    psig->lastFanout = now;
+
+	    for (pbus = psig->firstBus; pbus != NULL; pbus = pbus->nextSame) {
+		pbus->status = COMM_ALARM;
+		pbus->busCallback(&pbus->callback);
+	    }
+	}
+    }
+}
+
+
+/*******************************************************************************
+
+Routine:
+    devCanBusReport
+
+Purpose:
+    Print the bus error fan-out counters
+
+Description:
+    For each bus used by CANbus device support, shows how many error
+    signals were received, how many times the records were processed as a
+    result, and how many signals were suppressed because a fan-out was
+    already pending.  This is registered as an iocsh command.
+
+Returns:
+    void
+
+*/
+
+void devCanBusReport (void)
+{
+    devCanSig_t *psig;
+
+    printf("CANbus error fan-out, interval %g seconds\n",
+	   devCanErrorInterval);
+    for (psig = firstSig; psig != NULL; psig = psig->nextSig) {
+	devCanBus_t *pbus;
+	int modules = 0;
+
+	for (pbus = psig->firstBus; pbus != NULL; pbus = pbus->nextSame)
+	    modules++;
+
+	if (psig->busName) {
+	    printf("  Bus %s:", psig->busName);
+	} else {
+	    printf("  Bus %p:", psig->canBusID);
+	}
+	printf(" %d modules, %lu signals, %lu fan-outs, %lu suppressed%s\n",
+	       modules, psig->signals, psig->fanouts, psig->suppressed,
+	       psig->pending ? ", pending" : "");
+	if (psig->queueEvent) {
+	    printf("\tRequest queue: %lu requested, %lu merged, max %d "
+		   "queued\n", psig->requested, psig->merged, psig->queueMax);
+	}
+    }
+}
+
+
+/*******************************************************************************
+
+Routine:
+    devCanRequestInit
+
+Purpose:
+    Prepare a record's request structure
+
+Description:
+    Sets up the embedded CALLBACK to process the record at the priority
+    given by its PRIO field.  A record that is waiting for a reply (PACT
+    set) is completed by calling its process routine directly; otherwise
+    it is processed through dbProcess, as an I/O Interrupt scan would.
+    The CALLBACK can also be passed to callbackRequest.
+
+Returns:
+    void
+
+*/
+
+void devCanRequestInit (
+    devCanRequest_t *preq,
+    struct dbCommon *prec
+) {
+    callbackSetUser(prec, &preq->callback);
+    callbackSetCallback(requestCallback, &preq->callback);
+    callbackSetPriority(prec->prio, &preq->callback);
+    preq->nextRequest = NULL;
+    preq->queued = FALSE;
+}
+
+static void requestCallback (
+    CALLBACK *pcallback
+) {
+    dbCommon *prec;
+
+    callbackGetUser(prec, pcallback);
+    dbScanLock(prec);
+    if (prec->pact) {
+	(*prec->rset->process)(prec);
+    } else {
+	dbProcess(prec);
+    }
+    dbScanUnlock(prec);
+}
+
+
+/*******************************************************************************
+
+Routine:
+    devCanCallbackRequest
+
+Purpose:
+    Request a record callback from CANbus device support
+
+Description:
+    Used by the input device support modules when a received message
+    completes a record that is waiting for it.  If the bus has its own
+    request queue the request goes there, otherwise it goes to the
+    standard EPICS queue for the callback's priority.
+
+Returns:
+    void
+
+*/
+
+void devCanCallbackRequest (
+    devCanBus_t *pbus,
+    devCanRequest_t *preq
+) {
+    devCanSig_t *psig = pbus->psig;
+
+    if (psig->queueEvent == NULL) {
+	callbackRequest(&preq->callback);
+    } else {
+	requestQueue(psig, preq);
+    }
+}
+
+
+/*******************************************************************************
+
+Routine:
+    devCanIoRequest
+
+Purpose:
+    Process an I/O Interrupt scanned record from CANbus device support
+
+Description:
+    Used by the device support modules when a received message is for a
+    record with SCAN set to I/O Intr.  If the bus has its own request queue
+    the record is processed by the bus's worker thread, otherwise the
+    standard I/O Interrupt scan list is requested.
+
+Returns:
+    void
+
+*/
+
+void devCanIoRequest (
+    devCanBus_t *pbus,
+    devCanRequest_t *preq,
+    IOSCANPVT ioscanpvt
+) {
+    devCanSig_t *psig = pbus->psig;
+
+    if (psig->queueEvent == NULL) {
+	scanIoRequest(ioscanpvt);
+    } else {
+	requestQueue(psig, preq);
+    }
+}
+
+
+/*******************************************************************************
+
+Routine:
+    requestQueue
+
+Purpose:
+    Add a request to a bus's queue
+
+Description:
+    A request that is already on the queue is left where it is and counted
+    as merged; the record will see the latest data when it is processed.
+    The queue is shared with the worker thread, so it is only changed with
+    interrupts locked.
+
+*/
+
+static void requestQueue (
+    devCanSig_t *psig,
+    devCanRequest_t *preq
+) {
+    int key, wake;
+
+    key = epicsInterruptLock();
+    psig->requested++;
+    wake = !preq->queued;
+    if (wake) {
+	preq->queued = TRUE;
+	preq->nextRequest = NULL;
+	if (psig->lastRequest) {
+	    psig->lastRequest->nextRequest = preq;
+	} else {
+	    psig->firstRequest = preq;
+	}
+	psig->lastRequest = preq;
+	if (++psig->queueLength > psig->queueMax)
+	    psig->queueMax = psig->queueLength;
+    } else {
+	psig->merged++;
+    }
+    epicsInterruptUnlock(key);
+    if (wake) epicsEventSignal(psig->queueEvent);
+}
+
+static void queueTask (
+    void *parm
+) {
+    devCanSig_t *psig = parm;
+
+    for (;;) {
+	epicsEventMustWait(psig->queueEvent);
+
+	for (;;) {
+	    devCanRequest_t *preq;
+	    int key;
+
+	    key = epicsInterruptLock();
+	    preq = psig->firstRequest;
+	    if (preq) {
+		psig->firstRequest = preq->nextRequest;
+		if (psig->firstRequest == NULL) psig->lastRequest = NULL;
+		psig->queueLength--;
+		preq->queued = FALSE;
+	    }
+	    epicsInterruptUnlock(key);
+	    if (preq == NULL) break;
+
+	    (*preq->callback.callback)(&preq->callback);
+	}
+    }
+}
+
+
+/*******************************************************************************
+
+Routine:
+    devCanBusQueue
+
+Purpose:
+    Give a bus its own record request queue
+
+Description:
+    Creates a request queue for the named bus, and a worker thread at the
+    given EPICS priority (0 means epicsThreadPriorityScanHigh) to process
+    the records on it.  This is registered as an iocsh command, and should
+    be used after the bus has been created but before iocInit.
+
+Returns:
+    0, or an error status.
+
+Example:
+    devCanBusQueue("CAN1", 0);
+
+*/
+
+int devCanBusQueue (
+    const char *busName,
+    int priority
+) {
+    canBusID_t canBusID;
+    devCanSig_t *psig;
+    char threadName[32];
+    int status;
+
+    if (busName == NULL) {
+	printf("Usage: devCanBusQueue \"busName\", priority\n");
+	return S_dev_badArgument;
+    }
+
+    status = canOpen(busName, &canBusID);
+    if (status) {
+	printf("devCanBusQueue: Bus '%s' not found\n", busName);
+	return status;
+    }
+
+    psig = findSig(canBusID);
+    if (psig == NULL) return S_dev_noMemory;
+    if (psig->queueEvent != NULL) {
+	printf("devCanBusQueue: Bus '%s' already has a queue\n", busName);
+	return S_dev_badArgument;
+    }
+
+    psig->busName = busName;
+    psig->queueEvent = epicsEventCreate(epicsEventEmpty);
+    if (psig->queueEvent == NULL) return S_dev_noMemory;
+
+    if (priority <= 0 || priority > epicsThreadPriorityMax)
+	priority = epicsThreadPriorityScanHigh;
+    sprintf(threadName, "canCb%.24s", busName);
+    if (epicsThreadCreate(threadName, priority,
+			  epicsThreadGetStackSize(epicsThreadStackBig),
+			  queueTask, psig) == 0) return S_dev_noMemory;
+    return 0;
+}
+
+
+/* devCanBusReport */
+static const iocshFuncDef devCanBusReportFuncDef =
+    {"devCanBusReport",0,NULL};
+static void devCanBusReportCallFunc(const iocshArgBuf *args)
+{
+    devCanBusReport();
+}
+
+/* devCanBusQueue(char *busName, int priority) */
+static const iocshArg devCanBusQueueArg0 = {"busName", iocshArgPersistentString};
+static const iocshArg devCanBusQueueArg1 = {"priority", iocshArgInt};
+static const iocshArg * const devCanBusQueueArgs[2] = {
+    &devCanBusQueueArg0, &devCanBusQueueArg1};
+static const iocshFuncDef devCanBusQueueFuncDef =
+    {"devCanBusQueue",2,devCanBusQueueArgs};
+static void devCanBusQueueCallFunc(const iocshArgBuf *args)
+{
+    devCanBusQueue(args[0].sval, args[1].ival);
+}
+
+static void devCanBusRegistrar(void) {
+    iocshRegister(&devCanBusReportFuncDef,devCanBusReportCallFunc);
+    iocshRegister(&devCanBusQueueFuncDef,devCanBusQueueCallFunc);
+}
+epicsExportRegistrar(devCanBusRegistrar);
@@ -54,6 +54,7 @@ Copyright (c) 1995-2000 Andrew Johnson
 #include <epicsExport.h>
 
 #include "canBus.h"
+#include "devCan.h"
 
 
 #define CONVERT 0
@@ -61,8 +62,9 @@ Copyright (c) 1995-2000 Andrew Johnson
 
 
 typedef struct mbbiCanPrivate_s {
-    CALLBACK callback;
+    devCanRequest_t request;
     struct mbbiCanPrivate_s *nextPrivate;
+    devCanBus_t *pbus;
     epicsTimerId timId;
     IOSCANPVT ioscanpvt;
     dbCommon *prec;
@@ -71,20 +73,10 @@ typedef struct mbbiCanPrivate_s {
     int status;
 } mbbiCanPrivate_t;
 
-typedef struct mbbiCanBus_s {
-    CALLBACK callback;
-    struct mbbiCanBus_s *nextBus;
-    mbbiCanPrivate_t *firstPrivate;
-    void *canBusID;
-    int status;
-} mbbiCanBus_t;
-
 static long init_mbbi(struct dbCommon *prec);
 static long get_ioint_info(int cmd, struct dbCommon *prec, IOSCANPVT *ppvt);
 static long read_mbbi(struct mbbiRecord *prec);
-static void ProcessCallback(CALLBACK *pCallback);
 static void mbbiMessage(void *private, const canMessage_t *pmessage);
-static void busSignal(void *private, int status);
 static void busCallback(CALLBACK *pCallback);
 
 #ifndef HAS_mbbidset
@@ -105,15 +97,14 @@ mbbidset devMbbiCan = {
 };
 epicsExportAddress(dset, devMbbiCan);
 
-static mbbiCanBus_t *firstBus;
-
 
 static long init_mbbi (
     struct dbCommon *pcommon
 ) {
     struct mbbiRecord *prec = (struct mbbiRecord *) pcommon;
     mbbiCanPrivate_t *pcanMbbi;
-    mbbiCanBus_t *pbus;
+    devCanBus_t *pbus;
+    canIo_t inp;
     int status;
 
     if (prec->inp.type != INST_IO) {
@@ -122,7 +113,11 @@ static long init_mbbi (
 	return S_db_badField;
     }
 
-    pcanMbbi = malloc(sizeof(mbbiCanPrivate_t));
+    /* Convert the address string into members of the canIo structure */
+    status = canIoParse(prec->inp.value.instio.string, &inp);
+
+    /* Allocate the private structure from the bus memory pool */
+    pcanMbbi = canBusAlloc(inp.canBusID, sizeof(mbbiCanPrivate_t));
     if (pcanMbbi == NULL) {
 	return S_dev_noMemory;
     }
@@ -130,9 +125,7 @@ static long init_mbbi (
     pcanMbbi->prec = (dbCommon *) prec;
     pcanMbbi->ioscanpvt = NULL;
     pcanMbbi->status = NO_ALARM;
-
-    /* Convert the address string into members of the canIo structure */
-    status = canIoParse(prec->inp.value.instio.string, &pcanMbbi->inp);
+    pcanMbbi->inp = inp;
     if (status ||
 	pcanMbbi->inp.parameter < 0 ||
 	pcanMbbi->inp.parameter > 7) {
@@ -163,39 +156,17 @@ static long init_mbbi (
 		pcanMbbi->inp.parameter, prec->mask);
     #endif
 
-    /* Find the bus matching this record */
-    for (pbus = firstBus; pbus != NULL; pbus = pbus->nextBus) {
-      if (pbus->canBusID == pcanMbbi->inp.canBusID) break;
-    }  
-
-    /* If not found, create one */
-    if (pbus == NULL) {
-	pbus = malloc(sizeof (mbbiCanBus_t));
-	if (pbus == NULL) return S_dev_noMemory;
-
-	/* Fill it in */
-	pbus->firstPrivate = NULL;
-	pbus->canBusID = pcanMbbi->inp.canBusID;
-	callbackSetUser(pbus, &pbus->callback);
-	callbackSetCallback(busCallback, &pbus->callback);
-	callbackSetPriority(priorityMedium, &pbus->callback);
-
-	/* and add it to the list of busses we know about */
-	pbus->nextBus = firstBus;
-	firstBus = pbus;
-
-	/* Ask driver for error signals */
-	canSignal(pbus->canBusID, busSignal, pbus);
-    }
+    /* Find the bus matching this record, or create one */
+    pbus = devCanBusFind(pcanMbbi->inp.canBusID, busCallback);
+    if (pbus == NULL) return S_dev_noMemory;
+    pcanMbbi->pbus = pbus;
 
     /* Insert private record structure into linked list for this CANbus */
     pcanMbbi->nextPrivate = pbus->firstPrivate;
     pbus->firstPrivate = pcanMbbi;
 
-    /* Set the callback parameters for asynchronous processing */
-    callbackSetUser(prec, &pcanMbbi->callback);
-    callbackSetCallback(ProcessCallback, &pcanMbbi->callback);
-    callbackSetPriority(prec->prio, &pcanMbbi->callback);
+    /* Set the request parameters for asynchronous processing */
+    devCanRequestInit(&pcanMbbi->request, (dbCommon *) prec);
 
     /* and create a timer for CANbus RTR timeouts */
     pcanMbbi->timId = epicsTimerQueueCreateTimer( canTimerQ,
@@ -286,16 +257,6 @@ static long read_mbbi (
     }
 }
 
-static void ProcessCallback(CALLBACK *pcallback)
-{
-    dbCommon *pRec;
-
-    callbackGetUser(pRec, pcallback);
-    dbScanLock(pRec);
-    (*pRec->rset->process)(pRec);
-    dbScanUnlock(pRec);
-}
-
 static void mbbiMessage (
     void *private,
     const canMessage_t *pmessage
@@ -311,41 +272,19 @@ static void mbbiMessage (
 
     if (pcanMbbi->prec->scan == SCAN_IO_EVENT) {
 	pcanMbbi->status = NO_ALARM;
-	scanIoRequest(pcanMbbi->ioscanpvt);
+	devCanIoRequest(pcanMbbi->pbus, &pcanMbbi->request,
+			pcanMbbi->ioscanpvt);
     } else if (pcanMbbi->status == TIMEOUT_ALARM) {
 	pcanMbbi->status = NO_ALARM;
 	epicsTimerCancel(pcanMbbi->timId);
-	callbackRequest(&pcanMbbi->callback);
-    }
-}
-
-static void busSignal (
-    void *private,
-    int status
-) {
-    mbbiCanBus_t *pbus = private;
-
-    if (!interruptAccept) return;
-
-    switch(status) {
-	case CAN_BUS_OK:
-	    pbus->status = NO_ALARM;
-	    break;
-	case CAN_BUS_ERROR:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
-	case CAN_BUS_OFF:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
+	devCanCallbackRequest(pcanMbbi->pbus, &pcanMbbi->request);
     }
 }
 
 static void busCallback (
     CALLBACK *pCallback
 ) {
-    mbbiCanBus_t *pbus;
+    devCanBus_t *pbus;
     mbbiCanPrivate_t *pcanMbbi;
 
     callbackGetUser(pbus, pCallback);
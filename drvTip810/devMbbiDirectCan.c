@@ -54,6 +54,7 @@ Copyright (c) 1995-2000 Andrew Johnson
 #include <epicsExport.h>
 
 #include "canBus.h"
+#include "devCan.h"
 
 
 #define CONVERT 0
@@ -61,8 +62,9 @@ Copyright (c) 1995-2000 Andrew Johnson
 
 
 typedef struct mbbiDirectCanPrivate_s {
-    CALLBACK callback;
+    devCanRequest_t request;
     struct mbbiDirectCanPrivate_s *nextPrivate;
+    devCanBus_t *pbus;
     epicsTimerId timId;
     IOSCANPVT ioscanpvt;
     dbCommon *prec;
@@ -71,20 +73,10 @@ typedef struct mbbiDirectCanPrivate_s {
     int status;
 } mbbiDirectCanPrivate_t;
 
-typedef struct mbbiDirectCanBus_s {
-    CALLBACK callback;
-    struct mbbiDirectCanBus_s *nextBus;
-    mbbiDirectCanPrivate_t *firstPrivate;
-    void *canBusID;
-    int status;
-} mbbiDirectCanBus_t;
-
 static long init_mbbiDirect(struct dbCommon *prec);
 static long get_ioint_info(int cmd, struct dbCommon *prec, IOSCANPVT *ppvt);
 static long read_mbbiDirect(struct mbbiDirectRecord *prec);
-static void ProcessCallback(CALLBACK *pcallback);
 static void mbbiDirectMessage(void *private, const canMessage_t *pmessage);
-static void busSignal(void *private, int status);
 static void busCallback(CALLBACK *pCallback);
 
 #ifndef HAS_mbbidirectdset
@@ -105,15 +97,14 @@ mbbidirectdset devMbbiDirectCan = {
 };
 epicsExportAddress(dset, devMbbiDirectCan);
 
-static mbbiDirectCanBus_t *firstBus;
-
 
 static long init_mbbiDirect (
     struct dbCommon *pcommon
 ) {
     struct mbbiDirectRecord *prec = (struct mbbiDirectRecord *) pcommon;
     mbbiDirectCanPrivate_t *pcanMbbiDirect;
-    mbbiDirectCanBus_t *pbus;
+    devCanBus_t *pbus;
+    canIo_t inp;
     int status;
 
     if (prec->inp.type != INST_IO) {
@@ -122,7 +113,11 @@ static long init_mbbiDirect (
 	return S_db_badField;
     }
 
-    pcanMbbiDirect = malloc(sizeof(mbbiDirectCanPrivate_t));
+    /* Convert the address string into members of the canIo structure */
+    status = canIoParse(prec->inp.value.instio.string, &inp);
+
+    /* Allocate the private structure from the bus memory pool */
+    pcanMbbiDirect = canBusAlloc(inp.canBusID, sizeof(mbbiDirectCanPrivate_t));
     if (pcanMbbiDirect == NULL) {
 	return S_dev_noMemory;
     }
@@ -130,9 +125,7 @@ static long init_mbbiDirect (
     pcanMbbiDirect->prec = (dbCommon *) prec;
     pcanMbbiDirect->ioscanpvt = NULL;
     pcanMbbiDirect->status = NO_ALARM;
-
-    /* Convert the address string into members of the canIo structure */
-    status = canIoParse(prec->inp.value.instio.string, &pcanMbbiDirect->inp);
+    pcanMbbiDirect->inp = inp;
     if (status ||
 	pcanMbbiDirect->inp.parameter < 0 ||
 	pcanMbbiDirect->inp.parameter > 7) {
@@ -163,39 +156,17 @@ static long init_mbbiDirect (
 		pcanMbbiDirect->inp.parameter, prec->mask);
     #endif
 
-    /* Find the bus matching this record */
-    for (pbus = firstBus; pbus != NULL; pbus = pbus->nextBus) {
-      if (pbus->canBusID == pcanMbbiDirect->inp.canBusID) break;
-    }  
-
-    /* If not found, create one */
-    if (pbus == NULL) {
-      pbus = malloc(sizeof (mbbiDirectCanBus_t));
-      if (pbus == NULL) return S_dev_noMemory;
-
-      /* Fill it in */
-      pbus->firstPrivate = NULL;
-      pbus->canBusID = pcanMbbiDirect->inp.canBusID;
-      callbackSetUser(pbus, &pbus->callback);
-      callbackSetCallback(busCallback, &pbus->callback);
-      callbackSetPriority(priorityMedium, &pbus->callback);
-
-      /* and add it to the list of busses we know about */
-      pbus->nextBus = firstBus;
-      firstBus = pbus;
-
-      /* Ask driver for error signals */
-      canSignal(pbus->canBusID, busSignal, pbus);
-    }  
+    /* Find the bus matching this record, or create one */
+    pbus = devCanBusFind(pcanMbbiDirect->inp.canBusID, busCallback);
+    if (pbus == NULL) return S_dev_noMemory;
+    pcanMbbiDirect->pbus = pbus;
 
     /* Insert private record structure into linked list for this CANbus */
     pcanMbbiDirect->nextPrivate = pbus->firstPrivate;
     pbus->firstPrivate = pcanMbbiDirect;
 
-    /* Set the callback parameters for asynchronous processing */
-    callbackSetUser(prec, &pcanMbbiDirect->callback);
-    callbackSetCallback(ProcessCallback, &pcanMbbiDirect->callback);
-    callbackSetPriority(prec->prio, &pcanMbbiDirect->callback);
+    /* Set the request parameters for asynchronous processing */
+    devCanRequestInit(&pcanMbbiDirect->request, (dbCommon *) prec);
 
     /* and create a timer for CANbus RTR timeouts */
     pcanMbbiDirect->timId = epicsTimerQueueCreateTimer(canTimerQ,
@@ -288,16 +259,6 @@ static long read_mbbiDirect (
     }
 }
 
-static void ProcessCallback(CALLBACK *pcallback)
-{
-    dbCommon *pRec;
-
-    callbackGetUser(pRec, pcallback);
-    dbScanLock(pRec);
-    (*pRec->rset->process)(pRec);
-    dbScanUnlock(pRec);
-}
-
 static void mbbiDirectMessage (
     void *private,
     const canMessage_t *pmessage
@@ -313,41 +274,19 @@ static void mbbiDirectMessage (
 
     if (pcanMbbiDirect->prec->scan == SCAN_IO_EVENT) {
 	pcanMbbiDirect->status = NO_ALARM;
-	scanIoRequest(pcanMbbiDirect->ioscanpvt);
+	devCanIoRequest(pcanMbbiDirect->pbus, &pcanMbbiDirect->request,
+			pcanMbbiDirect->ioscanpvt);
     } else if (pcanMbbiDirect->status == TIMEOUT_ALARM) {
 	pcanMbbiDirect->status = NO_ALARM;
 	epicsTimerCancel(pcanMbbiDirect->timId);
-	callbackRequest(&pcanMbbiDirect->callback);
-    }
-}
-
-static void busSignal (
-    void *private,
-    int status
-) {
-    mbbiDirectCanBus_t *pbus = private;
-
-    if (!interruptAccept) return;
-
-    switch(status) {
-	case CAN_BUS_OK:
-	    pbus->status = NO_ALARM;
-	    break;
-	case CAN_BUS_ERROR:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
-	case CAN_BUS_OFF:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
+	devCanCallbackRequest(pcanMbbiDirect->pbus, &pcanMbbiDirect->request);
     }
 }
 
 static void busCallback (
     CALLBACK *pCallback
 ) {
-    mbbiDirectCanBus_t *pbus;
+    devCanBus_t *pbus;
     mbbiDirectCanPrivate_t *pcanMbbiDirect;
 
     callbackGetUser(pbus, pCallback);
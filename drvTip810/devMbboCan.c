@@ -54,13 +54,16 @@ Copyright (c) 1995-2000 Andrew Johnson
 #include <epicsExport.h>
 
 #include "canBus.h"
+#include "devCan.h"
 
 
 #define DO_NOT_CONVERT	2
 
 
 typedef struct mbboCanPrivate_s {
+    devCanRequest_t request;
     struct mbboCanPrivate_s *nextPrivate;
+    devCanBus_t *pbus;
     IOSCANPVT ioscanpvt;
     dbCommon *prec;
     canIo_t out;
@@ -68,19 +71,10 @@ typedef struct mbboCanPrivate_s {
     int status;
 } mbboCanPrivate_t;
 
-typedef struct mbboCanBus_s {
-    CALLBACK callback;
-    struct mbboCanBus_s *nextBus;
-    mbboCanPrivate_t *firstPrivate;
-    void *canBusID;
-    int status;
-} mbboCanBus_t;
-
 static long init_mbbo(struct dbCommon *prec);
 static long get_ioint_info(int cmd, struct dbCommon *prec, IOSCANPVT *ppvt);
 static long write_mbbo(struct mbboRecord *prec);
 static void mbboMessage(void *private, const canMessage_t *pmessage);
-static void busSignal(void *private, int status);
 static void busCallback(CALLBACK *pCallback);
 
 #ifndef HAS_mbbodset
@@ -101,15 +95,14 @@ mbbodset devMbboCan = {
 };
 epicsExportAddress(dset, devMbboCan);
 
-static mbboCanBus_t *firstBus;
-
 
 static long init_mbbo (
     struct dbCommon *pcommon
 ) {
     struct mbboRecord *prec = (struct mbboRecord *) pcommon;
     mbboCanPrivate_t *pcanMbbo;
-    mbboCanBus_t *pbus;
+    devCanBus_t *pbus;
+    canIo_t out;
     int status;
 
     if (prec->out.type != INST_IO) {
@@ -118,7 +111,11 @@ static long init_mbbo (
 	return S_db_badField;
     }
 
-    pcanMbbo = malloc(sizeof(mbboCanPrivate_t));
+    /* Convert the parameter string into members of the canIo structure */
+    status = canIoParse(prec->out.value.instio.string, &out);
+
+    /* Allocate the private structure from the bus memory pool */
+    pcanMbbo = canBusAlloc(out.canBusID, sizeof(mbboCanPrivate_t));
     if (pcanMbbo == NULL) {
 	return S_dev_noMemory;
     }
@@ -126,9 +123,7 @@ static long init_mbbo (
     pcanMbbo->prec = (dbCommon *) prec;
     pcanMbbo->ioscanpvt = NULL;
     pcanMbbo->status = NO_ALARM;
-
-    /* Convert the parameter string into members of the canIo structure */
-    status = canIoParse(prec->out.value.instio.string, &pcanMbbo->out);
+    pcanMbbo->out = out;
     if (status ||
 	pcanMbbo->out.parameter < 0 ||
 	pcanMbbo->out.parameter > 7) {
@@ -158,35 +153,18 @@ static long init_mbbo (
 	printf("  bit=%ld, mask=%#lx\n", pcanMbbo->out.parameter, prec->mask);
     #endif
 
-    /* Find the bus matching this record */
-    for (pbus = firstBus; pbus != NULL; pbus = pbus->nextBus) {
-    	if (pbus->canBusID == pcanMbbo->out.canBusID) break;
-    }
-
-    /* If not found, create one */
-    if (pbus == NULL) {
-	pbus = malloc(sizeof (mbboCanBus_t));
-	if (pbus == NULL) return S_dev_noMemory;
-
-	/* Fill it in */
-	pbus->firstPrivate = NULL;
-	pbus->canBusID = pcanMbbo->out.canBusID;
-	callbackSetUser(pbus, &pbus->callback);
-	callbackSetCallback(busCallback, &pbus->callback);
-	callbackSetPriority(priorityMedium, &pbus->callback);
-
-	/* and add it to the list of busses we know about */
-	pbus->nextBus = firstBus;
-	firstBus = pbus;
-
-	/* Ask driver for error signals */
-	canSignal(pbus->canBusID, busSignal, pbus);
-    }
+    /* Find the bus matching this record, or create one */
+    pbus = devCanBusFind(pcanMbbo->out.canBusID, busCallback);
+    if (pbus == NULL) return S_dev_noMemory;
+    pcanMbbo->pbus = pbus;
 
     /* Insert private record structure into linked list for this CANbus */
     pcanMbbo->nextPrivate = pbus->firstPrivate;
     pbus->firstPrivate = pcanMbbo;
 
+    /* Set the request parameters for I/O Interrupt processing */
+    devCanRequestInit(&pcanMbbo->request, (dbCommon *) prec);
+
     /* Register the message handler with the Canbus driver */
     canMessage(pcanMbbo->out.canBusID, pcanMbbo->out.identifier,
 		mbboMessage, pcanMbbo);
@@ -252,8 +230,12 @@ static long write_mbbo (
 			    pcanMbbo->data);
 		#endif
 
-		status = canWrite(pcanMbbo->out.canBusID, &message, 
-				  pcanMbbo->out.timeout);
+		/* Cyclic messages only need their payload updating */
+		status = canCyclicUpdate(pcanMbbo->out.canBusID, &message);
+		if (status == S_can_noMessage) {
+		    status = canWrite(pcanMbbo->out.canBusID, &message,
+				      pcanMbbo->out.timeout);
+		}
 		if (status) {
 		    #ifdef DEBUG
 			printf("canMbbo %s: canWrite status=%#x\n",
@@ -283,37 +265,15 @@ static void mbboMessage (
     if (pcanMbbo->prec->scan == SCAN_IO_EVENT &&
 	pmessage->rtr == RTR) {
 	pcanMbbo->status = NO_ALARM;
-	scanIoRequest(pcanMbbo->ioscanpvt);
-    }
-}
-
-static void busSignal (
-    void *private,
-    int status
-) {
-    mbboCanBus_t *pbus = private;
-
-    if (!interruptAccept) return;
-
-    switch(status) {
-	case CAN_BUS_OK:
-	    pbus->status = NO_ALARM;
-	    break;
-	case CAN_BUS_ERROR:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
-	case CAN_BUS_OFF:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
+	devCanIoRequest(pcanMbbo->pbus, &pcanMbbo->request,
+			pcanMbbo->ioscanpvt);
     }
 }
 
 static void busCallback (
     CALLBACK *pCallback
 ) {
-    mbboCanBus_t *pbus;
+    devCanBus_t *pbus;
     mbboCanPrivate_t *pcanMbbo;
 
     callbackGetUser(pbus, pCallback);
@@ -54,13 +54,16 @@ Copyright (c) 1995-2000 Andrew Johnson
 #include <epicsExport.h>
 
 #include "canBus.h"
+#include "devCan.h"
 
 
 #define DO_NOT_CONVERT	2
 
 
 typedef struct mbboDirectCanPrivate_s {
+    devCanRequest_t request;
     struct mbboDirectCanPrivate_s *nextPrivate;
+    devCanBus_t *pbus;
     IOSCANPVT ioscanpvt;
     dbCommon *prec;
     canIo_t out;
@@ -68,19 +71,10 @@ typedef struct mbboDirectCanPrivate_s {
     int status;
 } mbboDirectCanPrivate_t;
 
-typedef struct mbboDirectCanBus_s {
-    CALLBACK callback;
-    struct mbboDirectCanBus_s *nextBus;
-    mbboDirectCanPrivate_t *firstPrivate;
-    void *canBusID;
-    int status;
-} mbboDirectCanBus_t;
-
 static long init_mbboDirect(struct dbCommon *prec);
 static long get_ioint_info(int cmd, struct dbCommon *prec, IOSCANPVT *ppvt);
 static long write_mbboDirect(struct mbboDirectRecord *prec);
 static void mbboDirectMessage(void *private, const canMessage_t *pmessage);
-static void busSignal(void *private, int status);
 static void busCallback(CALLBACK *pCallback);
 
 #ifndef HAS_mbbodirectdset
@@ -101,15 +95,14 @@ mbbodirectdset devMbboDirectCan = {
 };
 epicsExportAddress(dset, devMbboDirectCan);
 
-static mbboDirectCanBus_t *firstBus;
-
 
 static long init_mbboDirect (
     struct dbCommon *pcommon
 ) {
     struct mbboDirectRecord *prec = (struct mbboDirectRecord *) pcommon;
     mbboDirectCanPrivate_t *pcanMbboDirect;
-    mbboDirectCanBus_t *pbus;
+    devCanBus_t *pbus;
+    canIo_t out;
     int status;
 
     if (prec->out.type != INST_IO) {
@@ -118,7 +111,11 @@ static long init_mbboDirect (
 	return S_db_badField;
     }
 
-    pcanMbboDirect = malloc(sizeof(mbboDirectCanPrivate_t));
+    /* Convert the parameter string into members of the canIo structure */
+    status = canIoParse(prec->out.value.instio.string, &out);
+
+    /* Allocate the private structure from the bus memory pool */
+    pcanMbboDirect = canBusAlloc(out.canBusID, sizeof(mbboDirectCanPrivate_t));
     if (pcanMbboDirect == NULL) {
 	return S_dev_noMemory;
     }
@@ -126,9 +123,7 @@ static long init_mbboDirect (
     pcanMbboDirect->prec = (dbCommon *) prec;
     pcanMbboDirect->ioscanpvt = NULL;
     pcanMbboDirect->status = NO_ALARM;
-
-    /* Convert the parameter string into members of the canIo structure */
-    status = canIoParse(prec->out.value.instio.string, &pcanMbboDirect->out);
+    pcanMbboDirect->out = out;
     if (status ||
 	pcanMbboDirect->out.parameter < 0 ||
 	pcanMbboDirect->out.parameter > 7) {
@@ -158,35 +153,18 @@ static long init_mbboDirect (
 	printf("  bit=%ld, mask=%#lx\n", pcanMbboDirect->out.parameter, prec->mask);
     #endif
 
-    /* Find the bus matching this record */
-    for (pbus = firstBus; pbus != NULL; pbus = pbus->nextBus) {
-    	if (pbus->canBusID == pcanMbboDirect->out.canBusID) break;
-    }
-
-    /* If not found, create one */
-    if (pbus == NULL) {
-	pbus = malloc(sizeof (mbboDirectCanBus_t));
-	if (pbus == NULL) return S_dev_noMemory;
-
-	/* Fill it in */
-	pbus->firstPrivate = NULL;
-	pbus->canBusID = pcanMbboDirect->out.canBusID;
-	callbackSetUser(pbus, &pbus->callback);
-	callbackSetCallback(busCallback, &pbus->callback);
-	callbackSetPriority(priorityMedium, &pbus->callback);
-
-	/* and add it to the list of busses we know about */
-	pbus->nextBus = firstBus;
-	firstBus = pbus;
-
-	/* Ask driver for error signals */
-	canSignal(pbus->canBusID, busSignal, pbus);
-    }
+    /* Find the bus matching this record, or create one */
+    pbus = devCanBusFind(pcanMbboDirect->out.canBusID, busCallback);
+    if (pbus == NULL) return S_dev_noMemory;
+    pcanMbboDirect->pbus = pbus;
 
     /* Insert private record structure into linked list for this CANbus */
     pcanMbboDirect->nextPrivate = pbus->firstPrivate;
     pbus->firstPrivate = pcanMbboDirect;
 
+    /* Set the request parameters for I/O Interrupt processing */
+    devCanRequestInit(&pcanMbboDirect->request, (dbCommon *) prec);
+
     /* Register the message handler with the Canbus driver */
     canMessage(pcanMbboDirect->out.canBusID, pcanMbboDirect->out.identifier,
 		mbboDirectMessage, pcanMbboDirect);
@@ -252,8 +230,12 @@ static long write_mbboDirect (
 			    pcanMbboDirect->data);
 		#endif
 
-		status = canWrite(pcanMbboDirect->out.canBusID, &message, 
-				  pcanMbboDirect->out.timeout);
+		/* Cyclic messages only need their payload updating */
+		status = canCyclicUpdate(pcanMbboDirect->out.canBusID, &message);
+		if (status == S_can_noMessage) {
+		    status = canWrite(pcanMbboDirect->out.canBusID, &message,
+				      pcanMbboDirect->out.timeout);
+		}
 		if (status) {
 		    #ifdef DEBUG
 			printf("canMbboDirect %s: canWrite status=%#x\n",
@@ -283,37 +265,15 @@ static void mbboDirectMessage (
     if (pcanMbboDirect->prec->scan == SCAN_IO_EVENT &&
 	pmessage->rtr == RTR) {
 	pcanMbboDirect->status = NO_ALARM;
-	scanIoRequest(pcanMbboDirect->ioscanpvt);
-    }
-}
-
-static void busSignal (
-    void *private,
-    int status
-) {
-    mbboDirectCanBus_t *pbus = private;
-
-    if (!interruptAccept) return;
-
-    switch(status) {
-	case CAN_BUS_OK:
-	    pbus->status = NO_ALARM;
-	    break;
-	case CAN_BUS_ERROR:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
-	case CAN_BUS_OFF:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
+	devCanIoRequest(pcanMbboDirect->pbus, &pcanMbboDirect->request,
+			pcanMbboDirect->ioscanpvt);
     }
 }
 
 static void busCallback (
     CALLBACK *pCallback
 ) {
-    mbboDirectCanBus_t *pbus;
+    devCanBus_t *pbus;
     mbboDirectCanPrivate_t *pcanMbboDirect;
 
     callbackGetUser(pbus, pCallback);
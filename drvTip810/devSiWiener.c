@@ -57,11 +57,13 @@ Copyright (c) 1995-2000 Carl Lionberger and Andrew Johnson
 #include <epicsExport.h>
 
 #include "canBus.h"
+#include "devCan.h"
 
 
 typedef struct siCanPrivate_s {
-    CALLBACK callback;
+    devCanRequest_t request;
     struct siCanPrivate_s *nextPrivate;
+    devCanBus_t *pbus;
     epicsTimerId timId;
     IOSCANPVT ioscanpvt;
     dbCommon *prec;
@@ -70,20 +72,10 @@ typedef struct siCanPrivate_s {
     int status;
 } siCanPrivate_t;
 
-typedef struct siCanBus_s {
-    CALLBACK callback;
-    struct siCanBus_s *nextBus;
-    siCanPrivate_t *firstPrivate;
-    void *canBusID;
-    int status;
-} siCanBus_t;
-
 static long init_si(struct dbCommon *prec);
 static long get_ioint_info(int cmd, struct dbCommon *prec, IOSCANPVT *ppvt);
 static long read_si(struct stringinRecord *prec);
-static void ProcessCallback(CALLBACK *pcallback);
 static void siMessage(void *private, const canMessage_t *pmessage);
-static void busSignal(void *private, int status);
 static void busCallback(CALLBACK *pCallback);
 
 #ifndef HAS_stringindset
@@ -104,14 +96,13 @@ stringindset devSiWiener = {
 };
 epicsExportAddress(dset, devSiWiener);
 
-static siCanBus_t *firstBus;
-
 static long init_si (
     struct dbCommon *pcommon
 ) {
     struct stringinRecord *prec = (struct stringinRecord *) pcommon;
     siCanPrivate_t *pcanSi;
-    siCanBus_t *pbus;
+    devCanBus_t *pbus;
+    canIo_t inp;
     int status;
 
     if (prec->inp.type != INST_IO) {
@@ -120,7 +111,11 @@ static long init_si (
 	return S_db_badField;
     }
 
-    pcanSi = malloc(sizeof(siCanPrivate_t));
+    /* Convert the address string into members of the canIo structure */
+    status = canIoParse(prec->inp.value.instio.string, &inp);
+
+    /* Allocate the private structure from the bus memory pool */
+    pcanSi = canBusAlloc(inp.canBusID, sizeof(siCanPrivate_t));
     if (pcanSi == NULL) {
 	return S_dev_noMemory;
     }
@@ -128,9 +123,7 @@ static long init_si (
     pcanSi->prec = (dbCommon *) prec;
     pcanSi->ioscanpvt = NULL;
     pcanSi->status = NO_ALARM;
-
-    /* Convert the address string into members of the canIo structure */
-    status = canIoParse(prec->inp.value.instio.string, &pcanSi->inp);
+    pcanSi->inp = inp;
     if (status) {
 	if (canSilenceErrors) {
 	    pcanSi->inp.canBusID = NULL;
@@ -149,39 +142,17 @@ static long init_si (
 		pcanSi->inp.offset, pcanSi->inp.parameter);
     #endif
 
-    /* Find the bus matching this record */
-    for (pbus = firstBus; pbus != NULL; pbus = pbus->nextBus) {
-    	if (pbus->canBusID == pcanSi->inp.canBusID) break;
-    }
-
-    /* If not found, create one */
-    if (pbus == NULL) {
-	pbus = malloc(sizeof (siCanBus_t));
-	if (pbus == NULL) return S_dev_noMemory;
-
-	/* Fill it in */
-	pbus->firstPrivate = NULL;
-	pbus->canBusID = pcanSi->inp.canBusID;
-	callbackSetUser(pbus, &pbus->callback);
-	callbackSetCallback(busCallback, &pbus->callback);
-	callbackSetPriority(priorityMedium, &pbus->callback);
-
-	/* and add it to the list of busses we know about */
-	pbus->nextBus = firstBus;
-	firstBus = pbus;
-
-	/* Ask driver for error signals */
-	canSignal(pbus->canBusID, busSignal, pbus);
-    }
+    /* Find the bus matching this record, or create one */
+    pbus = devCanBusFind(pcanSi->inp.canBusID, busCallback);
+    if (pbus == NULL) return S_dev_noMemory;
+    pcanSi->pbus = pbus;
 
     /* Insert private record structure into linked list for this CANbus */
     pcanSi->nextPrivate = pbus->firstPrivate;
     pbus->firstPrivate = pcanSi;
 
-    /* Set the callback parameters for asynchronous processing */
-    callbackSetUser(prec, &pcanSi->callback);
-    callbackSetCallback(ProcessCallback, &pcanSi->callback);
-    callbackSetPriority(prec->prio, &pcanSi->callback);
+    /* Set the request parameters for asynchronous processing */
+    devCanRequestInit(&pcanSi->request, (dbCommon *) prec);
 
     /* and create a timer for CANbus RTR timeouts */
     pcanSi->timId = epicsTimerQueueCreateTimer(canTimerQ,
@@ -271,16 +242,6 @@ static long read_si (
     }
 }
 
-static void ProcessCallback(CALLBACK *pcallback)
-{
-    dbCommon *pRec;
-
-    callbackGetUser(pRec, pcallback);
-    dbScanLock(pRec);
-    (*pRec->rset->process)(pRec);
-    dbScanUnlock(pRec);
-}
-
 static void siMessage (
     void *private,
     const canMessage_t *pmessage
@@ -302,41 +263,18 @@ static void siMessage (
 
     if (pcanSi->prec->scan == SCAN_IO_EVENT) {
 	pcanSi->status = NO_ALARM;
-	scanIoRequest(pcanSi->ioscanpvt);
+	devCanIoRequest(pcanSi->pbus, &pcanSi->request, pcanSi->ioscanpvt);
     } else if (pcanSi->status == TIMEOUT_ALARM) {
 	pcanSi->status = NO_ALARM;
 	epicsTimerCancel(pcanSi->timId);
-	callbackRequest(&pcanSi->callback);
-    }
-}
-
-static void busSignal (
-    void *private,
-    int status
-) {
-    siCanBus_t *pbus = private;
-
-    if (!interruptAccept) return;
-
-    switch(status) {
-	case CAN_BUS_OK:
-	    pbus->status = NO_ALARM;
-	    break;
-	case CAN_BUS_ERROR:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
-	case CAN_BUS_OFF:
-	    pbus->status = COMM_ALARM;
-	    callbackRequest(&pbus->callback);
-	    break;
+	devCanCallbackRequest(pcanSi->pbus, &pcanSi->request);
     }
 }
 
 static void busCallback (
     CALLBACK *pCallback
 ) {
-    siCanBus_t *pbus;
+    devCanBus_t *pbus;
     siCanPrivate_t *pcanSi;
 
     callbackGetUser(pbus, pCallback);
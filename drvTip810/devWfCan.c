@@ -0,0 +1,618 @@
+/*******************************************************************************
+
+Project:
+    CAN Bus Driver for EPICS
+
+File:
+    devWfCan.c
+
+Description:
+    CANBUS Waveform and Array Analogue Input device support, capturing
+    every message from one identifier into a double-buffered array.
+
+Author:
+    Andrew Johnson <Andrew.N.Johnson@gmail.com>
+Created:
+    18 October 2026
+
+Copyright (c) 1995-2000 Andrew Johnson
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*******************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <epicsTypes.h>
+#include <epicsTime.h>
+#include <epicsTimer.h>
+#include <epicsMutex.h>
+#include <errMdef.h>
+#include <devLib.h>
+#include <dbDefs.h>
+#include <dbAccess.h>
+#include <dbScan.h>
+#include <callback.h>
+#include <link.h>
+#include <alarm.h>
+#include <recGbl.h>
+#include <recSup.h>
+#include <devSup.h>
+#include <dbCommon.h>
+#include <menuFtype.h>
+#include <waveformRecord.h>
+#include <aaiRecord.h>
+#include <epicsExport.h>
+
+#include "canBus.h"
+#include "devCan.h"
+
+
+/* Messages are collected into the fill buffer by the driver's receive
+ * task.  When the block is complete, either because it holds the requested
+ * number of samples or its time window has expired, the fill and ready
+ * buffers are swapped and the record is processed to copy out the ready
+ * one.  If the record hasn't read the previous block by then it is lost.
+ */
+
+typedef struct wfCanPrivate_s {
+    devCanRequest_t request;
+    struct wfCanPrivate_s *nextPrivate;
+    devCanBus_t *pbus;
+    IOSCANPVT ioscanpvt;
+    dbCommon *prec;
+    canIo_t inp;
+    epicsUInt32 mask;
+    epicsUInt32 sign;
+    int frames;			/* Capture whole message data */
+    size_t unit;		/* Bytes per sample */
+    unsigned int bytes;		/* Message bytes per raw sample */
+    epicsUInt32 block;		/* Samples per block */
+    epicsUInt64 window;		/* Block time limit in ns, 0 = none */
+    epicsTimerId timId;
+    epicsMutexId lock;		/* Protects the following */
+    epicsUInt8 *pbuf[2];
+    int fill;			/* Index of the fill buffer */
+    epicsUInt32 count;		/* Samples in the fill buffer */
+    epicsUInt32 ready;		/* Samples in the ready buffer, 0 = none */
+    epicsUInt64 start;		/* Time of first sample in fill buffer */
+    unsigned long lost;		/* Blocks overwritten before being read */
+    unsigned long lostSeen;
+    int status;
+} wfCanPrivate_t;
+
+static long init_wf(struct dbCommon *prec);
+static long init_aai(struct dbCommon *prec);
+static long get_ioint_info(int cmd, struct dbCommon *prec, IOSCANPVT *ppvt);
+static long read_wf(struct waveformRecord *prec);
+static long read_aai(struct aaiRecord *prec);
+static void wfMessage(void *private, const canMessage_t *pmessage);
+static void windowExpired(void *private);
+static void busCallback(CALLBACK *pCallback);
+
+#ifndef HAS_wfdset
+typedef struct wfdset {
+    dset common;
+    long (*read_wf)(struct waveformRecord *prec);
+} wfdset;
+#endif
+wfdset devWfCan = {
+    {
+        5,
+        NULL,
+        NULL,
+        init_wf,
+        get_ioint_info
+    },
+    read_wf
+};
+epicsExportAddress(dset, devWfCan);
+
+#ifndef HAS_aaidset
+typedef struct aaidset {
+    dset common;
+    long (*read_aai)(struct aaiRecord *prec);
+} aaidset;
+#endif
+aaidset devAaiCan = {
+    {
+        5,
+        NULL,
+        NULL,
+        init_aai,
+        get_ioint_info
+    },
+    read_aai
+};
+epicsExportAddress(dset, devAaiCan);
+
+
+/*******************************************************************************
+
+Routine:
+    initArray
+
+Purpose:
+    Common record initialisation for waveform and aai records
+
+Description:
+    The address is parsed as for an ai record, with the final parameter
+    giving the raw sample size, optionally followed by some keywords:
+
+	bus[/timeout]:id[.offset] size [n=<samples>] [ms=<window>]
+	bus[/timeout]:id 0 frames [n=<messages>] [ms=<window>]
+
+    In the first form one sample is decoded from every message long enough
+    to hold it and the array may have any numeric FTVL.  The second form copies all eight data
+    bytes of each message into a CHAR or UCHAR array, zero-padded to the
+    full message size.  The block size defaults to the largest that fits in
+    NELM elements; the optional time window in milliseconds completes a
+    partly filled block that many milliseconds after its first sample.
+
+Returns:
+    0, or an error status.
+
+*/
+
+static long initArray (
+    dbCommon *prec,
+    DBLINK *plink,
+    epicsEnum16 ftvl,
+    epicsUInt32 nelm
+) {
+    wfCanPrivate_t *pcanWf;
+    devCanBus_t *pbus;
+    canIo_t inp;
+    epicsUInt32 fsd, capacity;
+    double window = 0.0;
+    long block = 0;
+    char *options;
+    int status;
+
+    if (plink->type != INST_IO) {
+	recGblRecordError(S_db_badField, prec,
+			  "devWfCan (init_record) Illegal INP field");
+	return S_db_badField;
+    }
+
+    /* Convert the address string into members of the canIo structure */
+    status = canIoParse(plink->value.instio.string, &inp);
+
+    /* Allocate the private structure from the bus memory pool */
+    pcanWf = canBusAlloc(inp.canBusID, sizeof(wfCanPrivate_t));
+    if (pcanWf == NULL) {
+	return S_dev_noMemory;
+    }
+    prec->dpvt = pcanWf;
+    pcanWf->prec = prec;
+    pcanWf->ioscanpvt = NULL;
+    pcanWf->status = NO_ALARM;
+    pcanWf->inp = inp;
+    if (status) {
+	if (canSilenceErrors) {
+	    pcanWf->inp.canBusID = NULL;
+	    prec->pact = TRUE;
+	    return 0;
+	} else {
+	    recGblRecordError(S_can_badAddress, prec,
+			      "devWfCan (init_record) bad CAN address");
+	    return S_can_badAddress;
+	}
+    }
+
+    /* Pick out the keywords following the parameter */
+    options = pcanWf->inp.paramStr;
+    while (options && *options) {
+	if (isspace(0xff & *options)) {
+	    options++;
+	} else if (strncmp(options, "frames", 6) == 0) {
+	    pcanWf->frames = TRUE;
+	    options += 6;
+	} else if (strncmp(options, "n=", 2) == 0) {
+	    block = strtol(options + 2, &options, 0);
+	} else if (strncmp(options, "ms=", 3) == 0) {
+	    window = strtod(options + 3, &options) / 1000.0;
+	} else {
+	    recGblRecordError(S_can_badAddress, prec,
+			      "devWfCan (init_record) bad parameter");
+	    return S_can_badAddress;
+	}
+    }
+
+    #ifdef DEBUG
+	printf("wfCan %s: Init bus=%s, id=%#x, off=%u, parm=%ld, n=%ld, "
+		"ms=%g, frames=%d\n", prec->name, pcanWf->inp.busName,
+		pcanWf->inp.identifier, pcanWf->inp.offset,
+		pcanWf->inp.parameter, block, window * 1000.0,
+		pcanWf->frames);
+    #endif
+
+    if (pcanWf->frames) {
+	if (ftvl != menuFtypeCHAR && ftvl != menuFtypeUCHAR) {
+	    recGblRecordError(S_db_badField, prec,
+			      "devWfCan (init_record) frames need CHAR FTVL");
+	    return S_db_badField;
+	}
+	pcanWf->unit = CAN_DATA_SIZE;
+	capacity = nelm / CAN_DATA_SIZE;
+    } else {
+	switch (ftvl) {
+	case menuFtypeCHAR:
+	case menuFtypeUCHAR:
+	case menuFtypeSHORT:
+	case menuFtypeUSHORT:
+	case menuFtypeLONG:
+	case menuFtypeULONG:
+	case menuFtypeFLOAT:
+	case menuFtypeDOUBLE:
+	    break;
+	default:
+	    recGblRecordError(S_db_badField, prec,
+			      "devWfCan (init_record) Illegal FTVL field");
+	    return S_db_badField;
+	}
+
+	/* Raw sample size as for the ai record, must be non-zero here */
+	fsd = abs(pcanWf->inp.parameter);
+	if (fsd == 0) {
+	    recGblRecordError(S_can_badAddress, prec,
+			      "devWfCan (init_record) no sample size");
+	    return S_can_badAddress;
+	}
+	if ((fsd & (fsd-1)) == 0) {
+	    fsd--;
+	}
+	pcanWf->mask = 1;
+	while (pcanWf->mask < fsd) {
+	    pcanWf->mask <<= 1;
+	}
+	pcanWf->mask--;
+	if (pcanWf->inp.parameter < 0) {
+	    pcanWf->sign = (pcanWf->mask >> 1) + 1;
+	}
+	pcanWf->bytes = pcanWf->mask <= 0xff ? 1 :
+			pcanWf->mask <= 0xffff ? 2 :
+			pcanWf->mask <= 0xffffff ? 3 : 4;
+	if (pcanWf->inp.offset + pcanWf->bytes > CAN_DATA_SIZE) {
+	    recGblRecordError(S_can_badAddress, prec,
+			      "devWfCan (init_record) sample beyond message");
+	    return S_can_badAddress;
+	}
+	pcanWf->unit = sizeof(epicsInt32);
+	capacity = nelm;
+    }
+
+    if (capacity == 0) {
+	recGblRecordError(S_db_badField, prec,
+			  "devWfCan (init_record) NELM too small");
+	return S_db_badField;
+    }
+    if (block <= 0 || block > capacity) {
+	block = capacity;
+    }
+    pcanWf->block = block;
+    pcanWf->window = (epicsUInt64) (window * 1e9);
+
+    /* The two halves of the double buffer */
+    pcanWf->pbuf[0] = canBusAlloc(pcanWf->inp.canBusID,
+				  2 * block * pcanWf->unit);
+    if (pcanWf->pbuf[0] == NULL) {
+	return S_dev_noMemory;
+    }
+    pcanWf->pbuf[1] = pcanWf->pbuf[0] + block * pcanWf->unit;
+    pcanWf->lock = epicsMutexMustCreate();
+
+    if (pcanWf->window) {
+	pcanWf->timId = epicsTimerQueueCreateTimer(canTimerQ,
+						   windowExpired, pcanWf);
+	if (pcanWf->timId == NULL) {
+	    return S_dev_noMemory;
+	}
+    }
+
+    /* Find the bus matching this record, or create one */
+    pbus = devCanBusFind(pcanWf->inp.canBusID, busCallback);
+    if (pbus == NULL) return S_dev_noMemory;
+    pcanWf->pbus = pbus;
+
+    /* Insert private record structure into linked list for this CANbus */
+    pcanWf->nextPrivate = pbus->firstPrivate;
+    pbus->firstPrivate = pcanWf;
+
+    /* Set the request parameters for I/O Interrupt processing */
+    devCanRequestInit(&pcanWf->request, prec);
+
+    /* Register the message handler with the Canbus driver */
+    canMessage(pcanWf->inp.canBusID, pcanWf->inp.identifier, wfMessage, pcanWf);
+
+    return 0;
+}
+
+static long init_wf (
+    struct dbCommon *pcommon
+) {
+    struct waveformRecord *prec = (struct waveformRecord *) pcommon;
+
+    return initArray(pcommon, &prec->inp, prec->ftvl, prec->nelm);
+}
+
+static long init_aai (
+    struct dbCommon *pcommon
+) {
+    struct aaiRecord *prec = (struct aaiRecord *) pcommon;
+
+    return initArray(pcommon, &prec->inp, prec->ftvl, prec->nelm);
+}
+
+static long get_ioint_info (
+    int cmd,
+    struct dbCommon *prec,
+    IOSCANPVT *ppvt
+) {
+    wfCanPrivate_t *pcanWf = prec->dpvt;
+
+    if (pcanWf->ioscanpvt == NULL) {
+	scanIoInit(&pcanWf->ioscanpvt);
+    }
+
+    #ifdef DEBUG
+	printf("canWf %s: get_ioint_info %d\n", prec->name, cmd);
+    #endif
+
+    *ppvt = pcanWf->ioscanpvt;
+    return 0;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    readArray
+
+Purpose:
+    Copy the ready buffer into the record's array
+
+Description:
+    Converts the samples of the last completed block into the record's
+    FTVL and sets NORD.  If no new block is ready the array is left alone.
+    Blocks that were lost since the last read raise a minor READ alarm.
+
+Returns:
+    0
+
+*/
+
+static long readArray (
+    dbCommon *prec,
+    void *bptr,
+    epicsEnum16 ftvl,
+    epicsUInt32 *pnord
+) {
+    wfCanPrivate_t *pcanWf = prec->dpvt;
+    const epicsInt32 *psample;
+    epicsUInt32 i, count;
+
+    if (pcanWf->inp.canBusID == NULL) {
+	return 0;
+    }
+
+    switch (pcanWf->status) {
+	case COMM_ALARM:
+	    recGblSetSevr(prec, pcanWf->status, INVALID_ALARM);
+	    pcanWf->status = NO_ALARM;
+	    return 0;
+	case NO_ALARM:
+	    break;
+	default:
+	    recGblSetSevr(prec, UDF_ALARM, INVALID_ALARM);
+	    pcanWf->status = NO_ALARM;
+	    return 0;
+    }
+
+    epicsMutexMustLock(pcanWf->lock);
+    count = pcanWf->ready;
+    if (count == 0) {
+	epicsMutexUnlock(pcanWf->lock);
+	return 0;
+    }
+    pcanWf->ready = 0;
+
+    if (pcanWf->frames) {
+	memcpy(bptr, pcanWf->pbuf[!pcanWf->fill], count * CAN_DATA_SIZE);
+	*pnord = count * CAN_DATA_SIZE;
+    } else {
+	psample = (const epicsInt32 *) pcanWf->pbuf[!pcanWf->fill];
+	for (i = 0; i < count; i++) {
+	    switch (ftvl) {
+	    case menuFtypeCHAR:
+		((epicsInt8 *) bptr)[i] = psample[i];
+		break;
+	    case menuFtypeUCHAR:
+		((epicsUInt8 *) bptr)[i] = psample[i];
+		break;
+	    case menuFtypeSHORT:
+		((epicsInt16 *) bptr)[i] = psample[i];
+		break;
+	    case menuFtypeUSHORT:
+		((epicsUInt16 *) bptr)[i] = psample[i];
+		break;
+	    case menuFtypeLONG:
+		((epicsInt32 *) bptr)[i] = psample[i];
+		break;
+	    case menuFtypeULONG:
+		((epicsUInt32 *) bptr)[i] = psample[i];
+		break;
+	    case menuFtypeFLOAT:
+		((epicsFloat32 *) bptr)[i] = psample[i];
+		break;
+	    case menuFtypeDOUBLE:
+		((epicsFloat64 *) bptr)[i] = psample[i];
+		break;
+	    }
+	}
+	*pnord = count;
+    }
+
+    if (pcanWf->lost != pcanWf->lostSeen) {
+	pcanWf->lostSeen = pcanWf->lost;
+	recGblSetSevr(prec, READ_ALARM, MINOR_ALARM);
+    }
+    epicsMutexUnlock(pcanWf->lock);
+
+    #ifdef DEBUG
+	printf("canWf %s: read %u samples\n", prec->name, count);
+    #endif
+
+    prec->udf = FALSE;
+    return 0;
+}
+
+static long read_wf (
+    struct waveformRecord *prec
+) {
+    return readArray((dbCommon *) prec, prec->bptr, prec->ftvl, &prec->nord);
+}
+
+static long read_aai (
+    struct aaiRecord *prec
+) {
+    return readArray((dbCommon *) prec, prec->bptr, prec->ftvl, &prec->nord);
+}
+
+
+/* Swap the buffers, called with the lock held and a non-empty fill buffer */
+
+static void swapBlock (
+    wfCanPrivate_t *pcanWf
+) {
+    if (pcanWf->ready) {
+	pcanWf->lost++;
+    }
+    pcanWf->ready = pcanWf->count;
+    pcanWf->fill = !pcanWf->fill;
+    pcanWf->count = 0;
+}
+
+static void windowExpired (
+    void *private
+) {
+    wfCanPrivate_t *pcanWf = private;
+    epicsUInt64 now = epicsMonotonicGet();
+    int swapped = FALSE;
+
+    epicsMutexMustLock(pcanWf->lock);
+    if (pcanWf->count) {
+	if (now - pcanWf->start >= pcanWf->window) {
+	    swapBlock(pcanWf);
+	    swapped = TRUE;
+	} else {
+	    /* Raced with a completed block, wait for the new one's window */
+	    epicsTimerStartDelay(pcanWf->timId,
+		(pcanWf->window - (now - pcanWf->start)) / 1e9);
+	}
+    }
+    epicsMutexUnlock(pcanWf->lock);
+
+    if (swapped && pcanWf->prec->scan == SCAN_IO_EVENT) {
+	devCanIoRequest(pcanWf->pbus, &pcanWf->request, pcanWf->ioscanpvt);
+    }
+}
+
+static void wfMessage (
+    void *private,
+    const canMessage_t *pmessage
+) {
+    wfCanPrivate_t *pcanWf = private;
+    epicsUInt8 *pslot;
+    epicsUInt32 data;
+    const epicsUInt8 *pdata;
+    unsigned int length;
+    int swapped = FALSE;
+
+    if (!interruptAccept ||
+	pmessage->rtr == RTR) {
+	return;
+    }
+
+    /* The DLC field can hold 9-15, which mean 8 data bytes */
+    length = pmessage->length > CAN_DATA_SIZE ? CAN_DATA_SIZE :
+	     pmessage->length;
+    if (!pcanWf->frames && pcanWf->inp.offset + pcanWf->bytes > length) {
+	return;		/* Too short to hold the sample */
+    }
+
+    epicsMutexMustLock(pcanWf->lock);
+    pslot = pcanWf->pbuf[pcanWf->fill] + pcanWf->count * pcanWf->unit;
+
+    if (pcanWf->frames) {
+	memcpy(pslot, pmessage->data, length);
+	memset(pslot + length, 0, CAN_DATA_SIZE - length);
+    } else {
+	pdata = &pmessage->data[pcanWf->inp.offset];
+	if (pcanWf->mask <= 0xff) {
+	    data = pdata[0];
+	} else if (pcanWf->mask <= 0xffff) {
+	    data = pdata[0] <<  8 | pdata[1];
+	} else if (pcanWf->mask <= 0xffffff) {
+	    data = pdata[0] << 16 | pdata[1] <<  8 | pdata[2];
+	} else {
+	    data = pdata[0] << 24 | pdata[1] << 16 | pdata[2] <<  8 | pdata[3];
+	}
+	data &= pcanWf->mask;
+	if (pcanWf->sign & data) {
+	    data |= ~pcanWf->mask;
+	}
+	*(epicsInt32 *) pslot = data;
+    }
+
+    if (pcanWf->count++ == 0 && pcanWf->window) {
+	pcanWf->start = epicsMonotonicGet();
+	if (pcanWf->count < pcanWf->block) {
+	    epicsTimerStartDelay(pcanWf->timId, pcanWf->window / 1e9);
+	}
+    }
+    if (pcanWf->count >= pcanWf->block) {
+	swapBlock(pcanWf);
+	swapped = TRUE;
+    }
+    epicsMutexUnlock(pcanWf->lock);
+
+    if (swapped && pcanWf->prec->scan == SCAN_IO_EVENT) {
+	devCanIoRequest(pcanWf->pbus, &pcanWf->request, pcanWf->ioscanpvt);
+    }
+}
+
+static void busCallback (
+    CALLBACK *pCallback
+) {
+    devCanBus_t *pbus;
+    wfCanPrivate_t *pcanWf;
+
+    callbackGetUser(pbus, pCallback);
+    pcanWf = pbus->firstPrivate;
+
+    while (pcanWf != NULL) {
+	dbCommon *prec = pcanWf->prec;
+	pcanWf->status = pbus->status;
+	dbScanLock(prec);
+	prec->rset->process(prec);
+	dbScanUnlock(prec);
+	pcanWf = pcanWf->nextPrivate;
+    }
+}
@@ -38,6 +38,7 @@ Copyright (c) 1995-2007 Andrew Johnson
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <math.h>
 
 #include <epicsTypes.h>
 #include <iocsh.h>
@@ -47,12 +48,14 @@ Copyright (c) 1995-2007 Andrew Johnson
 #include <epicsEvent.h>
 #include <epicsMutex.h>
 #include <epicsTimer.h>
+#include <epicsTime.h>
 #include <epicsThread.h>
 #include <epicsInterrupt.h>
 #include <epicsMessageQueue.h>
 #include <epicsExport.h>
 
 #include "canBus.h"
+#include "canTrace.h"
 #include "drvTip810.h"
 #include "drvIpac.h"
 #include "pca82c200.h"
@@ -61,6 +64,11 @@ Copyright (c) 1995-2007 Andrew Johnson
 /* Some local magic numbers */
 #define T810_MAGIC_NUMBER 81001
 #define RECV_Q_SIZE 1000	/* Num messages to buffer */
+#define T810_SIM_SIZE 0x80	/* Memory for simulated chip registers */
+#define NAME_HASH_SIZE 32	/* Bus name hash table, a power of 2 */
+#define ARENA_CHUNK 8192	/* Bus memory pool allocation unit */
+#define ARENA_ALIGN 8		/* Alignment of pool objects */
+#define HIST_BUCKETS 18 	/* Latency buckets, 1us .. 67ms + overflow */
 
 /* These are the IPAC IDs for this module */
 #define IP_MANUFACTURER_TEWS 0xb3
@@ -87,11 +95,49 @@ typedef struct callbackTable_s {
     callback_t *pcallback;		/* registered routine */
 } callbackTable_t;
 
+/* Latency histogram, updated and read under epicsInterruptLock() since
+ * the 64-bit sum and max can't be accessed atomically.  Bucket n counts
+ * samples below (1024 << n) nanoseconds, the last bucket collects
+ * everything longer than that.
+ */
+typedef struct {
+    epicsUInt32 count;			/* samples recorded */
+    epicsUInt32 bucket[HIST_BUCKETS];	/* log2 distribution */
+    epicsUInt64 sum;			/* total nanoseconds */
+    epicsUInt64 max;			/* longest sample, ns */
+} t810Hist_t;
+
+
+typedef struct {
+    double rate;		/* tokens per second, 0 = unlimited */
+    double burst;		/* bucket size */
+    double tokens;
+    epicsUInt64 stamp;		/* time of last refill */
+} t810Bucket_t;
+
+typedef struct t810TxLimit_s {
+    struct t810TxLimit_s *pnext;	/* To next pending identifier */
+    t810Bucket_t bucket;	/* Identifier's own limit, if rate > 0 */
+    int pending;		/* message is waiting for a token */
+    canMessage_t message;	/* Newest message for this identifier */
+} t810TxLimit_t;
+
+typedef struct {
+    canID_t identifier;		/* 0 if slot is empty */
+    callbackTable_t *phandler;
+} t810ExtSlot_t;
+
+typedef struct {
+    unsigned int mask;		/* size - 1, size is a power of 2 */
+    unsigned int used;
+    t810ExtSlot_t slot[1];	/* Actually mask + 1 */
+} t810ExtTable_t;
 
 typedef struct canBusID_s {
     struct canBusID_s *pnext;	/* To next device. Must be first member */
     int magicNumber;		/* device pointer confirmation */
     char *pbusName;		/* Bus identification */
+    struct canBusID_s *pnextHash;	/* Bus name hash chain */
     int card;			/* Industry Pack address */
     int slot;			/*     "     "      "    */
     int irqNum; 		/* interrupt vector number */
@@ -105,24 +151,156 @@ typedef struct canBusID_s {
     canID_t unusedId;		/* last ID received without a callback */
     int errorCount;		/* Times entered Error state */
     int busOffCount;		/* Times entered Bus Off state */
+    int signalLatched;		/* State changes latched, queue full */
+    int sigLatch;		/* Latched bus state, or -1 if none */
+    epicsUInt64 sigLatchStamp;	/* ISR time of latched state */
+    epicsUInt64 sigStamp;	/* ISR time of last state delivered */
     epicsMutexId readSem;	/* canRead task Mutex */
     canMessage_t *preadBuffer;	/* canRead destination buffer */
     epicsEventId rxSem;		/* canRead message arrival signal */
     callbackTable_t *pmsgHandler[CAN_IDENTIFIERS];	/* message callbacks */
+    t810ExtTable_t *pextTable;	/* extended ID message callbacks */
+    canMessage_t simRxMessage;	/* next message for a simulated bus */
     callbackTable_t *psigHandler;	/* error signal callbacks */
+    epicsUInt64 txStamp;	/* canWrite entry time of pending message */
+    epicsUInt32 rtrStamp[CAN_IDENTIFIERS];	/* RTR sent times, ns>>10 */
+    t810Hist_t latency[T810_LAT_STAGES];	/* latency histograms */
+    unsigned int txBitsPending;	/* frame length of pending message */
+    epicsUInt32 rxBits;		/* bits received, incl. stuffing */
+    epicsUInt32 txBits;		/* bits transmitted, incl. stuffing */
+    epicsUInt32 loadRxBits;	/* rxBits at last load update */
+    epicsUInt32 loadTxBits;	/* txBits at last load update */
+    epicsUInt64 loadStamp;	/* time of last load update */
+    epicsTimerId loadTimer;	/* load update timer */
+    double rxLoad[T810_LOAD_PERIODS];	/* averaged Rx load, percent */
+    double txLoad[T810_LOAD_PERIODS];	/* averaged Tx load, percent */
+    canMessage_t txMessage;	/* copy of pending message for trace */
+    canTraceEntry_t *ptrace;	/* trace buffer, NULL if disabled */
+    epicsUInt32 traceMask;	/* trace buffer size - 1 */
+    epicsUInt32 traceHead;	/* entries written, free running */
+    int traceFrozen;		/* trace buffer updates suspended */
+    int simulated;		/* no hardware, see t810CreateSim() */
+    int replaying;		/* t810Replay() is active */
+    epicsMutexId arenaLock;	/* memory pool and handler allocation */
+    char *arenaNext;		/* next free byte in current chunk */
+    size_t arenaFree;		/* bytes left in current chunk */
+    size_t arenaSize;		/* total bytes in all chunks */
+    size_t arenaUsed;		/* bytes allocated to objects */
+    int arenaChunks;		/* number of chunks */
+    int arenaObjects;		/* number of objects allocated */
+    callbackTable_t *pfreeHandler;	/* deleted callback nodes */
+    int handlerCount;		/* callback nodes in use */
+    int handlerFree;		/* callback nodes on free list */
+    struct t810Gateway_s *pgateway;	/* forwarding rules from this bus */
+    int txLimited;		/* Transmit rate limits are configured */
+    epicsMutexId txLimitLock;	/* for the following */
+    t810Bucket_t txBucket;	/* Bus transmit limit */
+    t810TxLimit_t *ptxLimit[CAN_IDENTIFIERS];	/* Identifier limits */
+    t810TxLimit_t *ppendFirst;	/* Messages waiting for tokens */
+    t810TxLimit_t *ppendLast;
+    epicsTimerId txLimitTimer;	/* sends waiting messages */
+    int txLimitArmed;		/* txLimitTimer is running */
+    unsigned long txDeferred;	/* Messages delayed by a limit */
+    unsigned long txMerged;	/* Delayed messages replaced by newer */
+    unsigned long txDropped;	/* Messages discarded */
+    epicsEventId cyclicWake;	/* wakes this bus's cyclic task */
 } t810Dev_t;
 
+typedef struct t810Gateway_s {
+    struct t810Gateway_s *pnext;	/* To next rule on source bus */
+    t810Dev_t *pdest;		/* Destination bus */
+    canID_t identifier;		/* Match (id & mask) == identifier */
+    canID_t mask;
+    int remap;			/* Replacement for masked bits, or -1 */
+    t810Bucket_t limit;		/* Rate limit */
+    unsigned long forwarded;	/* Messages sent on */
+    unsigned long limited;	/* Dropped by rate limit */
+    unsigned long failed;	/* Dropped, destination busy */
+} t810Gateway_t;
+
+typedef struct t810Cyclic_s {
+    struct t810Cyclic_s *pnext;	/* To next cyclic message */
+    t810Dev_t *pdevice;
+    canMessage_t message;	/* Payload, updated by canCyclicUpdate */
+    epicsUInt64 period;		/* ns, 0 if unused */
+    epicsUInt64 phase;		/* ns after cyclicEpoch */
+    epicsUInt64 next;		/* Monotonic time of next transmission */
+    epicsUInt64 maxLate;	/* Worst transmission delay, ns */
+    unsigned long sent;		/* Messages transmitted */
+    unsigned long missed;	/* Slots skipped or failed */
+} t810Cyclic_t;
+
 typedef struct {
    t810Dev_t *pdevice;
+   epicsUInt64 stamp;		/* ISR arrival time */
+   int signal;			/* CAN_BUS_xxx state, or -1 for message */
    canMessage_t message;
 } t810Receipt_t;
 
 
 static t810Dev_t *pt810First = NULL;
+static t810Dev_t *nameHash[NAME_HASH_SIZE];
 static epicsMessageQueueId receiptQueue = NULL;
+static t810Cyclic_t *pcyclicFirst = NULL;
+static epicsMutexId cyclicLock = NULL;
+static epicsUInt64 cyclicEpoch;
+static volatile int sigLatched;	/* A device has a latched bus state */
+
+static void txLimitFlush(void *pvt);
+static t810ExtSlot_t *extFind(t810ExtTable_t *ptable, canID_t identifier);
 
 int canSilenceErrors = FALSE;	/* for EPICS device support use */
 int t810maxQueued = 0;		/* not static so may be reset by operator */
+int t810TraceEntries = 4096;	/* trace buffer size, 0 to disable */
+epicsExportAddress(int, t810TraceEntries);
+
+/*******************************************************************************
+
+Routine:
+    nameHashIndex & findDevice
+
+Purpose:
+    Look up a device by bus name
+
+Description:
+    Bus names are kept in a small hash table so that the thousands of
+    canIoParse() calls made at IOC startup don't have to walk the whole
+    device list.  The name doesn't have to be nil-terminated, which lets
+    canIoParse() look it up in place without copying it.
+
+Returns:
+    Hash index, or the device pointer or NULL if not found.
+
+*/
+
+static unsigned int nameHashIndex (
+    const char *pname,
+    size_t length
+) {
+    unsigned int hash = 0;
+
+    while (length--) {
+	hash = hash * 31 + (0xff & *pname++);
+    }
+    return hash & (NAME_HASH_SIZE - 1);
+}
+
+static t810Dev_t *findDevice (
+    const char *pname,
+    size_t length
+) {
+    t810Dev_t *pdevice = nameHash[nameHashIndex(pname, length)];
+
+    while (pdevice != NULL) {
+	if (strncmp(pdevice->pbusName, pname, length) == 0 &&
+	    pdevice->pbusName[length] == '\0') {
+	    return pdevice;
+	}
+	pdevice = pdevice->pnextHash;
+    }
+    return NULL;
+}
+
 
 /*******************************************************************************
 
@@ -193,9 +371,15 @@ long t810Report (
 	    return S_t810_badDevice;
 	}
 
-	printf("  '%s' : IP Carrier %d Slot %d, Bus rate %d Kbits/sec\n",
-		pdevice->pbusName, pdevice->card, pdevice->slot,
-		pdevice->busRate);
+	if (pdevice->simulated) {
+	    printf("  '%s' : Simulated, Bus rate %d Kbits/sec%s\n",
+		    pdevice->pbusName, pdevice->busRate,
+		    pdevice->replaying ? ", replaying" : "");
+	} else {
+	    printf("  '%s' : IP Carrier %d Slot %d, Bus rate %d Kbits/sec\n",
+		    pdevice->pbusName, pdevice->card, pdevice->slot,
+		    pdevice->busRate);
+	}
 
 	switch (interest) {
 	    case 1:
@@ -208,6 +392,52 @@ long t810Report (
 		}
 		printf("\tError Interrupts    : %5d\n", pdevice->errorCount);
 		printf("\tBus Off Events      : %5d\n", pdevice->busOffCount);
+		if (pdevice->signalLatched > 0) {
+		    printf("\tLatched State Chgs  : %5d\n", pdevice->signalLatched);
+		}
+		if (pdevice->txLimited) {
+		    printf("\tTx Rate Limited     : %lu deferred, %lu merged,"
+			   " %lu dropped\n", pdevice->txDeferred,
+			   pdevice->txMerged, pdevice->txDropped);
+		}
+		printf("\tRx Load 1/10/60 sec : %5.1f %5.1f %5.1f %%\n",
+			pdevice->rxLoad[T810_LOAD_1S],
+			pdevice->rxLoad[T810_LOAD_10S],
+			pdevice->rxLoad[T810_LOAD_60S]);
+		printf("\tTx Load 1/10/60 sec : %5.1f %5.1f %5.1f %%\n",
+			pdevice->txLoad[T810_LOAD_1S],
+			pdevice->txLoad[T810_LOAD_10S],
+			pdevice->txLoad[T810_LOAD_60S]);
+		if (cyclicLock != NULL) {
+		    t810Cyclic_t *pcyclic;
+
+		    epicsMutexMustLock(cyclicLock);
+		    for (pcyclic = pcyclicFirst; pcyclic != NULL;
+			 pcyclic = pcyclic->pnext) {
+			if (pcyclic->pdevice != pdevice ||
+			    pcyclic->period == 0) continue;
+			printf("\tCyclic ID %#5x     : every %g sec, sent %lu,"
+			       " missed %lu, max late %.1f us\n",
+			       pcyclic->message.identifier,
+			       pcyclic->period / 1e9, pcyclic->sent,
+			       pcyclic->missed, pcyclic->maxLate / 1000.0);
+		    }
+		    epicsMutexUnlock(cyclicLock);
+		}
+		{
+		    t810Gateway_t *pgateway;
+
+		    for (pgateway = pdevice->pgateway; pgateway != NULL;
+			 pgateway = pgateway->pnext) {
+			printf("\tGateway %#5x/%#5x : to %s", pgateway->identifier,
+			       pgateway->mask, pgateway->pdest->pbusName);
+			if (pgateway->remap >= 0)
+			    printf(" as %#x", pgateway->remap & pgateway->mask);
+			printf(", forwarded %lu, limited %lu, failed %lu\n",
+			       pgateway->forwarded, pgateway->limited,
+			       pgateway->failed);
+		    }
+		}
 		break;
 
 	    case 2:
@@ -218,10 +448,23 @@ long t810Report (
 			if (printed % 10 == 0) {
 			    printf("\n\t    ");
 			}
-			printf("0x%-3hx  ", id);
+			printf("0x%-3x  ", id);
 			printed++;
 		    }
 		}
+		if (pdevice->pextTable != NULL) {
+		    t810ExtTable_t *ptable = pdevice->pextTable;
+
+		    for (id = 0; id <= ptable->mask; id++) {
+			if (ptable->slot[id].phandler == NULL) continue;
+			if (printed % 5 == 0) {
+			    printf("\n\t    ");
+			}
+			printf("0x%08x(X)  ",
+			       ptable->slot[id].identifier & ~CAN_EXTENDED);
+			printed += 2;
+		    }
+		}
 		if (printed == 0) {
 		    printf("None.");
 		}
@@ -282,12 +525,77 @@ Example:
 
 */
 
+static long createDevice(char *pbusName, int card, int slot, int irqNum,
+			 int busRate, int simulated);
+
 long t810Create (
     char *pbusName,	/* Unique Identifier for this device */
     int card,		/* Ipac Driver card .. */
     int slot,		/* .. and slot number */
     int irqNum, 	/* interrupt vector number */
     int busRate 	/* in Kbits/sec */
+) {
+    return createDevice(pbusName, card, slot, irqNum, busRate, FALSE);
+}
+
+
+/*******************************************************************************
+
+Routine:
+    t810CreateSim
+
+Purpose:
+    Register a simulated TIP810 device
+
+Description:
+    Creates a bus which has no hardware behind it, for use with
+    t810Replay().  The controller registers are emulated in memory and
+    the ISR is called directly: messages written to the bus complete
+    immediately, while received messages and error events only come
+    from replaying a trace file.
+
+Returns:
+    0,
+    ENOMEM if malloc() fails,
+    S_t810_badBusRate for an unsupported bus rate,
+    S_t810_duplicateDevice if the name is already used.
+
+Example:
+    t810CreateSim "CAN1", 500
+
+*/
+
+long t810CreateSim (
+    char *pbusName,	/* Unique Identifier for this device */
+    int busRate 	/* in Kbits/sec */
+) {
+    return createDevice(pbusName, -1, -1, 0, busRate, TRUE);
+}
+
+
+/*******************************************************************************
+
+Routine:
+    createDevice
+
+Purpose:
+    Create and initialise a real or simulated device table
+
+Description:
+    Does the work of t810Create() and t810CreateSim().
+
+Returns:
+    As for t810Create().
+
+*/
+
+static long createDevice (
+    char *pbusName,
+    int card,
+    int slot,
+    int irqNum,
+    int busRate,
+    int simulated
 ) {
     static const struct {
 	int rate;
@@ -313,13 +621,24 @@ long t810Create (
     t810Dev_t *pdevice, *plist = (t810Dev_t *) &pt810First;
     long status;
     int rateIndex, id;
+    unsigned int hash;
 
-    status = ipmValidate(card, slot, IP_MANUFACTURER_TEWS,
-			 IP_MODEL_TEWS_TIP810);
-    if (status) {
-	return status;
+    if (cyclicLock == NULL) {
+	cyclicLock = epicsMutexCreate();
+	cyclicEpoch = epicsMonotonicGet();
+	if (cyclicLock == NULL) {
+	    return ENOMEM;
+	}
+    }
+
+    if (!simulated) {
+	status = ipmValidate(card, slot, IP_MANUFACTURER_TEWS,
+			     IP_MODEL_TEWS_TIP810);
+	if (status) {
+	    return status;
+	}
+	/* Slot contains a real TIP810 module */
     }
-    /* Slot contains a real TIP810 module */
 
     if (busRate == 0) {
 	return S_t810_badBusRate;
@@ -334,7 +653,8 @@ long t810Create (
     while (plist->pnext != NULL) {
 	plist = plist->pnext;
 	if (strcmp(plist->pbusName, pbusName) == 0 ||
-	    (plist->card == card &&
+	    (!simulated &&
+	     plist->card == card &&
 	     plist->slot == slot)) {
 	    return S_t810_duplicateDevice;
 	}
@@ -354,25 +674,94 @@ long t810Create (
     pdevice->slot        = slot;
     pdevice->irqNum      = irqNum;
     pdevice->busRate     = busRate;
-    pdevice->pchip       = (pca82c200_t *) ipmBaseAddr(card, slot, ipac_addrIO);
+    pdevice->simulated   = simulated;
+    if (simulated) {
+	/* Registers live in memory, including the TIP810's intVec */
+	pdevice->pchip   = calloc(1, T810_SIM_SIZE);
+	if (pdevice->pchip == NULL) {
+	    free(pdevice);
+	    return ENOMEM;
+	}
+    } else {
+	pdevice->pchip   = (pca82c200_t *) ipmBaseAddr(card, slot, ipac_addrIO);
+    }
+    pdevice->replaying   = FALSE;
+    pdevice->arenaNext   = NULL;
+    pdevice->arenaFree   = 0;
+    pdevice->arenaSize   = 0;
+    pdevice->arenaUsed   = 0;
+    pdevice->arenaChunks = 0;
+    pdevice->arenaObjects = 0;
+    pdevice->pfreeHandler = NULL;
+    pdevice->handlerCount = 0;
+    pdevice->handlerFree = 0;
+    pdevice->pgateway = NULL;
+    pdevice->pextTable = NULL;
+    pdevice->txLimited = FALSE;
+    pdevice->txBucket.rate = 0.0;
+    pdevice->ppendFirst = NULL;
+    pdevice->ppendLast = NULL;
+    pdevice->txLimitTimer = NULL;
+    pdevice->txLimitArmed = FALSE;
+    pdevice->txDeferred = 0;
+    pdevice->txMerged = 0;
+    pdevice->txDropped = 0;
     pdevice->preadBuffer = NULL;
     pdevice->psigHandler = NULL;
+    pdevice->sigLatch    = -1;
+    pdevice->sigStamp    = 0;
+    pdevice->txStamp     = 0;
+    pdevice->txBitsPending = 0;
+    pdevice->rxBits      = 0;
+    pdevice->txBits      = 0;
+    pdevice->loadTimer   = NULL;
+    memset(pdevice->rxLoad, 0, sizeof(pdevice->rxLoad));
+    memset(pdevice->txLoad, 0, sizeof(pdevice->txLoad));
+    pdevice->ptrace      = NULL;
+    pdevice->traceMask   = 0;
+    pdevice->traceHead   = 0;
+    pdevice->traceFrozen = FALSE;
+
+    if (t810TraceEntries > 0) {
+	/* Round up to a power of 2 so the ISR can mask the index */
+	epicsUInt32 entries = 1;
+
+	while (entries < (epicsUInt32) t810TraceEntries) entries <<= 1;
+	pdevice->ptrace = calloc(entries, sizeof(canTraceEntry_t));
+	if (pdevice->ptrace == NULL) {
+	    free(pdevice);
+	    return ENOMEM;
+	}
+	pdevice->traceMask = entries - 1;
+    }
 
     for (id=0; id<CAN_IDENTIFIERS; id++) {
 	pdevice->pmsgHandler[id] = NULL;
+	pdevice->rtrStamp[id] = 0;
     }
+    memset(pdevice->latency, 0, sizeof(pdevice->latency));
 
     pdevice->txSem   = epicsEventCreate(epicsEventFull);
     pdevice->rxSem   = epicsEventCreate(epicsEventEmpty);
     pdevice->readSem = epicsMutexCreate();
+    pdevice->arenaLock = epicsMutexCreate();
+    pdevice->txLimitLock = epicsMutexCreate();
+    pdevice->cyclicWake = epicsEventCreate(epicsEventEmpty);
     if (pdevice->txSem == NULL ||
 	pdevice->rxSem == NULL ||
-	pdevice->readSem == NULL) {
+	pdevice->readSem == NULL ||
+	pdevice->arenaLock == NULL ||
+	pdevice->txLimitLock == NULL ||
+	pdevice->cyclicWake == NULL) {
+	free(pdevice->ptrace);
 	free(pdevice);		/* Ought to free those semaphores, but... */
 	return ENOMEM;
     }
 
     plist->pnext = pdevice;
+    hash = nameHashIndex(pbusName, strlen(pbusName));
+    pdevice->pnextHash = nameHash[hash];
+    nameHash[hash] = pdevice;
     /* device table interface stuff filled in and added to list */
 
     pdevice->pchip->control        = PCA_CR_RR;	/* Reset state */
@@ -385,7 +774,12 @@ long t810Create (
 				     PCA_OCR_OCT1_PUSHPULL;
     /* chip now initialised, but held in the Reset state */
 
-    ipmIrqCmd(card, slot, 0, ipac_statActive);
+    if (simulated) {
+	/* The transmit buffer is always free */
+	pdevice->pchip->status = PCA_SR_TBS | PCA_SR_TCS;
+    } else {
+	ipmIrqCmd(card, slot, 0, ipac_statActive);
+    }
     return 0;
 }
 
@@ -417,7 +811,8 @@ void t810Shutdown (
 	}
 
 	pdevice->pchip->control = PCA_CR_RR;	/* Reset, interrupts off */
-	ipmIrqCmd(pdevice->card, pdevice->slot, 0, ipac_statUnused);
+	if (!pdevice->simulated)
+	    ipmIrqCmd(pdevice->card, pdevice->slot, 0, ipac_statUnused);
 
 	pdevice = pdevice->pnext;
     }
@@ -539,6 +934,277 @@ static void doCallbacks (
 }
 
 
+/*******************************************************************************
+
+Routine:
+    histAdd
+
+Purpose:
+    Record a latency sample
+
+Description:
+    Adds the given interval to a latency histogram.  Each histogram has
+    only one writer (either the ISR or the receive task), but the 64-bit
+    sum and max take two stores on a 32-bit CPU, so the update is done
+    under the interrupt lock to keep readers from seeing a torn value.
+    The bucket is found by shifting instead of dividing to keep the cost
+    down inside the ISR.
+
+Returns:
+    void
+
+*/
+
+static void histAdd (
+    t810Hist_t *phist,
+    epicsUInt64 interval
+) {
+    epicsUInt32 scaled = (epicsUInt32) (interval >> 10);
+    int n = 0;
+    int key;
+
+    if ((interval >> 10) > scaled) {
+	scaled = ~0u;			/* Saturate, it's going to overflow */
+    }
+    while (scaled != 0 && n < HIST_BUCKETS - 1) {
+	scaled >>= 1;
+	n++;
+    }
+
+    key = epicsInterruptLock();
+    phist->bucket[n]++;
+    phist->count++;
+    phist->sum += interval;
+    if (interval > phist->max) {
+	phist->max = interval;
+    }
+    epicsInterruptUnlock(key);
+}
+
+
+/*******************************************************************************
+
+Routine:
+    traceAdd
+
+Purpose:
+    Append an entry to a device's trace buffer
+
+Description:
+    Only called from the ISR, which is the sole writer of the trace buffer
+    for its device, so no locking is needed.  The oldest entry is
+    overwritten once the buffer is full.  A NULL message pointer records
+    a bus state change instead of a message.
+
+Returns:
+    void
+
+*/
+
+static void traceAdd (
+    t810Dev_t *pdevice,
+    epicsUInt64 stamp,
+    int type,
+    const canMessage_t *pmessage,
+    int status,
+    int event
+) {
+    canTraceEntry_t *pentry;
+
+    if (pdevice->ptrace == NULL || pdevice->traceFrozen) return;
+
+    pentry = &pdevice->ptrace[pdevice->traceHead & pdevice->traceMask];
+    pentry->stamp  = stamp;
+    pentry->type   = type;
+    pentry->status = status;
+    pentry->event  = event;
+    if (pmessage) {
+	pentry->identifier = pmessage->identifier;
+	pentry->length     = pmessage->length;
+	if (pmessage->rtr == RTR) {
+	    pentry->type |= CAN_TRACE_RTR;
+	}
+	memcpy(pentry->data, pmessage->data, CAN_DATA_SIZE);
+    } else {
+	pentry->identifier = 0;
+	pentry->length     = 0;
+    }
+    pdevice->traceHead++;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    frameBits
+
+Purpose:
+    Calculate the length of a CAN frame on the bus
+
+Description:
+    Returns the number of bit times that the given message occupies on the
+    bus, including the inter-frame space.  The stuff bits are counted by
+    running the stuffable part of the frame (start bit to CRC) through the
+    bit stuffing rule, computing the CRC-15 on the way.  This is called at
+    task level, never from the ISR.
+
+Returns:
+    Frame length in bits.
+
+*/
+
+static unsigned int frameBits (
+    const canMessage_t *pmessage
+) {
+    unsigned int crc = 0;
+    unsigned int run = 0;
+    unsigned int last = 2;		/* Matches neither bit value */
+    unsigned int stuffed = 0;
+    unsigned int length = pmessage->rtr == RTR ? 0 : pmessage->length;
+    epicsUInt64 field;
+    int nbits, i, byte;
+
+#define STUFF_BIT(b) \
+    if ((b) == last) { \
+	if (++run == 5) { stuffed++; last = !(b); run = 1; } \
+    } else { last = (b); run = 1; }
+
+#define FEED_BIT(b) \
+    if (((b) ^ (crc >> 14)) & 1) crc = ((crc << 1) ^ 0x4599) & 0x7fff; \
+    else crc = (crc << 1) & 0x7fff; \
+    STUFF_BIT(b)
+
+    if (pmessage->identifier & CAN_EXTENDED) {
+	epicsUInt32 id = pmessage->identifier & ~CAN_EXTENDED;
+
+	/* SOF, 11-bit base ID, SRR, IDE, 18-bit ID, RTR, r1, r0 and DLC */
+	field = ((epicsUInt64) (id >> 18) << 27) | (3 << 25) |
+		((epicsUInt64) (id & 0x3ffff) << 7) |
+		(pmessage->rtr == RTR ? 0x40 : 0) | (pmessage->length & 0xf);
+	nbits = 39;
+    } else {
+	/* SOF, 11-bit ID, RTR, IDE, r0 and DLC */
+	field = ((epicsUInt64) pmessage->identifier << 7) |
+		(pmessage->rtr == RTR ? 0x40 : 0) | (pmessage->length & 0xf);
+	nbits = 19;
+    }
+    for (i = nbits - 1; i >= 0; i--) {
+	unsigned int bit = (field >> i) & 1;
+	FEED_BIT(bit)
+    }
+    for (byte = 0; byte < length; byte++) {
+	for (i = 7; i >= 0; i--) {
+	    unsigned int bit = (pmessage->data[byte] >> i) & 1;
+	    FEED_BIT(bit)
+	}
+    }
+    for (i = 14; i >= 0; i--) {
+	unsigned int bit = (crc >> i) & 1;
+	STUFF_BIT(bit)
+    }
+
+#undef FEED_BIT
+#undef STUFF_BIT
+
+    /* Fixed fields: header, 15 CRC + delimiter, ACK, EOF and IFS */
+    return nbits + 28 + 8 * length + stuffed;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    loadUpdate
+
+Purpose:
+    Timer routine to update the bus load averages
+
+Description:
+    Runs once a second on the CAN timer queue for each bus.  Converts the
+    number of bits seen since the last call into a percentage of the bus
+    capacity, and folds that into exponentially weighted moving averages
+    with time constants of 1, 10 and 60 seconds.  The bit counters are
+    only read here, so no locking is needed.
+
+Returns:
+    void
+
+*/
+
+static void loadUpdate (
+    void *pvt
+) {
+    static const double tau[T810_LOAD_PERIODS] = { 1.0, 10.0, 60.0 };
+    t810Dev_t *pdevice = (t810Dev_t *) pvt;
+    epicsUInt64 now = epicsMonotonicGet();
+    epicsUInt32 rxBits = pdevice->rxBits;
+    epicsUInt32 txBits = pdevice->txBits;
+    double interval = (now - pdevice->loadStamp) / 1e9;
+    int period;
+
+    if (interval > 0.0) {
+	double capacity = interval * abs(pdevice->busRate) * 1000.0;
+	double rxLoad = 100.0 * (rxBits - pdevice->loadRxBits) / capacity;
+	double txLoad = 100.0 * (txBits - pdevice->loadTxBits) / capacity;
+
+	for (period = 0; period < T810_LOAD_PERIODS; period++) {
+	    double alpha = 1.0 - exp(-interval / tau[period]);
+
+	    pdevice->rxLoad[period] += alpha * (rxLoad - pdevice->rxLoad[period]);
+	    pdevice->txLoad[period] += alpha * (txLoad - pdevice->txLoad[period]);
+	}
+    }
+
+    pdevice->loadRxBits = rxBits;
+    pdevice->loadTxBits = txBits;
+    pdevice->loadStamp  = now;
+    epicsTimerStartDelay(pdevice->loadTimer, 1.0);
+}
+
+
+/*******************************************************************************
+
+Routine:
+    bucketWait & bucketTake
+
+Purpose:
+    Token bucket rate limiter
+
+Description:
+    bucketWait refills the bucket for the time elapsed since its last use
+    and says how long it will be until a token is available.  bucketTake
+    takes one token from the bucket if there is one available.
+
+Returns:
+    Seconds to wait, 0.0 if a token is available now;
+    TRUE if the caller may proceed, FALSE if the rate is exceeded.
+
+*/
+
+static double bucketWait (
+    t810Bucket_t *pbucket,
+    epicsUInt64 now
+) {
+    if (pbucket->rate <= 0.0) return 0.0;
+
+    pbucket->tokens += (now - pbucket->stamp) * 1e-9 * pbucket->rate;
+    if (pbucket->tokens > pbucket->burst) pbucket->tokens = pbucket->burst;
+    pbucket->stamp = now;
+
+    if (pbucket->tokens >= 1.0) return 0.0;
+    return (1.0 - pbucket->tokens) / pbucket->rate;
+}
+
+static int bucketTake (
+    t810Bucket_t *pbucket,
+    epicsUInt64 now
+) {
+    if (bucketWait(pbucket, now) > 0.0) return FALSE;
+    if (pbucket->rate > 0.0) pbucket->tokens -= 1.0;
+    return TRUE;
+}
+
+
 /*******************************************************************************
 
 Routine:
@@ -560,6 +1226,7 @@ static void t810ISR (
 ) {
     t810Dev_t *pdevice = (t810Dev_t *) pdev;
     int intSource = pdevice->pchip->interrupt;
+    epicsUInt64 now = epicsMonotonicGet();
 
     if (intSource & PCA_IR_OI) {		/* Overrun Interrupt */
         pdevice->overCount++;
@@ -574,7 +1241,14 @@ static void t810ISR (
 
 	/* Take a local copy of the message */
 	qmsg.pdevice = pdevice;
-	getRxMessage(pdevice->pchip, &qmsg.message);
+	qmsg.stamp = now;
+	qmsg.signal = -1;
+	if (pdevice->simulated) {
+	    qmsg.message = pdevice->simRxMessage;
+	} else {
+	    getRxMessage(pdevice->pchip, &qmsg.message);
+	}
+	traceAdd(pdevice, now, CAN_TRACE_RX, &qmsg.message, intSource, 0);
 
 	/* Send it to the servicing task */
 	if (epicsMessageQueueTrySend(receiptQueue, &qmsg,
@@ -583,7 +1257,7 @@ static void t810ISR (
     }
 
     if (intSource & PCA_IR_EI) {		/* Error Interrupt */
-	callbackTable_t *phandler = pdevice->psigHandler;
+	t810Receipt_t qsig;
 	int status;
 
 	switch (pdevice->pchip->status & (PCA_SR_ES | PCA_SR_BS)) {
@@ -609,11 +1283,41 @@ static void t810ISR (
 		break;
 	}
 
-	doCallbacks(phandler, status);
+	traceAdd(pdevice, now, CAN_TRACE_EVENT, NULL,
+		 pdevice->pchip->status, status);
+
+	/* The receive task runs the signal callbacks.  If the queue is
+	 * full latch the new state for it instead, replacing any older
+	 * latched state, so the latest state change is never lost */
+	if (pdevice->psigHandler != NULL) {
+	    qsig.pdevice = pdevice;
+	    qsig.stamp = now;
+	    qsig.signal = status;
+	    if (epicsMessageQueueTrySend(receiptQueue, &qsig,
+					 sizeof(t810Receipt_t))) {
+		int key = epicsInterruptLock();
+		pdevice->sigLatch = status;
+		pdevice->sigLatchStamp = now;
+		pdevice->signalLatched++;
+		sigLatched = TRUE;
+		epicsInterruptUnlock(key);
+	    }
+	}
     }
 
     if (intSource & PCA_IR_TI) {		/* Transmit Interrupt */
 	pdevice->txCount++;
+	if (pdevice->txStamp) {
+	    histAdd(&pdevice->latency[T810_LAT_TX_COMPLETE],
+		    now - pdevice->txStamp);
+	    pdevice->txStamp = 0;
+	}
+	if (pdevice->txBitsPending) {
+	    traceAdd(pdevice, now, CAN_TRACE_TX, &pdevice->txMessage,
+		     intSource, 0);
+	}
+	pdevice->txBits += pdevice->txBitsPending;
+	pdevice->txBitsPending = 0;
 	epicsEventSignal(pdevice->txSem);
     }
 
@@ -621,65 +1325,291 @@ static void t810ISR (
 	if (!canSilenceErrors)
 	    epicsInterruptContextMessage("Wake-up Interrupt from CANbus");
     }
+
+    histAdd(&pdevice->latency[T810_LAT_ISR], epicsMonotonicGet() - now);
 }
 
 
 /*******************************************************************************
 
 Routine:
-    t810RecvTask
+    simInterrupt
 
 Purpose:
-    Receive task
+    Raise an interrupt on a simulated device
 
 Description:
-    This routine is a background task started by t810Initialise. It
-    takes messages out of the receive queue one by one and runs the
-    callbacks registered against the relevent message ID.
+    Sets the emulated interrupt register and runs the ISR from task
+    level, with interrupts locked so that it can't be re-entered by
+    another task doing the same thing for this device.
 
 Returns:
-    int
+    void
 
 */
 
-static void t810RecvTask(void *dummy) {
-    t810Receipt_t rmsg;
-    callbackTable_t *phandler;
-    int numQueued;
+static void simInterrupt (
+    t810Dev_t *pdevice,
+    int intSource
+) {
+    int key = epicsInterruptLock();
 
-    if (receiptQueue == 0) {
-	fprintf(stderr, "CANbus Receive queue does not exist, task exiting.\n");
-	return;
-    }
-    printf("CANbus receive task started\n");
+    pdevice->pchip->interrupt = intSource;
+    t810ISR((int) pdevice);
+    pdevice->pchip->interrupt = 0;
+    epicsInterruptUnlock(key);
+}
 
-    while (TRUE) {
-	numQueued = epicsMessageQueuePending(receiptQueue);
-        if (numQueued > t810maxQueued) t810maxQueued = numQueued;
 
-	epicsMessageQueueReceive(receiptQueue, &rmsg, sizeof(t810Receipt_t));
-	rmsg.pdevice->rxCount++;
+/*******************************************************************************
 
-	/* Look up the message ID and do the message callbacks */
-	phandler = rmsg.pdevice->pmsgHandler[rmsg.message.identifier];
-	if (phandler == NULL) {
-	    rmsg.pdevice->unusedId = rmsg.message.identifier;
-	    rmsg.pdevice->unusedCount++;
-	} else {
-	    doCallbacks(phandler, (long) &rmsg.message);
-	}
+Routine:
+    sigDrain
 
-	/* If canRead is waiting for this ID, give it the message and kick it */
-	if (rmsg.pdevice->preadBuffer != NULL &&
-	    rmsg.pdevice->preadBuffer->identifier == rmsg.message.identifier) {
-	    memcpy(rmsg.pdevice->preadBuffer, &rmsg.message,
-		   sizeof(canMessage_t));
-	    rmsg.pdevice->preadBuffer = NULL;
+Purpose:
+    Deliver bus states latched by the ISR
+
+Description:
+    Called by the receive task when the ISR has latched a bus state
+    because the receive queue was full.  Takes each device's latched
+    state under the interrupt lock and runs its canSignal callbacks.
+
+*/
+
+static void sigDrain (void) {
+    t810Dev_t *pdevice;
+    int key;
+
+    key = epicsInterruptLock();
+    sigLatched = FALSE;
+    epicsInterruptUnlock(key);
+
+    for (pdevice = pt810First; pdevice != NULL; pdevice = pdevice->pnext) {
+	epicsUInt64 stamp;
+	int status;
+
+	key = epicsInterruptLock();
+	status = pdevice->sigLatch;
+	stamp = pdevice->sigLatchStamp;
+	pdevice->sigLatch = -1;
+	epicsInterruptUnlock(key);
+
+	if (status >= 0) {
+	    pdevice->sigStamp = stamp;
+	    doCallbacks(pdevice->psigHandler, status);
+	}
+    }
+}
+
+
+/*******************************************************************************
+
+Routine:
+    t810RecvTask
+
+Purpose:
+    Receive task
+
+Description:
+    This routine is a background task started by t810Initialise. It
+    takes messages out of the receive queue one by one and runs the
+    callbacks registered against the relevent message ID, then forwards
+    it to other buses according to the gateway rules.  Bus state
+    changes are passed through the same queue from the ISR, so the
+    canSignal callbacks also run here, in order with the messages.
+    A state change that the ISR could not queue is latched in the
+    device instead and delivered by sigDrain after the next receipt;
+    queued states older than one already delivered are then skipped.
+
+Returns:
+    int
+
+*/
+
+static void t810RecvTask(void *dummy) {
+    t810Receipt_t rmsg;
+    callbackTable_t *phandler;
+    t810Gateway_t *pgateway;
+    int numQueued;
+    epicsUInt64 dequeued;
+    epicsUInt32 sent;
+
+    if (receiptQueue == 0) {
+	fprintf(stderr, "CANbus Receive queue does not exist, task exiting.\n");
+	return;
+    }
+    printf("CANbus receive task started\n");
+
+    while (TRUE) {
+	numQueued = epicsMessageQueuePending(receiptQueue);
+        if (numQueued > t810maxQueued) t810maxQueued = numQueued;
+
+	epicsMessageQueueReceive(receiptQueue, &rmsg, sizeof(t810Receipt_t));
+
+	if (sigLatched) sigDrain();
+
+	if (rmsg.signal >= 0) {
+	    if (rmsg.stamp >= rmsg.pdevice->sigStamp) {
+		rmsg.pdevice->sigStamp = rmsg.stamp;
+		doCallbacks(rmsg.pdevice->psigHandler, rmsg.signal);
+	    }
+	    continue;
+	}
+	rmsg.pdevice->rxCount++;
+
+	dequeued = epicsMonotonicGet();
+	histAdd(&rmsg.pdevice->latency[T810_LAT_RX_QUEUE],
+		dequeued - rmsg.stamp);
+	rmsg.pdevice->rxBits += frameBits(&rmsg.message);
+
+	/* Was this the reply to an RTR we sent? */
+	sent = rmsg.message.identifier & CAN_EXTENDED ? 0 :
+	       rmsg.pdevice->rtrStamp[rmsg.message.identifier];
+	if (sent && rmsg.message.rtr == SEND) {
+	    rmsg.pdevice->rtrStamp[rmsg.message.identifier] = 0;
+	    histAdd(&rmsg.pdevice->latency[T810_LAT_RTR_REPLY],
+		    (epicsUInt64) (epicsUInt32) ((rmsg.stamp >> 10) - sent) << 10);
+	}
+
+	/* Look up the message ID and do the message callbacks */
+	if (rmsg.message.identifier & CAN_EXTENDED) {
+	    t810ExtSlot_t *pslot = extFind(rmsg.pdevice->pextTable,
+					   rmsg.message.identifier);
+	    phandler = pslot ? pslot->phandler : NULL;
+	} else {
+	    phandler = rmsg.pdevice->pmsgHandler[rmsg.message.identifier];
+	}
+	if (phandler == NULL) {
+	    rmsg.pdevice->unusedId = rmsg.message.identifier;
+	    rmsg.pdevice->unusedCount++;
+	} else {
+	    doCallbacks(phandler, (long) &rmsg.message);
+	    histAdd(&rmsg.pdevice->latency[T810_LAT_RX_CALLBACK],
+		    epicsMonotonicGet() - dequeued);
+	}
+
+	/* Forward it to any other buses that want it */
+	for (pgateway = rmsg.pdevice->pgateway; pgateway != NULL;
+	     pgateway = pgateway->pnext) {
+	    canMessage_t fwd;
+
+	    if ((rmsg.message.identifier & CAN_EXTENDED) ||
+		(rmsg.message.identifier & pgateway->mask) !=
+		pgateway->identifier) continue;
+
+	    if (!bucketTake(&pgateway->limit, dequeued)) {
+		pgateway->limited++;
+		continue;
+	    }
+
+	    fwd = rmsg.message;
+	    if (pgateway->remap >= 0)
+		fwd.identifier = (fwd.identifier & ~pgateway->mask) |
+				 (pgateway->remap & pgateway->mask);
+
+	    /* Don't wait for the transmitter, that would stall all buses */
+	    if (canWrite(pgateway->pdest, &fwd, 0.0)) {
+		pgateway->failed++;
+	    } else {
+		pgateway->forwarded++;
+	    }
+	}
+
+	/* If canRead is waiting for this ID, give it the message and kick it */
+	if (rmsg.pdevice->preadBuffer != NULL &&
+	    rmsg.pdevice->preadBuffer->identifier == rmsg.message.identifier) {
+	    memcpy(rmsg.pdevice->preadBuffer, &rmsg.message,
+		   sizeof(canMessage_t));
+	    rmsg.pdevice->preadBuffer = NULL;
 	    epicsEventSignal(rmsg.pdevice->rxSem);
 	}
    }
 }
 
+/*******************************************************************************
+
+Routine:
+    t810CyclicTask
+
+Purpose:
+    Transmit cyclic messages
+
+Description:
+    One of these high priority tasks is started for each bus by
+    t810Initialise.  It sleeps until the bus's next cyclic message is
+    due, then sends it with canWrite.  Transmission times are calculated
+    from a fixed epoch, so they don't drift; if a message falls more
+    than a period behind, the missed slots are counted and skipped.  The
+    task is woken early whenever a cyclic message on its bus is created
+    or changed.  Having a task per bus means a busy transmitter on one
+    bus can't delay the schedule of any other.
+
+Returns:
+    void
+
+*/
+
+static void t810CyclicTask(void *parm) {
+    t810Dev_t *pbus = parm;
+
+    while (TRUE) {
+	t810Cyclic_t *pcyclic, *pdue = NULL;
+	t810Dev_t *pdevice = NULL;
+	canMessage_t message;
+	epicsUInt64 now, period = 0;
+	double delay = 0.0;
+	int status;
+
+	epicsMutexMustLock(cyclicLock);
+	for (pcyclic = pcyclicFirst; pcyclic != NULL;
+	     pcyclic = pcyclic->pnext) {
+	    if (pcyclic->pdevice == pbus && pcyclic->period &&
+		(pdue == NULL || pcyclic->next < pdue->next))
+		pdue = pcyclic;
+	}
+	now = epicsMonotonicGet();
+	if (pdue != NULL && pdue->next <= now) {
+	    epicsUInt64 late = now - pdue->next;
+
+	    if (late > pdue->maxLate) pdue->maxLate = late;
+	    pdue->next += pdue->period;
+	    if (pdue->next <= now) {
+		epicsUInt64 skip = (now - pdue->next) / pdue->period + 1;
+
+		pdue->missed += skip;
+		pdue->next += skip * pdue->period;
+	    }
+	    pdevice = pdue->pdevice;
+	    message = pdue->message;
+	    period = pdue->period;
+	} else if (pdue != NULL) {
+	    delay = (pdue->next - now) / 1e9;
+	}
+	epicsMutexUnlock(cyclicLock);
+
+	if (pdue == NULL) {
+	    epicsEventMustWait(pbus->cyclicWake);
+	    continue;
+	}
+	if (pdevice == NULL) {
+	    epicsEventWaitWithTimeout(pbus->cyclicWake, delay);
+	    continue;
+	}
+
+	/* Don't wait for the transmitter for more than half a period */
+	status = canWrite(pdevice, &message, period / 2e9);
+
+	epicsMutexMustLock(cyclicLock);
+	if (status) {
+	    pdue->missed++;
+	} else {
+	    pdue->sent++;
+	}
+	epicsMutexUnlock(cyclicLock);
+    }
+}
+
+
 /*******************************************************************************
 
 Routine:
@@ -720,20 +1650,42 @@ long t810Initialise (
 			  t810RecvTask, NULL) == 0) return -1;
 
     while (pdevice != NULL) {
+	char threadName[32];
+
 	pdevice->txCount     = 0;
 	pdevice->rxCount     = 0;
 	pdevice->overCount   = 0;
 	pdevice->unusedCount = 0;
 	pdevice->errorCount  = 0;
 	pdevice->busOffCount = 0;
+	pdevice->signalLatched = 0;
+
+	if (!pdevice->simulated) {
+	    status = ipmIntConnect(pdevice->card, pdevice->slot,
+				   pdevice->irqNum, t810ISR, (int)pdevice);
+	}
 
-	status = ipmIntConnect(pdevice->card, pdevice->slot, pdevice->irqNum,
-			       t810ISR, (int)pdevice);
+	sprintf(threadName, "canCyc%.24s", pdevice->pbusName);
+	if (epicsThreadCreate(threadName, epicsThreadPriorityHigh,
+			      epicsThreadGetStackSize(epicsThreadStackSmall),
+			      t810CyclicTask, pdevice) == 0) return -1;
+
+	pdevice->loadTimer = epicsTimerQueueCreateTimer(canTimerQ,
+						      loadUpdate, pdevice);
+	if (pdevice->loadTimer == NULL) return ENOMEM;
+	pdevice->txLimitTimer = epicsTimerQueueCreateTimer(canTimerQ,
+						txLimitFlush, pdevice);
+	if (pdevice->txLimitTimer == NULL) return ENOMEM;
+	pdevice->loadRxBits = pdevice->rxBits;
+	pdevice->loadTxBits = pdevice->txBits;
+	pdevice->loadStamp  = epicsMonotonicGet();
+	epicsTimerStartDelay(pdevice->loadTimer, 1.0);
 
 	/* The TIP810's intVec register is external to the PCA82C200 chip */
 	*((epicsUInt8 *) pdevice->pchip + 0x41) = pdevice->irqNum;
 
-	ipmIrqCmd(pdevice->card, pdevice->slot, 0, ipac_irqEnable);
+	if (!pdevice->simulated)
+	    ipmIrqCmd(pdevice->card, pdevice->slot, 0, ipac_irqEnable);
 
 	pdevice->pchip->control = PCA_CR_OIE |
 				  PCA_CR_EIE |
@@ -755,9 +1707,8 @@ Purpose:
     Return device pointer for given CAN bus name
 
 Description:
-    Searches through the linked list of known t810 devices for one
-    which matches the name given, and returns the device pointer
-    associated with the relevant device table.
+    Looks up the bus name in the hash table of known t810 devices, and
+    returns the device pointer associated with the relevant device table.
 
 Returns:
     0, or S_can_noDevice if no match found.
@@ -772,16 +1723,13 @@ int canOpen (
     const char *pbusName,
     canBusID_t *pbusID
 ) {
-    t810Dev_t *pdevice = pt810First;
+    t810Dev_t *pdevice = findDevice(pbusName, strlen(pbusName));
 
-    while (pdevice != NULL) {
-	if (strcmp(pdevice->pbusName, pbusName) == 0) {
-	    *pbusID = pdevice;
-	    return 0;
-	}
-	pdevice = pdevice->pnext;
+    if (pdevice == NULL) {
+	return S_can_noDevice;
     }
-    return S_can_noDevice;
+    *pbusID = pdevice;
+    return 0;
 }
 
 
@@ -809,6 +1757,7 @@ int canBusReset (
 ) {
     t810Dev_t *pdevice;
     int status = canOpen(pbusName, &pdevice);
+    int key;
 
     if (status) return status;
 
@@ -819,6 +1768,12 @@ int canBusReset (
     pdevice->unusedCount = 0;
     pdevice->errorCount  = 0;
     pdevice->busOffCount = 0;
+    pdevice->signalLatched = 0;
+    key = epicsInterruptLock();
+    memset(pdevice->latency, 0, sizeof(pdevice->latency));
+    epicsInterruptUnlock(key);
+    pdevice->txStamp = 0;
+    pdevice->txBitsPending = 0;
     epicsEventSignal(pdevice->txSem);
     pdevice->pchip->control = PCA_CR_OIE |
 			      PCA_CR_EIE |
@@ -898,41 +1853,6 @@ int canBusRestart (
 }
 
 
-/*******************************************************************************
-
-Routine:
-    strdupn
-
-Purpose:
-    duplicate n characters of a string and return pointer to new substring
-
-Description:
-    Copies n characters from the input string to a newly malloc'ed memory
-    buffer, and adds a trailing '\0', then returns the new string pointer.
-
-Returns:
-    char *newString, or NULL if malloc failed.
-
-*/
-
-static char* strdupn (
-    const char *ct,
-    size_t n
-) {
-    char *duplicate;
-
-    duplicate = malloc(n+1);
-    if (duplicate == NULL) {
-	return NULL;
-    }
-
-    memcpy(duplicate, ct, n);
-    duplicate[n] = '\0';
-
-    return duplicate;
-}
-
-
 /*******************************************************************************
 
 Routine:
@@ -945,19 +1865,22 @@ Description:
     canString which must match the format below is converted by this routine
     into the relevent fields of the canIo_t structure pointed to by pcanIo:
 
-    	busname{/timeout}:id{+n}{.offset} parameter
+    	busname{/timeout}:id{+n}{x}{.offset} parameter
 
     where
     	busname is alphanumeric, all other fields are hex, decimal or octal
     	timeout is in milliseconds
 	id and any number of +n components are summed to give the CAN Id
+	x marks the Id as 29-bit extended, required for Ids above 0x7ff
 	offset is the byte offset into the message
 	parameter is a string or integer for use by device support
 
+    No memory is allocated; busName is set to point to the name string
+    held by the driver for that bus, which is shared by all users.
+
 Returns:
     0, or
     S_can_badAddress for illegal input strings,
-    ENOMEM if malloc() fails,
     S_can_noDevice for an unregistered bus name.
 
 Example:
@@ -971,6 +1894,8 @@ int canIoParse (
 ) {
     char separator;
     char *name;
+    size_t length;
+    t810Dev_t *pdevice;
 
     pcanIo->canBusID = NULL;
 
@@ -997,10 +1922,8 @@ int canIoParse (
     }
 
     /* now we're at character after the end of the busName */
-    pcanIo->busName = strdupn(name, canString - name);
-    if (pcanIo->busName == NULL) {
-	return ENOMEM;
-    }
+    length = canString - name;
+    pcanIo->busName = NULL;
     separator = *canString++;
 
     /* Handle /<timeout> if present, convert from ms to seconds */
@@ -1024,6 +1947,17 @@ int canIoParse (
 	separator = *canString++;
     }
 
+    /* Only an x suffix makes a 29-bit ID, so a typo can't become one */
+    if (separator == 'x' || separator == 'X') {
+	if (pcanIo->identifier >= CAN_EXT_IDENTIFIERS) {
+	    return S_can_badAddress;
+	}
+	pcanIo->identifier |= CAN_EXTENDED;
+	separator = *canString++;
+    } else if (pcanIo->identifier >= CAN_IDENTIFIERS) {
+	return S_can_badAddress;
+    }
+
     /* Handle .<offset> if present */
     if (separator == '.') {
 	pcanIo->offset = strtoul(canString, &canString, 0);
@@ -1043,60 +1977,59 @@ int canIoParse (
     pcanIo->parameter = strtol(canString, &pcanIo->paramStr, 0);
 
     /* Ok, finally look up the bus name */
-    return canOpen(pcanIo->busName, &pcanIo->canBusID);
+    pdevice = findDevice(name, length);
+    if (pdevice == NULL) {
+	return S_can_noDevice;
+    }
+    pcanIo->busName  = pdevice->pbusName;
+    pcanIo->canBusID = pdevice;
+    return 0;
 }
 
 
 /*******************************************************************************
 
 Routine:
-    canWrite
+    txSend
 
 Purpose:
-    writes a CAN message to the bus
+    Copy a message to the transmitter
 
 Description:
-    Sends the message described by pmessage out through the bus identified by
-    canBusID.  After some simple argument checks it obtains exclusive access to
-    the transmit registers, then copies the message to the chip.  The timeout
-    value allows task recovery in the event that exclusive access is not
-    available within a the given number of seconds.
+    Obtains exclusive access to the transmit registers, waiting for up to
+    timeout seconds, then copies the message to the chip.  The caller has
+    checked the message and any rate limits.
 
 Returns:
     0,
-    S_can_badMessage for bad identifier, message length or rtr value,
-    S_can_badDevice for bad device pointer,
     S_t810_timeout indicates timeout,
     S_t810_transmitterBusy indicates an internal error.
 
-Example:
-
-
 */
 
-int canWrite (
-    canBusID_t busID,
+static int txSend (
+    t810Dev_t *pdevice,
     const canMessage_t *pmessage,
-    double timeout
+    double timeout,
+    epicsUInt64 entry
 ) {
-    t810Dev_t *pdevice = busID;
-
-    if (pdevice->magicNumber != T810_MAGIC_NUMBER) {
-	return S_t810_badDevice;
-    }
-
-    if (pmessage->identifier >= CAN_IDENTIFIERS ||
-	pmessage->length > CAN_DATA_SIZE ||
-	(pmessage->rtr != SEND && pmessage->rtr != RTR)) {
-	return S_can_badMessage;
-    }
-
     if (epicsEventWaitWithTimeout(pdevice->txSem, timeout) != epicsEventWaitOK) {
 	return S_t810_timeout;
     }
 
     if (pdevice->pchip->status & PCA_SR_TBS) {
-	putTxMessage(pdevice->pchip, pmessage);
+	pdevice->txStamp = entry;
+	pdevice->txBitsPending = frameBits(pmessage);
+	pdevice->txMessage = *pmessage;
+	if (pmessage->rtr == RTR && !(pmessage->identifier & CAN_EXTENDED)) {
+	    pdevice->rtrStamp[pmessage->identifier] =
+		(epicsUInt32) (entry >> 10) | 1;
+	}
+	if (pdevice->simulated) {
+	    simInterrupt(pdevice, PCA_IR_TI);	/* Sent instantly */
+	} else {
+	    putTxMessage(pdevice->pchip, pmessage);
+	}
 	return 0;
     }
     epicsEventSignal(pdevice->txSem);
@@ -1107,197 +2040,1448 @@ int canWrite (
 /*******************************************************************************
 
 Routine:
-    canMessage
+    txLimitFlush
 
 Purpose:
-    Register CAN message callback
+    Send messages which were held back by a transmit rate limit
 
 Description:
-    Adds a new callback routine for the given CAN message ID on the
-    given device.  There can be any number of callbacks for the same ID,
-    and all are called in turn when a message with this ID is
-    received.  As a result, the callback routine must not change the
-    message at all - it is only permitted to examine it.  The callback
-    is called from vxWorks Interrupt Context, thus there are several
-    restrictions in what the routine can perform (see vxWorks User
-    Guide for details of these).  The callback routine should be
-    declared of type canMsgCallback_t
-	void callback(void *pprivate, can_Message_t *pmessage);
-    The pprivate value supplied to canMessage is passed to the callback
-    routine with each message to allow it to identify its context.
+    Timer routine which sends each waiting message once both its own and
+    the bus's token buckets allow, oldest first.  It doesn't wait for the
+    transmitter, so it doesn't hold up the timer queue.  If any messages
+    are still waiting it restarts itself for when the next token is due.
 
 Returns:
-    0,
-    S_can_badMessage for bad identifier or NULL callback routine,
-    S_t810_badDevice for bad device pointer,
-    ENOMEM if malloc() fails.
-
-Example:
-
+    void
 
 */
 
-int canMessage (
-    canBusID_t busID,
-    canID_t identifier,
-    canMsgCallback_t *pcallback,
-    void *pprivate
+static void txLimitFlush (
+    void *pvt
 ) {
-    t810Dev_t *pdevice = busID;
-    callbackTable_t *phandler, *plist;
-
-    if (pdevice->magicNumber != T810_MAGIC_NUMBER) {
-	return S_t810_badDevice;
-    }
-
-    if (identifier >= CAN_IDENTIFIERS ||
-	pcallback == NULL) {
-	return S_can_badMessage;
-    }
-
-    phandler = malloc(sizeof (callbackTable_t));
-    if (phandler == NULL) {
-	return ENOMEM;
+    t810Dev_t *pdevice = (t810Dev_t *) pvt;
+    t810TxLimit_t *plimit, **pplink;
+    epicsUInt64 now = epicsMonotonicGet();
+    double delay = 0.0;
+
+    epicsMutexMustLock(pdevice->txLimitLock);
+    pplink = &pdevice->ppendFirst;
+    pdevice->ppendLast = NULL;
+    while ((plimit = *pplink) != NULL) {
+	double wait = bucketWait(&pdevice->txBucket, now);
+	double idWait = bucketWait(&plimit->bucket, now);
+
+	if (idWait > wait) wait = idWait;
+	if (wait == 0.0) {
+	    if (txSend(pdevice, &plimit->message, 0.0, now) == 0) {
+		bucketTake(&pdevice->txBucket, now);
+		bucketTake(&plimit->bucket, now);
+		plimit->pending = FALSE;
+		*pplink = plimit->pnext;
+		continue;
+	    }
+	    wait = 0.001;		/* Transmitter busy, try again soon */
+	}
+	if (delay == 0.0 || wait < delay) delay = wait;
+	pdevice->ppendLast = plimit;
+	pplink = &plimit->pnext;
     }
 
-    phandler->pnext     = NULL;
-    phandler->pprivate  = pprivate;
-    phandler->pcallback = (callback_t *) pcallback;
-
-    plist = (callbackTable_t *) (&pdevice->pmsgHandler[identifier]);
-    while (plist->pnext != NULL) {
-	plist = plist->pnext;
+    pdevice->txLimitArmed = (pdevice->ppendFirst != NULL);
+    if (pdevice->txLimitArmed) {
+	epicsTimerStartDelay(pdevice->txLimitTimer, delay);
     }
-    /* plist now points to the last handler in the list */
-
-    plist->pnext = phandler;
-    return 0;
+    epicsMutexUnlock(pdevice->txLimitLock);
 }
 
 
 /*******************************************************************************
 
 Routine:
-    canMsgDelete
+    txLimit
 
 Purpose:
-    Delete registered CAN message callback
+    Apply transmit rate limits to a message
 
 Description:
-    Deletes an existing callback routine for the given CAN message ID
-    on the given device.  The first matching callback found in the list
-    is deleted.  To match, the parameters to canMsgDelete must be
-    identical to those given to canMessage.
+    Called by canWrite when limits are configured for the bus.  If the
+    identifier and bus buckets both have a token the message can be sent
+    immediately.  Otherwise it is held, one per identifier, until the
+    txLimitFlush timer routine can send it; a newer message for the same
+    identifier replaces a held one, so the newest value wins and nothing
+    queues up without bound.  Extended identifiers have no slot to be
+    held in, so they are dropped when the bus limit is exceeded.
 
 Returns:
-    0,
-    S_can_badMessage for bad identifier or NULL callback routine,
-    S_can_noMessage for no matching message callback,
-    S_t810_badDevice for bad device pointer.
-
-Example:
-
+    0 with *psend TRUE if the caller should send the message now,
+    0 with *psend FALSE if it has been held, or
+    S_t810_rateLimited if it has been dropped.
 
 */
 
-int canMsgDelete (
-    canBusID_t busID,
-    canID_t identifier,
-    canMsgCallback_t *pcallback,
-    void *pprivate
+static int txLimit (
+    t810Dev_t *pdevice,
+    const canMessage_t *pmessage,
+    epicsUInt64 entry,
+    int *psend
 ) {
-    t810Dev_t *pdevice = busID;
-    callbackTable_t *phandler, *plist;
+    t810TxLimit_t *plimit;
 
-    if (pdevice->magicNumber != T810_MAGIC_NUMBER) {
-	return S_t810_badDevice;
+    *psend = FALSE;
+    if (pdevice->txLimitTimer == NULL) {
+	*psend = TRUE;			/* Before t810Initialise */
+	return 0;
     }
 
-    if (identifier >= CAN_IDENTIFIERS ||
-	pcallback == NULL) {
-	return S_can_badMessage;
-    }
+    epicsMutexMustLock(pdevice->txLimitLock);
+    plimit = pmessage->identifier & CAN_EXTENDED ? NULL :
+	     pdevice->ptxLimit[pmessage->identifier];
 
-    plist = (callbackTable_t *) (&pdevice->pmsgHandler[identifier]);
-    while (plist->pnext != NULL) {
-	phandler = plist->pnext;
-	if (((canMsgCallback_t *)phandler->pcallback == pcallback) &&
-	    (phandler->pprivate  == pprivate)) {
-	    plist->pnext = phandler->pnext;
-	    phandler->pnext = NULL;		/* Just in case... */
-	    free(phandler);
+    if (plimit != NULL && plimit->pending) {
+	plimit->message = *pmessage;
+	pdevice->txMerged++;
+	epicsMutexUnlock(pdevice->txLimitLock);
+	return 0;
+    }
+
+    if (bucketWait(&pdevice->txBucket, entry) == 0.0 &&
+	(plimit == NULL || bucketWait(&plimit->bucket, entry) == 0.0)) {
+	bucketTake(&pdevice->txBucket, entry);
+	if (plimit != NULL) bucketTake(&plimit->bucket, entry);
+	epicsMutexUnlock(pdevice->txLimitLock);
+	*psend = TRUE;
+	return 0;
+    }
+
+    if (plimit == NULL) {
+	/* Only the bus limit applies, make somewhere to hold the message */
+	if (pmessage->identifier & CAN_EXTENDED) {
+	    pdevice->txDropped++;	/* Extended IDs can't be held */
+	    epicsMutexUnlock(pdevice->txLimitLock);
+	    return S_t810_rateLimited;
+	}
+	plimit = canBusAlloc(pdevice, sizeof (t810TxLimit_t));
+	if (plimit == NULL) {
+	    pdevice->txDropped++;
+	    epicsMutexUnlock(pdevice->txLimitLock);
+	    return S_t810_rateLimited;
+	}
+	pdevice->ptxLimit[pmessage->identifier] = plimit;
+    }
+
+    plimit->message = *pmessage;
+    plimit->pending = TRUE;
+    plimit->pnext = NULL;
+    if (pdevice->ppendLast != NULL) {
+	pdevice->ppendLast->pnext = plimit;
+    } else {
+	pdevice->ppendFirst = plimit;
+    }
+    pdevice->ppendLast = plimit;
+    pdevice->txDeferred++;
+
+    if (!pdevice->txLimitArmed) {
+	double wait = bucketWait(&pdevice->txBucket, entry);
+	double idWait = bucketWait(&plimit->bucket, entry);
+
+	if (idWait > wait) wait = idWait;
+	pdevice->txLimitArmed = TRUE;
+	epicsTimerStartDelay(pdevice->txLimitTimer, wait);
+    }
+    epicsMutexUnlock(pdevice->txLimitLock);
+    return 0;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    canWrite
+
+Purpose:
+    writes a CAN message to the bus
+
+Description:
+    Sends the message described by pmessage out through the bus identified by
+    canBusID.  After some simple argument checks it obtains exclusive access to
+    the transmit registers, then copies the message to the chip.  The timeout
+    value allows task recovery in the event that exclusive access is not
+    available within a the given number of seconds.  If transmit rate
+    limits have been set with t810TxLimit and the message would exceed
+    them it is held and sent later by the driver, and 0 is returned; if
+    it can't be held it is dropped and S_t810_rateLimited returned.
+
+Returns:
+    0,
+    S_can_badMessage for bad identifier, message length or rtr value,
+    S_can_badDevice for bad device pointer,
+    S_t810_timeout indicates timeout,
+    S_t810_rateLimited if a rate limit dropped the message,
+    S_t810_transmitterBusy indicates an internal error.
+
+Example:
+
+
+*/
+
+int canWrite (
+    canBusID_t busID,
+    const canMessage_t *pmessage,
+    double timeout
+) {
+    t810Dev_t *pdevice = busID;
+    epicsUInt64 entry = epicsMonotonicGet();
+
+    if (pdevice->magicNumber != T810_MAGIC_NUMBER) {
+	return S_t810_badDevice;
+    }
+
+    if (!CAN_ID_VALID(pmessage->identifier) ||
+	((pmessage->identifier & CAN_EXTENDED) && !pdevice->simulated) ||
+	pmessage->length > CAN_DATA_SIZE ||
+	(pmessage->rtr != SEND && pmessage->rtr != RTR)) {
+	return S_can_badMessage;
+    }
+
+    if (pdevice->txLimited) {
+	int send;
+	int status = txLimit(pdevice, pmessage, entry, &send);
+
+	if (status || !send) return status;
+    }
+
+    return txSend(pdevice, pmessage, timeout, entry);
+}
+
+
+/*******************************************************************************
+
+Routine:
+    canCyclic
+
+Purpose:
+    Create, change or stop a cyclic message
+
+Description:
+    Arranges for the driver to transmit the given message on the bus
+    every period seconds from its own high priority task, without any
+    further calls from the application.  Transmissions are scheduled at
+    phase + n * period seconds after a common epoch, so cyclic messages
+    with the same period keep a fixed offset from each other.  A phase
+    outside [0, period) is reduced modulo the period.  Only one
+    cyclic message can exist per identifier on each bus; calling this
+    again for the same identifier replaces its payload and timing, and
+    a period of zero stops it.  The payload can be changed at any time
+    with canCyclicUpdate, which is much cheaper than canWrite.
+
+Returns:
+    0, or
+    S_t810_badDevice for bad bus ID,
+    S_can_badMessage for bad message Identifier or length,
+    ENOMEM if no memory is available.
+
+Example:
+    canMessage_t sync = { 0x80, SEND, 0 };
+    status = canCyclic(busID, &sync, 0.1, 0.0);
+
+*/
+
+int canCyclic (
+    canBusID_t busID,
+    const canMessage_t *pmessage,
+    double period,
+    double phase
+) {
+    t810Dev_t *pdevice = busID;
+    t810Cyclic_t *pcyclic, *pfree = NULL;
+    epicsUInt64 now;
+
+    if (pdevice->magicNumber != T810_MAGIC_NUMBER) {
+	return S_t810_badDevice;
+    }
+
+    if (!CAN_ID_VALID(pmessage->identifier) ||
+	((pmessage->identifier & CAN_EXTENDED) && !pdevice->simulated) ||
+	pmessage->length > CAN_DATA_SIZE ||
+	(pmessage->rtr != SEND && pmessage->rtr != RTR)) {
+	return S_can_badMessage;
+    }
+
+    epicsMutexMustLock(cyclicLock);
+    for (pcyclic = pcyclicFirst; pcyclic != NULL; pcyclic = pcyclic->pnext) {
+	if (pcyclic->pdevice != pdevice) continue;
+	if (pcyclic->period &&
+	    pcyclic->message.identifier == pmessage->identifier) break;
+	if (pcyclic->period == 0 && pfree == NULL) pfree = pcyclic;
+    }
+
+    if (period <= 0.0) {
+	if (pcyclic != NULL) pcyclic->period = 0;
+	epicsMutexUnlock(cyclicLock);
+	return 0;
+    }
+
+    if (pcyclic == NULL) {
+	pcyclic = pfree;
+    }
+    if (pcyclic == NULL) {
+	pcyclic = canBusAlloc(pdevice, sizeof (t810Cyclic_t));
+	if (pcyclic == NULL) {
+	    epicsMutexUnlock(cyclicLock);
+	    return ENOMEM;
+	}
+	pcyclic->pdevice = pdevice;
+	pcyclic->pnext = pcyclicFirst;
+	pcyclicFirst = pcyclic;
+    }
+
+    pcyclic->message = *pmessage;
+    pcyclic->period  = (epicsUInt64) (period * 1e9);
+    /* Normalize the phase into [0, period) */
+    phase = fmod(phase, period);
+    if (phase < 0.0) phase += period;
+    if (phase >= period) phase = 0.0;
+    pcyclic->phase   = (epicsUInt64) (phase * 1e9);
+    pcyclic->sent    = 0;
+    pcyclic->missed  = 0;
+    pcyclic->maxLate = 0;
+    if (pcyclic->period == 0) pcyclic->period = 1;
+
+    /* First transmission is the next slot after now */
+    now = epicsMonotonicGet();
+    pcyclic->next = cyclicEpoch + pcyclic->phase;
+    if (pcyclic->next <= now) {
+	pcyclic->next += ((now - pcyclic->next) / pcyclic->period + 1) *
+			 pcyclic->period;
+    }
+    epicsMutexUnlock(cyclicLock);
+
+    epicsEventSignal(pdevice->cyclicWake);
+    return 0;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    canCyclicUpdate
+
+Purpose:
+    Change the payload of a cyclic message
+
+Description:
+    If a cyclic message with the same identifier exists on the bus, its
+    payload is replaced with the given message, which will be sent in
+    the next slot.  Nothing is transmitted by this call.  Output device
+    support uses this in place of canWrite, so records can refresh a
+    cyclic message without adding their own scan jitter to its timing.
+
+Returns:
+    0, or
+    S_t810_badDevice for bad bus ID,
+    S_can_badMessage for bad message length,
+    S_can_noMessage if there is no such cyclic message.
+
+Example:
+    status = canCyclicUpdate(busID, &message);
+    if (status == S_can_noMessage)
+	status = canWrite(busID, &message, timeout);
+
+*/
+
+int canCyclicUpdate (
+    canBusID_t busID,
+    const canMessage_t *pmessage
+) {
+    t810Dev_t *pdevice = busID;
+    t810Cyclic_t *pcyclic;
+
+    if (pdevice->magicNumber != T810_MAGIC_NUMBER) {
+	return S_t810_badDevice;
+    }
+    if (pmessage->length > CAN_DATA_SIZE) {
+	return S_can_badMessage;
+    }
+    if (pcyclicFirst == NULL) {
+	return S_can_noMessage;
+    }
+
+    epicsMutexMustLock(cyclicLock);
+    for (pcyclic = pcyclicFirst; pcyclic != NULL; pcyclic = pcyclic->pnext) {
+	if (pcyclic->pdevice == pdevice && pcyclic->period &&
+	    pcyclic->message.identifier == pmessage->identifier) {
+	    pcyclic->message = *pmessage;
+	    epicsMutexUnlock(cyclicLock);
 	    return 0;
 	}
-	plist = phandler;
     }
+    epicsMutexUnlock(cyclicLock);
+    return S_can_noMessage;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    canBusAlloc
+
+Purpose:
+    Allocate memory from a bus's memory pool
+
+Description:
+    Returns zeroed memory for an object which will be used with the given
+    bus, taken from large chunks that belong to that bus.  This is meant
+    for device support private structures and the driver's own callback
+    nodes, which are created at initialisation and never freed; it keeps
+    the objects for each bus together instead of scattering them across
+    the heap.  The memory can't be returned.  If busID is NULL (because
+    the address didn't parse) the memory comes from calloc() instead.
+
+Returns:
+    Pointer to memory, or NULL if it can't be allocated.
+
+Example:
+    pcanAi = canBusAlloc(inp.canBusID, sizeof(aiCanPrivate_t));
+
+*/
+
+void *canBusAlloc (
+    canBusID_t busID,
+    size_t size
+) {
+    t810Dev_t *pdevice = busID;
+    void *pmem;
+
+    if (pdevice == NULL) {
+	return calloc(1, size);
+    }
+    if (pdevice->magicNumber != T810_MAGIC_NUMBER) {
+	return NULL;
+    }
+
+    size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+    epicsMutexMustLock(pdevice->arenaLock);
+    if (size > pdevice->arenaFree) {
+	/* Start a new chunk, abandoning the end of the current one */
+	size_t chunk = size > ARENA_CHUNK ? size : ARENA_CHUNK;
+	char *pchunk = calloc(1, chunk);
+
+	if (pchunk == NULL) {
+	    epicsMutexUnlock(pdevice->arenaLock);
+	    return NULL;
+	}
+	pdevice->arenaNext = pchunk;
+	pdevice->arenaFree = chunk;
+	pdevice->arenaSize += chunk;
+	pdevice->arenaChunks++;
+    }
+    pmem = pdevice->arenaNext;
+    pdevice->arenaNext += size;
+    pdevice->arenaFree -= size;
+    pdevice->arenaUsed += size;
+    pdevice->arenaObjects++;
+    epicsMutexUnlock(pdevice->arenaLock);
+
+    return pmem;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    allocHandler & freeHandler
+
+Purpose:
+    Manage callback table nodes
+
+Description:
+    Callback nodes come from the bus memory pool; deleted nodes are kept
+    on a free list for reuse, since pool memory can't be released.
+
+Returns:
+    Node pointer or NULL if out of memory; void
+
+*/
+
+static callbackTable_t *allocHandler (
+    t810Dev_t *pdevice
+) {
+    callbackTable_t *phandler;
+
+    epicsMutexMustLock(pdevice->arenaLock);
+    phandler = pdevice->pfreeHandler;
+    if (phandler != NULL) {
+	pdevice->pfreeHandler = phandler->pnext;
+	pdevice->handlerFree--;
+    }
+    epicsMutexUnlock(pdevice->arenaLock);
+
+    if (phandler == NULL) {
+	phandler = canBusAlloc(pdevice, sizeof (callbackTable_t));
+	if (phandler == NULL) return NULL;
+    }
+
+    epicsMutexMustLock(pdevice->arenaLock);
+    pdevice->handlerCount++;
+    epicsMutexUnlock(pdevice->arenaLock);
+    return phandler;
+}
+
+static void freeHandler (
+    t810Dev_t *pdevice,
+    callbackTable_t *phandler
+) {
+    epicsMutexMustLock(pdevice->arenaLock);
+    phandler->pnext = pdevice->pfreeHandler;
+    pdevice->pfreeHandler = phandler;
+    pdevice->handlerFree++;
+    pdevice->handlerCount--;
+    epicsMutexUnlock(pdevice->arenaLock);
+}
+
+
+/*******************************************************************************
+
+Routine:
+    extFind & handlerList
+
+Purpose:
+    Look up the callback list for a message identifier
+
+Description:
+    Standard 11-bit identifiers index the pmsgHandler table directly.
+    Extended identifiers are kept in an open addressed hash table with
+    linear probing, so a lookup usually touches a single cache line.  The
+    table is doubled when it becomes half full; the new table is filled
+    before it replaces the old one, which is left in the bus memory pool
+    so the receive task can safely finish a lookup in it.  Slots are never
+    removed, a deleted identifier just has an empty callback list.
+    handlerList returns the list head as a dummy callbackTable_t, in the
+    same way that canMessage has always walked pmsgHandler[].
+
+Returns:
+    Slot or list pointer, or NULL if not found or out of memory.
+
+*/
+
+static t810ExtSlot_t *extFind (
+    t810ExtTable_t *ptable,
+    canID_t identifier
+) {
+    unsigned int i;
+
+    if (ptable == NULL) return NULL;
+
+    i = ((identifier * 0x9e3779b1u) >> 8) & ptable->mask;
+    while (ptable->slot[i].identifier != 0) {
+	if (ptable->slot[i].identifier == identifier)
+	    return &ptable->slot[i];
+	i = (i + 1) & ptable->mask;
+    }
+    return NULL;
+}
+
+static t810ExtSlot_t *extPlace (
+    t810ExtTable_t *ptable,
+    const t810ExtSlot_t *pentry
+) {
+    unsigned int i = ((pentry->identifier * 0x9e3779b1u) >> 8) & ptable->mask;
+
+    while (ptable->slot[i].identifier != 0) {
+	i = (i + 1) & ptable->mask;
+    }
+    ptable->slot[i].phandler = pentry->phandler;
+    ptable->slot[i].identifier = pentry->identifier;
+    ptable->used++;
+    return &ptable->slot[i];
+}
+
+static t810ExtSlot_t *extInsert (
+    t810Dev_t *pdevice,
+    canID_t identifier
+) {
+    t810ExtTable_t *ptable = pdevice->pextTable;
+    t810ExtSlot_t *pslot = extFind(ptable, identifier);
+    t810ExtSlot_t entry;
+    unsigned int i;
+
+    if (pslot != NULL) return pslot;
+
+    if (ptable == NULL || 2 * (ptable->used + 1) > ptable->mask + 1) {
+	unsigned int size = ptable ? 2 * (ptable->mask + 1) : 64;
+	t810ExtTable_t *pnew = canBusAlloc(pdevice, sizeof (t810ExtTable_t) +
+				(size - 1) * sizeof (t810ExtSlot_t));
+
+	if (pnew == NULL) return NULL;
+	pnew->mask = size - 1;
+	pnew->used = 0;
+	for (i = 0; ptable != NULL && i <= ptable->mask; i++) {
+	    if (ptable->slot[i].identifier != 0)
+		extPlace(pnew, &ptable->slot[i]);
+	}
+	pdevice->pextTable = ptable = pnew;
+    }
+
+    entry.identifier = identifier;
+    entry.phandler = NULL;
+    return extPlace(ptable, &entry);
+}
+
+static callbackTable_t *handlerList (
+    t810Dev_t *pdevice,
+    canID_t identifier,
+    int create
+) {
+    t810ExtSlot_t *pslot;
+
+    if (!(identifier & CAN_EXTENDED)) {
+	return (callbackTable_t *) (&pdevice->pmsgHandler[identifier]);
+    }
+
+    pslot = create ? extInsert(pdevice, identifier) :
+		     extFind(pdevice->pextTable, identifier);
+    if (pslot == NULL) return NULL;
+    return (callbackTable_t *) (&pslot->phandler);
+}
+
+
+/*******************************************************************************
+
+Routine:
+    canMessage
+
+Purpose:
+    Register CAN message callback
+
+Description:
+    Adds a new callback routine for the given CAN message ID on the
+    given device.  There can be any number of callbacks for the same ID,
+    and all are called in turn when a message with this ID is
+    received.  As a result, the callback routine must not change the
+    message at all - it is only permitted to examine it.  The callback
+    is called from vxWorks Interrupt Context, thus there are several
+    restrictions in what the routine can perform (see vxWorks User
+    Guide for details of these).  The callback routine should be
+    declared of type canMsgCallback_t
+	void callback(void *pprivate, can_Message_t *pmessage);
+    The pprivate value supplied to canMessage is passed to the callback
+    routine with each message to allow it to identify its context.
+
+Returns:
+    0,
+    S_can_badMessage for bad identifier or NULL callback routine,
+    S_t810_badDevice for bad device pointer,
+    ENOMEM if no memory is available.
+
+Example:
+
+
+*/
+
+int canMessage (
+    canBusID_t busID,
+    canID_t identifier,
+    canMsgCallback_t *pcallback,
+    void *pprivate
+) {
+    t810Dev_t *pdevice = busID;
+    callbackTable_t *phandler, *plist;
+
+    if (pdevice->magicNumber != T810_MAGIC_NUMBER) {
+	return S_t810_badDevice;
+    }
+
+    if (!CAN_ID_VALID(identifier) ||
+	pcallback == NULL) {
+	return S_can_badMessage;
+    }
+
+    plist = handlerList(pdevice, identifier, TRUE);
+    if (plist == NULL) {
+	return ENOMEM;
+    }
+
+    phandler = allocHandler(pdevice);
+    if (phandler == NULL) {
+	return ENOMEM;
+    }
+
+    phandler->pnext     = NULL;
+    phandler->pprivate  = pprivate;
+    phandler->pcallback = (callback_t *) pcallback;
+
+    while (plist->pnext != NULL) {
+	plist = plist->pnext;
+    }
+    /* plist now points to the last handler in the list */
+
+    plist->pnext = phandler;
+    return 0;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    canMsgDelete
+
+Purpose:
+    Delete registered CAN message callback
+
+Description:
+    Deletes an existing callback routine for the given CAN message ID
+    on the given device.  The first matching callback found in the list
+    is deleted.  To match, the parameters to canMsgDelete must be
+    identical to those given to canMessage.
+
+Returns:
+    0,
+    S_can_badMessage for bad identifier or NULL callback routine,
+    S_can_noMessage for no matching message callback,
+    S_t810_badDevice for bad device pointer.
+
+Example:
+
+
+*/
+
+int canMsgDelete (
+    canBusID_t busID,
+    canID_t identifier,
+    canMsgCallback_t *pcallback,
+    void *pprivate
+) {
+    t810Dev_t *pdevice = busID;
+    callbackTable_t *phandler, *plist;
+
+    if (pdevice->magicNumber != T810_MAGIC_NUMBER) {
+	return S_t810_badDevice;
+    }
+
+    if (!CAN_ID_VALID(identifier) ||
+	pcallback == NULL) {
+	return S_can_badMessage;
+    }
+
+    plist = handlerList(pdevice, identifier, FALSE);
+    if (plist == NULL) {
+	return S_can_noMessage;
+    }
+    while (plist->pnext != NULL) {
+	phandler = plist->pnext;
+	if (((canMsgCallback_t *)phandler->pcallback == pcallback) &&
+	    (phandler->pprivate  == pprivate)) {
+	    plist->pnext = phandler->pnext;
+	    freeHandler(pdevice, phandler);
+	    return 0;
+	}
+	plist = phandler;
+    }
+
+    return S_can_noMessage;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    canSignal
+
+Purpose:
+    Register CAN error signal callback
+
+Description:
+    Adds a new callback routine for the CAN error reports.  There can be
+    any number of error callbacks, and all are called in turn when the
+    controller chip reports an error or bus Off.  The ISR queues the new
+    state for the driver's receive task, which calls the callbacks in
+    order with the received messages, so the callback runs at task level
+    but should not block as it delays message processing for all buses.
+    The callback routine should be declared a canSigCallback_t
+	void callback(void *pprivate, int status);
+    The pprivate value supplied to canSignal is passed to the callback
+    routine with the error status to allow it to identify its context.
+    Status values will be one of
+	CAN_BUS_OK,
+	CAN_BUS_ERROR or
+	CAN_BUS_OFF.
+    If the chip goes to the Bus Off state, the driver will attempt to
+    restart it.
+
+Returns:
+    0,
+    S_t810_badDevice for bad device pointer,
+    ENOMEM if no memory is available.
+
+Example:
+
+
+*/
+
+int canSignal (
+    canBusID_t busID,
+    canSigCallback_t *pcallback,
+    void *pprivate
+) {
+    t810Dev_t *pdevice = busID;
+    callbackTable_t *phandler, *plist;
+
+    if (pdevice->magicNumber != T810_MAGIC_NUMBER) {
+	return S_t810_badDevice;
+    }
+
+    phandler = allocHandler(pdevice);
+    if (phandler == NULL) {
+	return ENOMEM;
+    }
+
+    phandler->pnext     = NULL;
+    phandler->pprivate  = pprivate;
+    phandler->pcallback = (callback_t *) pcallback;
+
+    plist = (callbackTable_t *) (&pdevice->psigHandler);
+    while (plist->pnext != NULL) {
+	plist = plist->pnext;
+    }
+    /* plist now points to the last handler in the list */
+
+    plist->pnext = phandler;
+    return 0;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    canRead
+
+Purpose:
+    read incoming CAN message, any ID number
+
+Description:
+    The simplest way to implement this is have canRead take a message
+    ID in the buffer, send an RTR and look for the returned value of
+    this message.  This is in keeping with the CAN philosophy and makes
+    it useful for simple software interfaces.  More complex ones ought
+    to use the canMessage callback functions.
+
+Returns:
+    0, or
+    S_t810_badDevice for bad bus ID,
+    S_can_badMessage for bad message Identifier or length,
+    S_t810_timeout for timeout
+
+Example:
+    canMessage_t myBuffer = {
+	139,	// Can ID
+	0,	// RTR
+	4	// Length
+    };
+    int status = canRead(canID, &myBuffer, WAIT_FOREVER);
+
+*/
+
+int canRead (
+    canBusID_t busID,
+    canMessage_t *pmessage,
+    double timeout
+) {
+    t810Dev_t *pdevice = busID;
+    int status;
+
+    if (pdevice->magicNumber != T810_MAGIC_NUMBER) {
+	return S_t810_badDevice;
+    }
+
+    if (pmessage->identifier >= CAN_IDENTIFIERS ||
+	pmessage->length > CAN_DATA_SIZE) {
+	return S_can_badMessage;
+    }
+
+    /* Ensure that only one task canRead at once */
+    if (epicsMutexLock(pdevice->readSem) != epicsMutexLockOK) {
+	return S_t810_badDevice;
+    }
+
+    pdevice->preadBuffer = pmessage;
+
+    /* All set for the reply, now send the request */
+    pmessage->rtr = RTR;
+
+    status = canWrite(busID, pmessage, timeout);
+    if (status == 0) {
+	/* Wait for the message to be recieved */
+	switch (epicsEventWaitWithTimeout(pdevice->rxSem, timeout)) {
+	case epicsEventWaitTimeout:
+	    status = S_t810_timeout;
+	    break;
+	case epicsEventWaitError:
+	    status = S_t810_badDevice;
+	    break;
+	default:
+	    break;
+	}
+    }
+    if (status) {
+	/* Problem (timeout) sending the RTR or receiving the reply */
+	pdevice->preadBuffer = NULL;
+	epicsEventTryWait(pdevice->rxSem);	/* Try to clean up */
+    }
+    epicsMutexUnlock(pdevice->readSem);
+    return status;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    canTest
+
+Purpose:
+    Test routine, sends a single message to the named bus.
+
+Description:
+    This routine is intended for use from the vxWorks shell.
+
+Returns:
+    0, or ERROR
+
+Example:
+
+
+*/
+
+int canTest (
+    char *pbusName,
+    canID_t identifier,
+    int rtr,
+    int length,
+    char *data
+) {
+    canBusID_t busID;
+    canMessage_t message;
+    int status;
+
+    if (pbusName == NULL) {
+	printf("Usage: canTest \"busname\", id, rtr, len, \"data\"\n");
+	return -1;
+    }
+
+    status = canOpen(pbusName, &busID);
+    if (status) {
+	printf("Error %d opening CAN bus '%s'\n", status, pbusName);
+	return -1;
+    }
+
+    message.identifier = identifier;
+    message.rtr        = rtr ? RTR : SEND;
+    message.length     = length;
+
+    if (rtr == 0) {
+	memcpy(&message.data[0], data, length);
+    }
+
+    status = canWrite(busID, &message, 0);
+    if (status) {
+	printf("Error %d writing message\n", status);
+	return -1;
+    }
+    return 0;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    histPercentile
+
+Purpose:
+    Estimate a percentile from a latency histogram
+
+Description:
+    Walks the buckets until the requested fraction of samples has been
+    passed, and returns the upper bound of that bucket in microseconds.
+    Samples in the overflow bucket are reported as the maximum seen.
+
+Returns:
+    Latency in microseconds, or 0 if the histogram is empty.
+
+*/
+
+static double histPercentile (
+    const t810Hist_t *phist,
+    double fraction
+) {
+    epicsUInt32 count = phist->count;
+    epicsUInt32 target = (epicsUInt32) (fraction * count + 0.5);
+    epicsUInt32 seen = 0;
+    int n;
+
+    if (count == 0) return 0.0;
+    if (target == 0) target = 1;
+
+    for (n = 0; n < HIST_BUCKETS - 1; n++) {
+	seen += phist->bucket[n];
+	if (seen >= target) {
+	    return (1024.0 * (1 << n)) / 1000.0;
+	}
+    }
+    return phist->max / 1000.0;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    t810LatencyGet
+
+Purpose:
+    Return a latency statistic for a CAN bus
+
+Description:
+    Reads one statistic from one of the latency histograms which are kept
+    for each bus.  The stage is one of the T810_LAT_* values and the
+    statistic one of the T810_STAT_* values from drvTip810.h.  The mean
+    and maximum are exact, percentiles are rounded up to a power-of-two
+    bucket boundary.  All times are returned in microseconds.
+
+Returns:
+    0, or
+    S_t810_badDevice for bad bus ID,
+    S_t810_badParam for an unknown stage or statistic.
+
+Example:
+    double p99;
+    status = t810LatencyGet(busID, T810_LAT_RX_QUEUE, T810_STAT_P99, &p99);
+
+*/
+
+int t810LatencyGet (
+    canBusID_t busID,
+    int stage,
+    int stat,
+    double *pvalue
+) {
+    t810Dev_t *pdevice = busID;
+    t810Hist_t hist;
+    int key;
+
+    if (pdevice == NULL ||
+	pdevice->magicNumber != T810_MAGIC_NUMBER) {
+	return S_t810_badDevice;
+    }
+    if (stage < 0 || stage >= T810_LAT_STAGES) {
+	return S_t810_badParam;
+    }
+    key = epicsInterruptLock();
+    hist = pdevice->latency[stage];	/* Consistent snapshot */
+    epicsInterruptUnlock(key);
+
+    switch (stat) {
+    case T810_STAT_COUNT:
+	*pvalue = hist.count;
+	break;
+    case T810_STAT_MEAN:
+	*pvalue = hist.count ?
+		  (double) hist.sum / hist.count / 1000.0 : 0.0;
+	break;
+    case T810_STAT_P50:
+	*pvalue = histPercentile(&hist, 0.50);
+	break;
+    case T810_STAT_P90:
+	*pvalue = histPercentile(&hist, 0.90);
+	break;
+    case T810_STAT_P99:
+	*pvalue = histPercentile(&hist, 0.99);
+	break;
+    case T810_STAT_MAX:
+	*pvalue = hist.max / 1000.0;
+	break;
+    default:
+	return S_t810_badParam;
+    }
+    return 0;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    t810LatencyReport
+
+Purpose:
+    Print the latency histograms for one or all CAN buses
+
+Description:
+    Prints summary statistics and the non-empty buckets of each latency
+    histogram for the named bus, or for every bus if no name is given.
+    The histograms are copied under the interrupt lock before printing;
+    if reset is non-zero they are cleared in the same locked section so
+    no samples are lost between the copy and the reset.
+
+Returns:
+    0, or S_can_noDevice if no match found.
+
+Example:
+    t810LatencyReport("CAN1", 0);
+
+*/
+
+static const char * const latencyStageName[T810_LAT_STAGES] = {
+    "ISR to dequeue", "Dequeue to callbacks done",
+    "RTR to reply", "canWrite to Tx interrupt",
+    "ISR duration"
+};
+
+int t810LatencyReport (
+    const char *pbusName,
+    int reset
+) {
+    t810Dev_t *pdevice = pt810First;
+    t810Hist_t latency[T810_LAT_STAGES];
+    int found = FALSE;
+    int stage, n, key;
+
+    for (; pdevice != NULL; pdevice = pdevice->pnext) {
+	if (pbusName && *pbusName &&
+	    strcmp(pdevice->pbusName, pbusName) != 0) continue;
+	found = TRUE;
+
+	key = epicsInterruptLock();
+	memcpy(latency, pdevice->latency, sizeof(latency));
+	if (reset) {
+	    memset(pdevice->latency, 0, sizeof(pdevice->latency));
+	}
+	epicsInterruptUnlock(key);
+
+	printf("CAN bus '%s' latency, microseconds:\n", pdevice->pbusName);
+	for (stage = 0; stage < T810_LAT_STAGES; stage++) {
+	    t810Hist_t hist = latency[stage];
+
+	    printf("  %-26s count %u", latencyStageName[stage], hist.count);
+	    if (hist.count == 0) {
+		printf("\n");
+		continue;
+	    }
+	    printf(", mean %.1f, p50 <%.0f, p99 <%.0f, max %.1f\n",
+		   (double) hist.sum / hist.count / 1000.0,
+		   histPercentile(&hist, 0.50), histPercentile(&hist, 0.99),
+		   hist.max / 1000.0);
+	    for (n = 0; n < HIST_BUCKETS; n++) {
+		if (hist.bucket[n] == 0) continue;
+		if (n < HIST_BUCKETS - 1)
+		    printf("\t< %6.0f : %u\n",
+			   (1024.0 * (1 << n)) / 1000.0, hist.bucket[n]);
+		else
+		    printf("\t>= %5.0f : %u\n",
+			   (1024.0 * (1 << (n - 1))) / 1000.0, hist.bucket[n]);
+	    }
+	}
+    }
+    return found ? 0 : S_can_noDevice;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    t810Gateway
+
+Purpose:
+    Add a rule to forward messages from one bus to another
+
+Description:
+    Every message received on the source bus whose identifier matches
+    identifier under mask (i.e. (id & mask) == (identifier & mask)) is
+    transmitted on the destination bus by the receive task, straight
+    after the local message callbacks have run.  If remap is not
+    negative the masked bits of the identifier are replaced by those of
+    remap, so a block of identifiers can be moved.  A non-zero rate limits
+    the rule to that many messages per second, with bursts of up to a
+    tenth of a second's worth; excess messages are dropped.  Messages are
+    also dropped if the destination transmitter is busy, since the
+    receive task must not wait.  Rules can't be removed.
+
+Returns:
+    0, or
+    S_can_noDevice if either bus doesn't exist,
+    S_t810_badParam for a bad identifier or mask, or the same bus,
+    ENOMEM if no memory is available.
+
+Example:
+    t810Gateway("CAN1", 0x180, 0x780, 0x280, "CAN2", 100.0);
+
+*/
+
+int t810Gateway (
+    const char *psrcName,
+    int identifier,
+    int mask,
+    int remap,
+    const char *pdestName,
+    double rate
+) {
+    canBusID_t srcID, destID;
+    t810Dev_t *psrc, *pdest;
+    t810Gateway_t *pgateway, **pplist;
+
+    if (psrcName == NULL || pdestName == NULL ||
+	canOpen(psrcName, &srcID) ||
+	canOpen(pdestName, &destID)) {
+	return S_can_noDevice;
+    }
+    psrc = srcID;
+    pdest = destID;
+    if (psrc == pdest ||
+	identifier < 0 || identifier >= CAN_IDENTIFIERS ||
+	mask < 0 || mask >= CAN_IDENTIFIERS ||
+	remap >= CAN_IDENTIFIERS) {
+	return S_t810_badParam;
+    }
+
+    pgateway = canBusAlloc(psrc, sizeof (t810Gateway_t));
+    if (pgateway == NULL) {
+	return ENOMEM;
+    }
+
+    pgateway->pdest = pdest;
+    pgateway->mask = mask;
+    pgateway->identifier = identifier & mask;
+    pgateway->remap = remap;
+    pgateway->limit.rate = rate;
+    pgateway->limit.burst = rate > 10.0 ? rate / 10.0 : 1.0;
+    pgateway->limit.tokens = pgateway->limit.burst;
+    pgateway->limit.stamp = epicsMonotonicGet();
+
+    /* Add to the end, the receive task may be walking the list */
+    pplist = &psrc->pgateway;
+    while (*pplist != NULL) {
+	pplist = &(*pplist)->pnext;
+    }
+    *pplist = pgateway;
+    return 0;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    t810TxLimit
+
+Purpose:
+    Set a transmit rate limit for a bus or one identifier
+
+Description:
+    Limits the rate at which canWrite transmits messages, either for the
+    whole bus (identifier < 0) or for one identifier, to rate messages
+    per second with bursts of up to burst messages (at least 1).  Messages
+    over the limit are held by the driver and sent when allowed, keeping
+    only the newest message for each identifier.  A rate of zero removes
+    the limit.
+
+Returns:
+    0, or
+    S_can_noDevice if the bus doesn't exist,
+    S_t810_badParam for a bad identifier or rate,
+    ENOMEM if no memory is available.
+
+Example:
+    t810TxLimit("CAN1", -1, 2000.0, 20.0);
+    t810TxLimit("CAN1", 0x201, 10.0, 1.0);
+
+*/
+
+int t810TxLimit (
+    const char *pbusName,
+    int identifier,
+    double rate,
+    double burst
+) {
+    canBusID_t busID;
+    t810Dev_t *pdevice;
+    t810Bucket_t *pbucket;
+    int id;
+
+    if (pbusName == NULL || canOpen(pbusName, &busID)) {
+	return S_can_noDevice;
+    }
+    pdevice = busID;
+    if (identifier >= CAN_IDENTIFIERS || rate < 0.0) {
+	return S_t810_badParam;
+    }
+
+    epicsMutexMustLock(pdevice->txLimitLock);
+    if (identifier < 0) {
+	pbucket = &pdevice->txBucket;
+    } else {
+	if (pdevice->ptxLimit[identifier] == NULL) {
+	    pdevice->ptxLimit[identifier] =
+		canBusAlloc(pdevice, sizeof (t810TxLimit_t));
+	}
+	if (pdevice->ptxLimit[identifier] == NULL) {
+	    epicsMutexUnlock(pdevice->txLimitLock);
+	    return ENOMEM;
+	}
+	pbucket = &pdevice->ptxLimit[identifier]->bucket;
+    }
+
+    pbucket->rate = rate;
+    pbucket->burst = burst < 1.0 ? 1.0 : burst;
+    pbucket->tokens = pbucket->burst;
+    pbucket->stamp = epicsMonotonicGet();
+
+    /* Bypass the limit code entirely on buses that don't use it */
+    pdevice->txLimited = (pdevice->txBucket.rate > 0.0);
+    for (id = 0; id < CAN_IDENTIFIERS && !pdevice->txLimited; id++) {
+	if (pdevice->ptxLimit[id] != NULL &&
+	    (pdevice->ptxLimit[id]->bucket.rate > 0.0 ||
+	     pdevice->ptxLimit[id]->pending))
+	    pdevice->txLimited = TRUE;
+    }
+    epicsMutexUnlock(pdevice->txLimitLock);
+    return 0;
+}
+
+
+/*******************************************************************************
+
+Routine:
+    t810MemReport
+
+Purpose:
+    Print the memory used by one or all CAN buses
+
+Description:
+    Shows the size of the device table and trace buffer for the named bus
+    (or all buses if no name is given), how much of its memory pool has
+    been allocated to device support and callback objects, and the number
+    of message and signal callback nodes in use.
+
+Returns:
+    0, or S_can_noDevice if no match found.
 
-    return S_can_noMessage;
+Example:
+    t810MemReport("CAN1");
+
+*/
+
+int t810MemReport (
+    const char *pbusName
+) {
+    t810Dev_t *pdevice = pt810First;
+    int found = FALSE;
+
+    for (; pdevice != NULL; pdevice = pdevice->pnext) {
+	size_t trace = pdevice->ptrace ?
+		       (pdevice->traceMask + 1) * sizeof(canTraceEntry_t) : 0;
+
+	if (pbusName && *pbusName &&
+	    strcmp(pdevice->pbusName, pbusName) != 0) continue;
+	found = TRUE;
+
+	epicsMutexMustLock(pdevice->arenaLock);
+	printf("CAN bus '%s' memory:\n", pdevice->pbusName);
+	printf("\tDevice table        : %8lu bytes\n",
+	       (unsigned long) sizeof(t810Dev_t));
+	printf("\tTrace buffer        : %8lu bytes\n", (unsigned long) trace);
+	printf("\tMemory pool         : %8lu bytes in %d chunks\n",
+	       (unsigned long) pdevice->arenaSize, pdevice->arenaChunks);
+	printf("\t    Allocated       : %8lu bytes to %d objects\n",
+	       (unsigned long) pdevice->arenaUsed, pdevice->arenaObjects);
+	printf("\tCallback nodes      : %8d in use, %d free\n",
+	       pdevice->handlerCount, pdevice->handlerFree);
+	epicsMutexUnlock(pdevice->arenaLock);
+    }
+    return found ? 0 : S_can_noDevice;
 }
 
 
 /*******************************************************************************
 
 Routine:
-    canSignal
+    t810LoadGet
 
 Purpose:
-    Register CAN error signal callback
+    Return the averaged bus load for a CAN bus
 
 Description:
-    Adds a new callback routine for the CAN error reports.  There can be
-    any number of error callbacks, and all are called in turn when the
-    controller chip reports an error or bus Off The callback is called
-    from vxWorks Interrupt Context, thus there are restrictions in what
-    the routine can perform (see vxWorks User Guide for details of
-    these).  The callback routine should be declared a canSigCallback_t
-	void callback(void *pprivate, int status);
-    The pprivate value supplied to canSignal is passed to the callback
-    routine with the error status to allow it to identify its context.
-    Status values will be one of
-	CAN_BUS_OK,
-	CAN_BUS_ERROR or
-	CAN_BUS_OFF.
-    If the chip goes to the Bus Off state, the driver will attempt to
-    restart it.
+    Returns the percentage of the bus capacity used by received or
+    transmitted frames, averaged with a time constant of 1, 10 or 60
+    seconds.  Frame lengths include the stuff bits and inter-frame space,
+    so a fully saturated bus reads close to 100 percent in total.
 
 Returns:
-    0,
-    S_t810_badDevice for bad device pointer,
-    ENOMEM if malloc() fails.
+    0, or
+    S_t810_badDevice for bad bus ID,
+    S_t810_badParam for an unknown direction or period.
 
 Example:
-
+    double load;
+    status = t810LoadGet(busID, T810_LOAD_RX, T810_LOAD_10S, &load);
 
 */
 
-int canSignal (
+int t810LoadGet (
     canBusID_t busID,
-    canSigCallback_t *pcallback,
-    void *pprivate
+    int direction,
+    int period,
+    double *pvalue
 ) {
     t810Dev_t *pdevice = busID;
-    callbackTable_t *phandler, *plist;
 
-    if (pdevice->magicNumber != T810_MAGIC_NUMBER) {
+    if (pdevice == NULL ||
+	pdevice->magicNumber != T810_MAGIC_NUMBER) {
 	return S_t810_badDevice;
     }
+    if (period < 0 || period >= T810_LOAD_PERIODS) {
+	return S_t810_badParam;
+    }
 
-    phandler = malloc(sizeof (callbackTable_t));
-    if (phandler == NULL) {
-	return ENOMEM;
+    switch (direction) {
+    case T810_LOAD_RX:
+	*pvalue = pdevice->rxLoad[period];
+	break;
+    case T810_LOAD_TX:
+	*pvalue = pdevice->txLoad[period];
+	break;
+    default:
+	return S_t810_badParam;
     }
+    return 0;
+}
 
-    phandler->pnext     = NULL;
-    phandler->pprivate  = pprivate;
-    phandler->pcallback = (callback_t *) pcallback;
 
-    plist = (callbackTable_t *) (&pdevice->psigHandler);
-    while (plist->pnext != NULL) {
-	plist = plist->pnext;
-    }
-    /* plist now points to the last handler in the list */
+/*******************************************************************************
 
-    plist->pnext = phandler;
+Routine:
+    t810TraceFreeze
+
+Purpose:
+    Freeze or resume the trace buffer for a CAN bus
+
+Description:
+    While frozen the ISR stops adding entries to the trace buffer, so the
+    events leading up to a problem are kept for later examination.
+
+Returns:
+    0, or S_can_noDevice if no match found.
+
+Example:
+    status = t810TraceFreeze("CAN1", 1);
+
+*/
+
+int t810TraceFreeze (
+    const char *pbusName,
+    int freeze
+) {
+    t810Dev_t *pdevice;
+    int status = canOpen(pbusName, &pdevice);
+
+    if (status) return status;
+
+    pdevice->traceFrozen = freeze;
     return 0;
 }
 
@@ -1305,140 +3489,331 @@ int canSignal (
 /*******************************************************************************
 
 Routine:
-    canRead
+    t810TraceDump
 
 Purpose:
-    read incoming CAN message, any ID number
+    Write the trace buffer for a CAN bus to a file
 
 Description:
-    The simplest way to implement this is have canRead take a message
-    ID in the buffer, send an RTR and look for the returned value of
-    this message.  This is in keeping with the CAN philosophy and makes
-    it useful for simple software interfaces.  More complex ones ought
-    to use the canMessage callback functions.
+    Freezes the trace buffer if it isn't already, writes a header and the
+    buffered entries (oldest first) to the named file, then restores the
+    previous frozen state.  The file format is defined in canTrace.h; the
+    canTraceText host program converts it to a readable listing.
 
 Returns:
     0, or
-    S_t810_badDevice for bad bus ID,
-    S_can_badMessage for bad message Identifier or length,
-    S_t810_timeout for timeout
+    S_can_noDevice if no match found,
+    S_t810_badParam if tracing is disabled,
+    errno if the file can't be written.
 
 Example:
-    canMessage_t myBuffer = {
-	139,	// Can ID
-	0,	// RTR
-	4	// Length
-    };
-    int status = canRead(canID, &myBuffer, WAIT_FOREVER);
+    status = t810TraceDump("CAN1", "/tmp/can1.trace");
 
 */
 
-int canRead (
-    canBusID_t busID,
-    canMessage_t *pmessage,
-    double timeout
+int t810TraceDump (
+    const char *pbusName,
+    const char *pfileName
 ) {
-    t810Dev_t *pdevice = busID;
-    int status;
+    t810Dev_t *pdevice;
+    canTraceHeader_t header;
+    epicsTimeStamp now;
+    epicsUInt32 head, first, size, start, count;
+    int frozen;
+    FILE *fp;
+    int status = canOpen(pbusName, &pdevice);
 
-    if (pdevice->magicNumber != T810_MAGIC_NUMBER) {
-	return S_t810_badDevice;
+    if (status) return status;
+    if (pdevice->ptrace == NULL) return S_t810_badParam;
+
+    if (pfileName == NULL || *pfileName == '\0') {
+	printf("Usage: t810TraceDump \"busname\", \"filename\"\n");
+	return S_t810_badParam;
     }
 
-    if (pmessage->identifier >= CAN_IDENTIFIERS ||
-	pmessage->length > CAN_DATA_SIZE) {
-	return S_can_badMessage;
+    frozen = pdevice->traceFrozen;
+    pdevice->traceFrozen = TRUE;
+
+    head = pdevice->traceHead;
+    size = pdevice->traceMask + 1;
+    first = head > size ? head - size : 0;
+
+    memset(&header, 0, sizeof(header));
+    header.magic     = CAN_TRACE_MAGIC;
+    header.version   = CAN_TRACE_VERSION;
+    header.entrySize = sizeof(canTraceEntry_t);
+    header.entries   = head - first;
+    header.lost      = first;
+    header.busRate   = pdevice->busRate;
+    epicsTimeGetCurrent(&now);
+    header.refStamp  = epicsMonotonicGet();
+    header.refSec    = now.secPastEpoch;
+    header.refNsec   = now.nsec;
+    strncpy(header.busName, pdevice->pbusName, sizeof(header.busName) - 1);
+
+    fp = fopen(pfileName, "wb");
+    if (fp == NULL) {
+	status = errno;
+	goto done;
     }
 
-    /* Ensure that only one task canRead at once */
-    if (epicsMutexLock(pdevice->readSem) != epicsMutexLockOK) {
-	return S_t810_badDevice;
+    /* The entries may wrap around the end of the buffer */
+    start = first & pdevice->traceMask;
+    count = size - start;
+    if (count > header.entries) count = header.entries;
+
+    if (fwrite(&header, sizeof(header), 1, fp) != 1 ||
+	fwrite(&pdevice->ptrace[start], sizeof(canTraceEntry_t),
+	       count, fp) != count ||
+	fwrite(&pdevice->ptrace[0], sizeof(canTraceEntry_t),
+	       header.entries - count, fp) != header.entries - count) {
+	status = errno;
+    }
+    if (fclose(fp) && !status) {
+	status = errno;
+    }
+    if (!status) {
+	printf("CAN bus '%s': %u trace entries written to '%s'\n",
+	       pdevice->pbusName, header.entries, pfileName);
     }
 
-    pdevice->preadBuffer = pmessage;
+done:
+    pdevice->traceFrozen = frozen;
+    return status;
+}
 
-    /* All set for the reply, now send the request */
-    pmessage->rtr = RTR;
 
-    status = canWrite(busID, pmessage, timeout);
-    if (status == 0) {
-	/* Wait for the message to be recieved */
-	switch (epicsEventWaitWithTimeout(pdevice->rxSem, timeout)) {
-	case epicsEventWaitTimeout:
-	    status = S_t810_timeout;
-	    break;
-	case epicsEventWaitError:
-	    status = S_t810_badDevice;
-	    break;
-	default:
-	    break;
+/*******************************************************************************
+
+Routine:
+    replayTask
+
+Purpose:
+    Feed the entries from a trace file into a simulated device
+
+Description:
+    Started by t810Replay(), this task loads each received message into
+    the emulated receive buffer and raises a receive interrupt, so the
+    message passes through the normal ISR and receive task dispatch path.
+    Bus events set the emulated status register and raise an error
+    interrupt.  Transmitted messages in the trace are skipped, since the
+    IOC being tested will generate its own.  With a speed of 0 the
+    entries are fed as fast as the receive task can take them, otherwise
+    the original spacing is divided by the speed factor.
+
+Returns:
+    void
+
+*/
+
+typedef struct {
+    t810Dev_t *pdevice;
+    canTraceEntry_t *pentry;
+    epicsUInt32 entries;
+    double speed;
+} t810Replay_t;
+
+static void replayTask (
+    void *arg
+) {
+    t810Replay_t *preplay = (t810Replay_t *) arg;
+    t810Dev_t *pdevice = preplay->pdevice;
+    pca82c200_t *pchip = pdevice->pchip;
+    epicsUInt64 start = epicsMonotonicGet();
+    epicsUInt64 first = preplay->pentry[0].stamp;
+    epicsUInt32 n, replayed = 0;
+    int i;
+
+    for (n = 0; n < preplay->entries; n++) {
+	canTraceEntry_t *pentry = &preplay->pentry[n];
+	int type = pentry->type & CAN_TRACE_TYPE;
+
+	if (type == CAN_TRACE_TX ||
+	    (type == CAN_TRACE_RX &&
+	     (!CAN_ID_VALID(pentry->identifier) ||
+	      pentry->length > CAN_DATA_SIZE))) continue;
+
+	if (preplay->speed > 0.0) {
+	    double delay = (pentry->stamp - first) / 1e9 / preplay->speed -
+			   (epicsMonotonicGet() - start) / 1e9;
+	    if (delay > 0.0) {
+		epicsThreadSleep(delay);
+	    }
+	} else {
+	    /* Don't overflow the receive queue */
+	    while (epicsMessageQueuePending(receiptQueue) >= RECV_Q_SIZE / 2) {
+		epicsThreadSleep(epicsThreadSleepQuantum());
+	    }
 	}
+
+	if (type == CAN_TRACE_RX) {
+	    canMessage_t *pmessage = &pdevice->simRxMessage;
+
+	    pmessage->identifier = pentry->identifier;
+	    pmessage->rtr = pentry->type & CAN_TRACE_RTR ? RTR : SEND;
+	    pmessage->length = pentry->length;
+	    for (i = 0; i < pentry->length; i++) {
+		pmessage->data[i] = pentry->data[i];
+	    }
+	    simInterrupt(pdevice, PCA_IR_RI);
+	} else {
+	    switch (pentry->event) {
+	    case CAN_BUS_ERROR:
+		pchip->status = PCA_SR_ES | PCA_SR_TBS | PCA_SR_TCS;
+		break;
+	    case CAN_BUS_OFF:
+		pchip->status = PCA_SR_BS | PCA_SR_TBS | PCA_SR_TCS;
+		break;
+	    default:
+		pchip->status = PCA_SR_TBS | PCA_SR_TCS;
+		break;
+	    }
+	    simInterrupt(pdevice, PCA_IR_EI);
+	}
+	replayed++;
     }
-    if (status) {
-	/* Problem (timeout) sending the RTR or receiving the reply */
-	pdevice->preadBuffer = NULL;
-	epicsEventTryWait(pdevice->rxSem);	/* Try to clean up */
-    }
-    epicsMutexUnlock(pdevice->readSem);
-    return status;
+
+    printf("t810Replay: %u entries replayed on '%s' in %.3f seconds\n",
+	   replayed, pdevice->pbusName, (epicsMonotonicGet() - start) / 1e9);
+    free(preplay->pentry);
+    free(preplay);
+    pdevice->replaying = FALSE;
 }
 
 
 /*******************************************************************************
 
 Routine:
-    canTest
+    t810Replay
 
 Purpose:
-    Test routine, sends a single message to the named bus.
+    Replay a trace file into a simulated CAN bus
 
 Description:
-    This routine is intended for use from the vxWorks shell.
+    Reads a file written by t810TraceDump() and starts a task which feeds
+    the received messages and bus events it contains into the named bus,
+    which must have been created with t810CreateSim().  This drives the
+    real message and signal callbacks, and hence the device support, in
+    the same order and with the same relative timing as the original
+    (subject to the resolution of epicsThreadSleep()).  A speed of 1.0
+    reproduces the original timing, 10.0 replays 10 times faster and 0
+    replays as fast as the messages can be handled.  Trace files are
+    written in the byte order of the IOC that dumped them; a file from
+    an IOC of the other byte order is detected from its magic number,
+    as canTraceText does, and converted as it is loaded.
 
 Returns:
-    0, or ERROR
+    0, or
+    S_can_noDevice if no match found,
+    S_t810_badDevice if the bus is not simulated or already replaying,
+    S_t810_badParam if the file is not a valid trace,
+    ENOMEM or errno if the file can't be loaded.
 
 Example:
-
+    status = t810Replay("CAN1", "/data/can1.trace", 1.0);
 
 */
 
-int canTest (
-    char *pbusName,
-    canID_t identifier,
-    int rtr,
-    int length,
-    char *data
+static epicsUInt16 swap16(epicsUInt16 value) {
+    return (epicsUInt16) ((value >> 8) | (value << 8));
+}
+
+static epicsUInt32 swap32(epicsUInt32 value) {
+    return (value >> 24) | ((value >> 8) & 0xff00) |
+	   ((value << 8) & 0xff0000) | (value << 24);
+}
+
+static epicsUInt64 swap64(epicsUInt64 value) {
+    return ((epicsUInt64) swap32((epicsUInt32) value) << 32) |
+	   swap32((epicsUInt32) (value >> 32));
+}
+
+int t810Replay (
+    const char *pbusName,
+    const char *pfileName,
+    double speed
 ) {
-    canBusID_t busID;
-    canMessage_t message;
-    int status;
+    t810Dev_t *pdevice;
+    t810Replay_t *preplay;
+    canTraceHeader_t header;
+    FILE *fp;
+    int swapped = FALSE;
+    int status = canOpen(pbusName, &pdevice);
 
-    if (pbusName == NULL) {
-	printf("Usage: canTest \"busname\", id, rtr, len, \"data\"\n");
-	return -1;
+    if (status) return status;
+    if (!pdevice->simulated || pdevice->replaying) {
+	printf("t810Replay: Bus '%s' is %s\n", pbusName,
+	       pdevice->simulated ? "already replaying" : "not simulated");
+	return S_t810_badDevice;
     }
-
-    status = canOpen(pbusName, &busID);
-    if (status) {
-	printf("Error %d opening CAN bus '%s'\n", status, pbusName);
-	return -1;
+    if (pfileName == NULL || *pfileName == '\0' || speed < 0.0) {
+	printf("Usage: t810Replay \"busname\", \"filename\", speed\n");
+	return S_t810_badParam;
     }
 
-    message.identifier = identifier;
-    message.rtr        = rtr ? RTR : SEND;
-    message.length     = length;
-
-    if (rtr == 0) {
-	memcpy(&message.data[0], data, length);
+    fp = fopen(pfileName, "rb");
+    if (fp == NULL) return errno;
+
+    if (fread(&header, sizeof(header), 1, fp) != 1) {
+	header.magic = 0;
+    } else if (header.magic == swap32(CAN_TRACE_MAGIC)) {
+	/* Dumped by an IOC with the other byte order */
+	swapped = TRUE;
+	header.magic     = swap32(header.magic);
+	header.version   = swap16(header.version);
+	header.entrySize = swap16(header.entrySize);
+	header.entries   = swap32(header.entries);
+    }
+    if (header.magic != CAN_TRACE_MAGIC ||
+	header.version != CAN_TRACE_VERSION ||
+	header.entrySize != sizeof(canTraceEntry_t) ||
+	header.entries == 0) {
+	printf("t810Replay: '%s' is not a usable trace file\n", pfileName);
+	fclose(fp);
+	return S_t810_badParam;
     }
 
-    status = canWrite(busID, &message, 0);
+    preplay = malloc(sizeof(t810Replay_t));
+    if (preplay == NULL) {
+	fclose(fp);
+	return ENOMEM;
+    }
+    preplay->pdevice = pdevice;
+    preplay->entries = header.entries;
+    preplay->speed   = speed;
+    preplay->pentry  = calloc(header.entries, sizeof(canTraceEntry_t));
+    if (preplay->pentry == NULL) {
+	status = ENOMEM;
+    } else if (fread(preplay->pentry, sizeof(canTraceEntry_t),
+		     header.entries, fp) != header.entries) {
+	status = S_t810_badParam;
+    } else if (swapped) {
+	epicsUInt32 n;
+
+	/* Only the multi-byte fields need converting */
+	for (n = 0; n < header.entries; n++) {
+	    canTraceEntry_t *pentry = &preplay->pentry[n];
+
+	    pentry->stamp      = swap64(pentry->stamp);
+	    pentry->identifier = swap32(pentry->identifier);
+	}
+    }
+    fclose(fp);
+
+    if (!status) {
+	pdevice->replaying = TRUE;
+	if (epicsThreadCreate("canReplay", epicsThreadPriorityHigh - 1,
+			      epicsThreadGetStackSize(epicsThreadStackMedium),
+			      replayTask, preplay) == 0) {
+	    pdevice->replaying = FALSE;
+	    status = ENOMEM;
+	}
+    }
     if (status) {
-	printf("Error %d writing message\n", status);
-	return -1;
+	free(preplay->pentry);
+	free(preplay);
     }
-    return 0;
+    return status;
 }
 
 
@@ -1463,6 +3838,18 @@ static void t810CreateCallFunc(const iocshArgBuf *arg)
 	       arg[4].ival);
 }
 
+/* t810CreateSim(char *pbusName, int busRate) */
+static const iocshArg t810CreateSimArg0 = {"busName",iocshArgPersistentString};
+static const iocshArg t810CreateSimArg1 = {"busRate", iocshArgInt};
+static const iocshArg * const t810CreateSimArgs[2] = {
+    &t810CreateSimArg0, &t810CreateSimArg1};
+static const iocshFuncDef t810CreateSimFuncDef =
+    {"t810CreateSim",2,t810CreateSimArgs};
+static void t810CreateSimCallFunc(const iocshArgBuf *arg)
+{
+    t810CreateSim(arg[0].sval, arg[1].ival);
+}
+
 /* t810Report(int interest) */
 static const iocshArg t810ReportArg0 = {"interest", iocshArgInt};
 static const iocshArg * const t810ReportArgs[1] = {&t810ReportArg0};
@@ -1503,11 +3890,167 @@ static void canBusRestartCallFunc(const iocshArgBuf *args)
     canBusRestart(args[0].sval);
 }
 
+/* t810LatencyReport(char *pbusName, int reset) */
+static const iocshArg t810LatencyReportArg0 = {"busName", iocshArgString};
+static const iocshArg t810LatencyReportArg1 = {"reset", iocshArgInt};
+static const iocshArg * const t810LatencyReportArgs[2] = {
+    &t810LatencyReportArg0, &t810LatencyReportArg1};
+static const iocshFuncDef t810LatencyReportFuncDef =
+    {"t810LatencyReport",2,t810LatencyReportArgs};
+static void t810LatencyReportCallFunc(const iocshArgBuf *args)
+{
+    t810LatencyReport(args[0].sval, args[1].ival);
+}
+
+/* t810TraceFreeze(char *pbusName, int freeze) */
+static const iocshArg t810TraceFreezeArg0 = {"busName", iocshArgString};
+static const iocshArg t810TraceFreezeArg1 = {"freeze", iocshArgInt};
+static const iocshArg * const t810TraceFreezeArgs[2] = {
+    &t810TraceFreezeArg0, &t810TraceFreezeArg1};
+static const iocshFuncDef t810TraceFreezeFuncDef =
+    {"t810TraceFreeze",2,t810TraceFreezeArgs};
+static void t810TraceFreezeCallFunc(const iocshArgBuf *args)
+{
+    t810TraceFreeze(args[0].sval, args[1].ival);
+}
+
+/* t810TraceDump(char *pbusName, char *pfileName) */
+static const iocshArg t810TraceDumpArg0 = {"busName", iocshArgString};
+static const iocshArg t810TraceDumpArg1 = {"fileName", iocshArgString};
+static const iocshArg * const t810TraceDumpArgs[2] = {
+    &t810TraceDumpArg0, &t810TraceDumpArg1};
+static const iocshFuncDef t810TraceDumpFuncDef =
+    {"t810TraceDump",2,t810TraceDumpArgs};
+static void t810TraceDumpCallFunc(const iocshArgBuf *args)
+{
+    int status = t810TraceDump(args[0].sval, args[1].sval);
+
+    if (status)
+	printf("t810TraceDump failed, status %d\n", status);
+}
+
+/* t810Replay(char *pbusName, char *pfileName, double speed) */
+static const iocshArg t810ReplayArg0 = {"busName", iocshArgString};
+static const iocshArg t810ReplayArg1 = {"fileName", iocshArgString};
+static const iocshArg t810ReplayArg2 = {"speed", iocshArgDouble};
+static const iocshArg * const t810ReplayArgs[3] = {
+    &t810ReplayArg0, &t810ReplayArg1, &t810ReplayArg2};
+static const iocshFuncDef t810ReplayFuncDef =
+    {"t810Replay",3,t810ReplayArgs};
+static void t810ReplayCallFunc(const iocshArgBuf *args)
+{
+    int status = t810Replay(args[0].sval, args[1].sval, args[2].dval);
+
+    if (status)
+	printf("t810Replay failed, status %d\n", status);
+}
+
+/* t810MemReport(char *pbusName) */
+static const iocshArg t810MemReportArg0 = {"busName", iocshArgString};
+static const iocshArg * const t810MemReportArgs[1] = {&t810MemReportArg0};
+static const iocshFuncDef t810MemReportFuncDef =
+    {"t810MemReport",1,t810MemReportArgs};
+static void t810MemReportCallFunc(const iocshArgBuf *args)
+{
+    t810MemReport(args[0].sval);
+}
+
+/* canCyclic(char *busName, int identifier, double period, double phase,
+ *	     char *data) */
+static const iocshArg canCyclicArg0 = {"busName", iocshArgString};
+static const iocshArg canCyclicArg1 = {"identifier", iocshArgInt};
+static const iocshArg canCyclicArg2 = {"period", iocshArgDouble};
+static const iocshArg canCyclicArg3 = {"phase", iocshArgDouble};
+static const iocshArg canCyclicArg4 = {"data", iocshArgString};
+static const iocshArg * const canCyclicArgs[5] = {&canCyclicArg0,
+    &canCyclicArg1, &canCyclicArg2, &canCyclicArg3, &canCyclicArg4};
+static const iocshFuncDef canCyclicFuncDef =
+    {"canCyclic",5,canCyclicArgs};
+static void canCyclicCallFunc(const iocshArgBuf *args)
+{
+    canBusID_t busID;
+    canMessage_t message;
+    char *pdata = args[4].sval;
+    int status;
+
+    if (args[0].sval == NULL ||
+	canOpen(args[0].sval, &busID) != 0) {
+	printf("canCyclic: Bus not found\n");
+	return;
+    }
+
+    message.identifier = args[1].ival;
+    message.rtr = SEND;
+    message.length = 0;
+    while (pdata != NULL && message.length < CAN_DATA_SIZE) {
+	char *pend;
+	unsigned long byte = strtoul(pdata, &pend, 16);
+
+	if (pend == pdata) break;
+	message.data[message.length++] = byte;
+	pdata = pend;
+    }
+
+    status = canCyclic(busID, &message, args[2].dval, args[3].dval);
+    if (status) {
+	printf("canCyclic: Error %#x\n", status);
+    }
+}
+
+/* t810Gateway(char *srcBus, int identifier, int mask, int remap,
+ *	       char *destBus, double rate) */
+static const iocshArg t810GatewayArg0 = {"srcBus", iocshArgString};
+static const iocshArg t810GatewayArg1 = {"identifier", iocshArgInt};
+static const iocshArg t810GatewayArg2 = {"mask", iocshArgInt};
+static const iocshArg t810GatewayArg3 = {"remap", iocshArgInt};
+static const iocshArg t810GatewayArg4 = {"destBus", iocshArgString};
+static const iocshArg t810GatewayArg5 = {"rate", iocshArgDouble};
+static const iocshArg * const t810GatewayArgs[6] = {&t810GatewayArg0,
+    &t810GatewayArg1, &t810GatewayArg2, &t810GatewayArg3, &t810GatewayArg4,
+    &t810GatewayArg5};
+static const iocshFuncDef t810GatewayFuncDef =
+    {"t810Gateway",6,t810GatewayArgs};
+static void t810GatewayCallFunc(const iocshArgBuf *args)
+{
+    int status = t810Gateway(args[0].sval, args[1].ival, args[2].ival,
+			     args[3].ival, args[4].sval, args[5].dval);
+    if (status) {
+	printf("t810Gateway: Error %#x\n", status);
+    }
+}
+
+/* t810TxLimit(char *busName, int identifier, double rate, double burst) */
+static const iocshArg t810TxLimitArg0 = {"busName", iocshArgString};
+static const iocshArg t810TxLimitArg1 = {"identifier", iocshArgInt};
+static const iocshArg t810TxLimitArg2 = {"rate", iocshArgDouble};
+static const iocshArg t810TxLimitArg3 = {"burst", iocshArgDouble};
+static const iocshArg * const t810TxLimitArgs[4] = {&t810TxLimitArg0,
+    &t810TxLimitArg1, &t810TxLimitArg2, &t810TxLimitArg3};
+static const iocshFuncDef t810TxLimitFuncDef =
+    {"t810TxLimit",4,t810TxLimitArgs};
+static void t810TxLimitCallFunc(const iocshArgBuf *args)
+{
+    int status = t810TxLimit(args[0].sval, args[1].ival, args[2].dval,
+			     args[3].dval);
+    if (status) {
+	printf("t810TxLimit: Error %#x\n", status);
+    }
+}
+
 static void drvTip810Registrar(void) {
     iocshRegister(&t810CreateFuncDef,t810CreateCallFunc);
+    iocshRegister(&t810CreateSimFuncDef,t810CreateSimCallFunc);
     iocshRegister(&t810ReportFuncDef,t810ReportCallFunc);
     iocshRegister(&canBusResetFuncDef,canBusResetCallFunc);
     iocshRegister(&canBusStopFuncDef,canBusStopCallFunc);
     iocshRegister(&canBusRestartFuncDef,canBusRestartCallFunc);
+    iocshRegister(&canCyclicFuncDef,canCyclicCallFunc);
+    iocshRegister(&t810LatencyReportFuncDef,t810LatencyReportCallFunc);
+    iocshRegister(&t810MemReportFuncDef,t810MemReportCallFunc);
+    iocshRegister(&t810GatewayFuncDef,t810GatewayCallFunc);
+    iocshRegister(&t810TxLimitFuncDef,t810TxLimitCallFunc);
+    iocshRegister(&t810TraceFreezeFuncDef,t810TraceFreezeCallFunc);
+    iocshRegister(&t810TraceDumpFuncDef,t810TraceDumpCallFunc);
+    iocshRegister(&t810ReplayFuncDef,t810ReplayCallFunc);
 }
 epicsExportRegistrar(drvTip810Registrar);
@@ -50,12 +50,61 @@ Copyright (c) 1995-2000 Andrew Johnson
 #define S_t810_badDevice	(M_t810| 3) /*device pointer is not for t810*/
 #define S_t810_transmitterBusy	(M_t810| 4) /*transmit buffer unexpectedly busy*/
 #define S_t810_timeout		(M_t810| 5) /*timeout during request*/
+#define S_t810_badParam 	(M_t810| 6) /*unknown statistic or parameter*/
+#define S_t810_rateLimited	(M_t810| 7) /*message dropped by transmit rate limit*/
+
+
+/* Latency histogram stages */
+
+#define T810_LAT_RX_QUEUE	0	/* ISR to receive task dequeue */
+#define T810_LAT_RX_CALLBACK	1	/* dequeue to callbacks completed */
+#define T810_LAT_RTR_REPLY	2	/* RTR canWrite to reply interrupt */
+#define T810_LAT_TX_COMPLETE	3	/* canWrite entry to transmit interrupt */
+#define T810_LAT_ISR		4	/* time spent in the ISR */
+#define T810_LAT_STAGES 	5
+
+/* Latency statistics, values are returned in microseconds */
+
+#define T810_STAT_COUNT 	0	/* number of samples */
+#define T810_STAT_MEAN		1
+#define T810_STAT_P50		2	/* bucket upper bounds */
+#define T810_STAT_P90		3
+#define T810_STAT_P99		4
+#define T810_STAT_MAX		5
+
+/* Bus load directions and averaging periods, values are in percent */
+
+#define T810_LOAD_RX		0
+#define T810_LOAD_TX		1
+
+#define T810_LOAD_1S		0
+#define T810_LOAD_10S		1
+#define T810_LOAD_60S		2
+#define T810_LOAD_PERIODS	3
 
 
 epicsShareFunc int t810Status(canBusID_t busID);
 epicsShareFunc long t810Report(int page);
 epicsShareFunc long t810Create(char *busName, int card, int slot, int irqNum, int busRate);
+epicsShareFunc long t810CreateSim(char *busName, int busRate);
 epicsShareFunc void t810Shutdown(void *dummy);
 epicsShareFunc long t810Initialise(void);
+epicsShareFunc int t810LatencyGet(canBusID_t busID, int stage, int stat,
+				  double *pvalue);
+epicsShareFunc int t810LatencyReport(const char *busName, int reset);
+epicsShareFunc int t810MemReport(const char *busName);
+epicsShareFunc int t810Gateway(const char *srcBusName, int identifier,
+			       int mask, int remap, const char *destBusName,
+			       double rate);
+epicsShareFunc int t810TxLimit(const char *busName, int identifier,
+			       double rate, double burst);
+epicsShareFunc int t810LoadGet(canBusID_t busID, int direction, int period,
+			       double *pvalue);
+epicsShareFunc int t810TraceFreeze(const char *busName, int freeze);
+epicsShareFunc int t810TraceDump(const char *busName, const char *fileName);
+epicsShareFunc int t810Replay(const char *busName, const char *fileName,
+			      double speed);
+
+epicsShareExtern int t810TraceEntries;
 
 #endif /* INCdrvTip810H */
@@ -20,4 +20,11 @@ HeadURL:        $URL$
 
 const char* IP520DevCreate(char *, const char *, int, int, int);
 
+/* ioctl() request in Modbus RTU framing mode: fetch the arrival time of the
+ * oldest frame not yet asked about, as an epicsUInt64 from epicsMonotonicGet().
+ */
+#define IP520_MODBUS_STAMP  0x5201
+
+int IP520Transact(char *, const char *, int, char *, int, double);
+
 #endif
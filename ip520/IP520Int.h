@@ -19,10 +19,45 @@ HeadURL:        $URL$
 #define INC_IP520_H
 
 #include <tyLib.h>  /* For TY_DEV. */
+#include <wdLib.h>  /* For WDOG_ID. */
+#include <semLib.h> /* For SEM_ID. */
 #include <epicsTypes.h>
 
 typedef enum {RS232, RS422, RS485} RSmode;  /* IP520 - RS232 only, IP521 - RS422 or RS485 */
 
+#define IP520_FIFO_SIZE 64  /* 16C654 Rx and Tx FIFO depth. */
+
+/* Receive framing modes, see IP520Frame(). */
+#define IP520_FRAME_NONE    0   /* Pass characters up as they arrive. */
+#define IP520_FRAME_TERM    1   /* Frame ends with a terminator character. */
+#define IP520_FRAME_FIXED   2   /* Frames are a fixed length. */
+#define IP520_FRAME_LENGTH  3   /* First character gives the length. */
+#define IP520_FRAME_GAP     4   /* Frame ends after an idle gap. */
+#define IP520_FRAME_MODBUS  5   /* Modbus RTU, 3.5 char gap and CRC-16. */
+
+#define IP520_FRAME_MAX   512   /* Longest frame; longer ones are split. */
+#define IP520_STAMPS       16   /* Modbus frame timestamps kept. */
+#define IP520_FRAME_RESYNC_MS 100   /* Idle time that abandons a fixed/length frame. */
+
+/* Transaction states, see IP520Transact(). */
+#define IP520_XACT_IDLE     0
+#define IP520_XACT_WRITE    1   /* Sending the request. */
+#define IP520_XACT_READ     2   /* Collecting the reply. */
+#define IP520_XACT_SPIN_NS  1250000 /* Longest wait for TEMT, interrupts locked:
+                                     * one character at 9600 baud. */
+
+/* Transaction latency stages. */
+#define IP520_LAT_TURN      0   /* Tx FIFO empty to Rx enabled. */
+#define IP520_LAT_REPLY     1   /* Rx enabled to reply complete. */
+#define IP520_LAT_TOTAL     2   /* Whole transaction. */
+#define IP520_LAT_STAGES    3
+
+typedef struct {
+    unsigned long   count;
+    epicsUInt64     sum;          /* Nanoseconds. */
+    epicsUInt64     max;
+} IP520_LAT;
+
 struct regmap {
     union {
         struct {
@@ -63,8 +98,60 @@ typedef struct ty_ip520_dev {
     int             frameCount;   /* Rx framing error counter. */
     unsigned long   readCount;
     unsigned long   writeCount;
+    int             rxTrigger;    /* Rx FIFO trigger level. */
+    unsigned long   rxBursts;     /* Rx FIFO burst reads. */
+    unsigned long   rxRegsSaved;  /* LSR reads avoided by burst reads. */
+    unsigned long   rxDropped;    /* Rx characters lost, tty ring full. */
+    unsigned long   txFills;      /* Tx FIFO fills from the ISR. */
+    unsigned long   txFillBytes;  /* Characters written by those fills. */
+    int             rxAdapt;      /* Adapt Rx trigger level to the traffic. */
+    int             rxLevel;      /* Rx trigger level index, FCR bits 7:6. */
+    int             rxLevelMax;   /* Highest index for this baud rate. */
+    unsigned long   rxInts;       /* Rx interrupts. */
+    unsigned long   rxTimeouts;   /* Rx timeout interrupts. */
+    unsigned long   rxLevelChanges;
+    unsigned long   rxWinStart;   /* Tick count at start of window. */
+    int             rxWinChars;   /* Characters received in window. */
+    int             rxWinInts;    /* Rx interrupts in window. */
+    int             rxWinTimeouts;/* Rx timeouts in window. */
+    int             rxIntRate;    /* Rx interrupts/sec, last window. */
+    int             frameMode;    /* IP520_FRAME_xxx */
+    int             frameArg;     /* Terminator, length, or trailer length. */
+    int             frameGap;     /* Idle gap in ticks. */
+    WDOG_ID         frameWd;      /* Gap timer. */
+    int             frameFill;    /* Characters in frameBuf. */
+    int             frameNeed;    /* Length of current frame, if known. */
+    unsigned long   frames;       /* Frames passed to tyLib. */
+    unsigned long   frameSplits;  /* Frames split at IP520_FRAME_MAX. */
+    unsigned long   frameResyncs; /* Partial frames discarded. */
+    char            frameBuf[IP520_FRAME_MAX];
+    epicsUInt16     frameCrc;     /* Modbus CRC so far. */
+    epicsUInt64     frameStart;   /* Arrival time of current frame. */
+    unsigned long   crcErrors;    /* Modbus frames with a bad CRC. */
+    unsigned long   shortFrames;  /* Modbus frames under 4 characters. */
+    unsigned long   stampsLost;   /* Timestamps overwritten unread. */
+    int             stampIn, stampOut;
+    epicsUInt64     stamps[IP520_STAMPS];
+    SEM_ID          xactLock;     /* One transaction at a time. */
+    SEM_ID          xactSem;      /* Given by the ISR when done. */
+    WDOG_ID         xactWd;       /* Turnaround and reply gap timer. */
+    int             xactState;    /* IP520_XACT_xxx */
+    const char     *xactOut;      /* Request still to send. */
+    int             xactLeft;
+    char           *xactIn;       /* Reply buffer. */
+    int             xactMax;
+    int             xactGot;
+    int             xactGap;      /* Reply gap in ticks, no framing. */
+    epicsUInt64     xactCharNs;   /* One character time. */
+    epicsUInt64     xactStart;
+    epicsUInt64     xactEmpty;    /* Tx FIFO empty. */
+    epicsUInt64     xactTurn;     /* Rx enabled. */
+    unsigned long   xactTimeouts;
+    IP520_LAT       xactLat[IP520_LAT_STAGES];
 } TY_IP520_DEV;
 
+#define IP520_POLL_PRIORITY 20    /* vxWorks priority of the poll tasks. */
+
 typedef struct modTable {
     const char    *moduleID;
     TY_IP520_DEV   dev[8];
@@ -72,11 +159,28 @@ typedef struct modTable {
     epicsUInt16    carrier;
     epicsUInt16    slot;
     epicsInt16     irqCount;
+    epicsUInt8     activePorts;   /* Bit mask of created ports. */
+    unsigned long  portVisits;    /* Ports serviced by the ISR. */
+    int            pollPeriod;    /* Poll period in ticks. */
+    int            pollEnter;     /* Interrupts/sec to start polling, 0 never. */
+    int            polling;       /* Port interrupts masked, task is polling. */
+    int            pollTask;
+    SEM_ID         pollSem;       /* Given by the ISR to start polling. */
+    unsigned long  pollWinStart;  /* Tick count at start of load window. */
+    unsigned long  pollWinEvents; /* Interrupts, or polls that found work. */
+    unsigned long  polls;
+    unsigned long  pollSwitches;  /* Changes to polled mode. */
+    unsigned long  intsAvoided;   /* Polls that found work pending. */
+    epicsUInt64    intNs;         /* Time spent in the ISR. */
+    epicsUInt64    pollNs;        /* Time spent polling. */
 } MOD_TABLE;
 
 int IP520Drv(int);
 int IP520ModuleInit(const char *, const char *, int, int, int);
 const char* IP520DevCreate(char *, const char *, int, int, int);
 void IP520Report(void);
+STATUS IP520RxAdapt(char *, int);
+STATUS IP520Frame(char *, char *, int);
+STATUS IP520PollConfig(const char *, int, int);
 
 #endif
@@ -43,8 +43,15 @@ Implentation Notes:
 #include <taskLib.h>
 #include <vxLib.h>
 #include <sioLib.h>
+#include <rngLib.h>
+#include <semLib.h>
+#include <selectLib.h>
+#include <sysLib.h>
+#include <tickLib.h>
+#include <wdLib.h>
 
 #include "epicsString.h"
+#include "epicsTime.h"
 #include "epicsInterrupt.h"
 #include "drvIpac.h"
 #include "iocsh.h"
@@ -102,6 +109,69 @@ LOCAL void   IP520OptsSet(TY_IP520_DEV *, int);
 LOCAL void   EFROn(REGMAP *);
 LOCAL void   EFROff(REGMAP *);
 LOCAL void   IsrErrMsg(epicsUInt8, TY_IP520_DEV *);
+LOCAL void   IP520RxPut(TY_IP520_DEV *, char *, int);
+LOCAL void   IP520RxInsert(TY_IP520_DEV *, char *, int);
+LOCAL void   IP520FrameEnd(TY_IP520_DEV *);
+LOCAL void   IP520FrameGap(TY_IP520_DEV *);
+LOCAL int    IP520RxHold(TY_IP520_DEV *);
+LOCAL int    IP520CharBits(TY_IP520_DEV *);
+LOCAL void   IP520FrameResync(TY_IP520_DEV *);
+LOCAL STATUS IP520XactInit(TY_IP520_DEV *);
+LOCAL void   IP520XactLatency(IP520_LAT *, epicsUInt64);
+LOCAL void   IP520XactTx(TY_IP520_DEV *, epicsUInt8);
+LOCAL void   IP520XactTurn(TY_IP520_DEV *);
+LOCAL void   IP520XactRx(TY_IP520_DEV *, char *, int);
+LOCAL void   IP520XactDone(TY_IP520_DEV *);
+LOCAL void   IP520XactWd(TY_IP520_DEV *);
+LOCAL STATUS IP520TxFill(TY_IP520_DEV *, int);
+LOCAL int    IP520PortInt(TY_IP520_DEV *, volatile epicsUInt8 **);
+LOCAL int    IP520Service(MOD_TABLE *);
+LOCAL void   IP520PollMask(MOD_TABLE *, int);
+LOCAL int    IP520PollFits(MOD_TABLE *, int);
+LOCAL void   IP520PollTask(int);
+LOCAL void   IP520RxAdaptCheck(TY_IP520_DEV *, epicsUInt8, int);
+
+/* Rx FIFO trigger levels selected by FCR bits 7:6. */
+LOCAL const int rxTriggerLevel[4] = {8, 16, 56, 60};
+
+/* Receive framing mode names, indexed by IP520_FRAME_xxx. */
+LOCAL const char * const frameModeName[] = {"none", "term", "fixed", "length", "gap", "modbus"};
+
+/* Modbus CRC-16 (polynomial 0xA001, reflected) lookup table. */
+LOCAL const epicsUInt16 crcTable[256] = {
+    0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+    0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+    0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+    0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+    0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+    0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+    0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+    0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+    0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+    0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+    0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+    0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+    0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+    0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+    0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+    0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+    0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+    0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+    0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+    0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+    0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+    0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+    0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+    0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+    0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+    0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+    0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+    0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+    0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+    0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+    0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+    0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
+};
 
 
 /******************************************************************************
@@ -159,6 +229,13 @@ void IP520Report(void)
         int port;
 
         printf("Module %d: carrier=%d slot=%d irqCnt=%u\n", mod, pmod->carrier, pmod->slot, pmod->irqCount);
+        printf("  Active ports 0x%2.2X, %lu port visits\n", pmod->activePorts, pmod->portVisits);
+        printf("  %.3f sec in ISR", pmod->intNs / 1e9);
+        if (pmod->pollEnter)
+            printf("; %s, %lu switches to polling, %lu polls, %.3f sec polling, %lu interrupts avoided",
+                   pmod->polling ? "polling" : "interrupt driven", pmod->pollSwitches, pmod->polls,
+                   pmod->pollNs / 1e9, pmod->intsAvoided);
+        printf("\n");
 
         for (port = 0; port < 8; port++)
         {
@@ -171,6 +248,34 @@ void IP520Report(void)
                        dev->readCount, dev->writeCount, dev->overCount, dev->parityCount, dev->frameCount);
                 printf("  Port %d: IER = 0x%2.2hhX, LSR = 0x%2.2hhX, MCR = 0x%2.2hhX, LCR = 0x%2.2hhX\n", port,
                        regs->u.read.ier, regs->u.read.lsr, regs->u.read.mcr, regs->u.read.lcr);
+                printf("  Port %d: Rx trigger %d, %lu bursts, %lu LSR reads saved, %lu dropped\n", port,
+                       dev->rxTrigger, dev->rxBursts, dev->rxRegsSaved, dev->rxDropped);
+                printf("  Port %d: %lu Tx interrupts, %.1f chars per Tx interrupt\n", port,
+                       dev->txFills, dev->txFills ? (double) dev->txFillBytes / dev->txFills : 0.0);
+                printf("  Port %d: %s Rx trigger (max %d), %d Rx interrupts/sec, %lu Rx interrupts, %lu timeouts, %lu level changes\n",
+                       port, dev->rxAdapt ? "Adaptive" : "Fixed", rxTriggerLevel[dev->rxLevelMax],
+                       dev->rxIntRate, dev->rxInts, dev->rxTimeouts, dev->rxLevelChanges);
+                if (dev->frameMode != IP520_FRAME_NONE)
+                    printf("  Port %d: Framing %s %d, %lu frames, %lu split, %lu resyncs, %d chars pending\n",
+                           port, frameModeName[dev->frameMode], dev->frameArg, dev->frames, dev->frameSplits,
+                           dev->frameResyncs, dev->frameFill);
+                if (dev->frameMode == IP520_FRAME_MODBUS)
+                    printf("  Port %d: Modbus %lu CRC errors, %lu short frames, %lu timestamps lost\n", port,
+                           dev->crcErrors, dev->shortFrames, dev->stampsLost);
+                if (dev->xactLat[IP520_LAT_TOTAL].count || dev->xactTimeouts)
+                {
+                    IP520_LAT *lat = dev->xactLat;
+
+                    printf("  Port %d: %lu transactions, %lu timeouts; mean/max usec: turnaround %.1f/%.1f,"
+                           " reply %.1f/%.1f, total %.1f/%.1f\n", port,
+                           lat[IP520_LAT_TOTAL].count, dev->xactTimeouts,
+                           lat[IP520_LAT_TURN].count ? lat[IP520_LAT_TURN].sum / 1e3 / lat[IP520_LAT_TURN].count : 0.0,
+                           lat[IP520_LAT_TURN].max / 1e3,
+                           lat[IP520_LAT_REPLY].count ? lat[IP520_LAT_REPLY].sum / 1e3 / lat[IP520_LAT_REPLY].count : 0.0,
+                           lat[IP520_LAT_REPLY].max / 1e3,
+                           lat[IP520_LAT_TOTAL].count ? lat[IP520_LAT_TOTAL].sum / 1e3 / lat[IP520_LAT_TOTAL].count : 0.0,
+                           lat[IP520_LAT_TOTAL].max / 1e3);
+                }
             }
         }
     }
@@ -345,6 +450,8 @@ int IP520ModuleInit
         pmod->carrier = carrier;
         pmod->slot = slot;
         pmod->moduleID = ID;
+        pmod->activePorts = 0;
+        pmod->portVisits = 0;
 
         addrIO = ipmBaseAddr(carrier, slot, ipac_addrIO);
         preg = (REGMAP *) addrIO;
@@ -422,6 +529,9 @@ const char * IP520DevCreate
     if (tyDevInit (&dev->tyDev, rdBufSize, wrtBufSize, (TY_DEVSTART_PTR) IP520TxStartup) != OK)
         return NULL;
 
+    if (IP520XactInit(dev) != OK)
+        return NULL;
+
     /* initialize the channel hardware */
     IP520InitChannel(pmod, port);
 
@@ -487,6 +597,9 @@ STATUS IP520DevCreateAll
         if (tyDevInit(&dev->tyDev, rdBufSize, wrtBufSize, (TY_DEVSTART_PTR) IP520TxStartup) != OK)
             return ERROR;
 
+        if (IP520XactInit(dev) != OK)
+            return ERROR;
+
         /* initialize the channel hardware */
         IP520InitChannel(pmod, port);
 
@@ -552,6 +665,7 @@ LOCAL void IP520InitChannel(MOD_TABLE *pmod, int port)
         regs->u.write.mcr |= 0x01;  /* enable Rx transceiver */
     regs->u.write.mcr |= 0x08;      /* enable port interrupts */
 
+    pmod->activePorts |= 1 << port;
     intUnlock(key);
 }
 
@@ -570,6 +684,9 @@ LOCAL int IP520Open(TY_IP520_DEV *dev, const char * name, int mode)
 /******************************************************************************
  * IP520Write - Outputs a specified number of characters on a serial port
  *
+ * Waits for any IP520Transact() on the port to finish, so its request and
+ * reply aren't mixed up with this output.
+ *
  * NOMANUAL
  */
 LOCAL int IP520Write
@@ -591,12 +708,15 @@ LOCAL int IP520Write
         return -1;
     }
 
+    semTake(dev->xactLock, WAIT_FOREVER);
+
     if (dev->mode != RS232)
         regs->u.write.mcr &= ~(0x01);   /* Disable Rx transceiver */
         regs->u.write.mcr |= 0x02;      /* Enable  Tx transceiver */
 
     nbytes = tyWrite(&dev->tyDev, write_bfr, write_size);
 
+    semGive(dev->xactLock);
     return nbytes;
 }
 
@@ -635,6 +755,10 @@ LOCAL int IP520Write
  *      ENDIF
  *  ENDIF
  *
+ *  IF adaptive Rx trigger is enabled, AND, the current Rx level is lower
+ *      Keep the current Rx level; the level above becomes its upper limit.
+ *  ENDIF
+ *
  */
 
 LOCAL void IP520OptsSet(TY_IP520_DEV * dev, int opts)
@@ -705,6 +829,17 @@ LOCAL void IP520OptsSet(TY_IP520_DEV * dev, int opts)
             lfcr = 0x81;        /* Set Rx FIFO trigger level = 56. */
     }
 
+    /* With RTS/CTS the adaptive level may go up to 60, above the fixed level,
+     * since auto-RTS holds off the sender. Without it at 38400 baud and up the
+     * fixed level is kept low to leave FIFO space for interrupt latency. */
+    dev->rxLevelMax = lfcr >> 6;
+    if (hardwareflowcontrol)
+        dev->rxLevelMax = 3;
+    if (dev->rxAdapt && dev->rxLevel <= dev->rxLevelMax)
+        lfcr = (lfcr & 0x3F) | (dev->rxLevel << 6);
+    dev->rxLevel = lfcr >> 6;
+    dev->rxTrigger = rxTriggerLevel[dev->rxLevel];
+
     regs->u.write.fcr  = 0x00;      /* Clear FIFO's. */
     regs->u.write.fcr  = lfcr;      /* Set Rx FIFO trigger level based on baudrate,
                                      * Set Tx FIFO trigger level to 8 charaters. */
@@ -857,6 +992,20 @@ LOCAL STATUS IP520Ioctl
         case SIO_HW_OPTS_GET:
             *(int *)arg = dev->opts;
             break;
+        case IP520_MODBUS_STAMP:
+            key = intLock();
+            if (dev->stampOut == dev->stampIn)
+            {
+                errnoSet(EAGAIN);
+                status = ERROR;
+            }
+            else
+            {
+                *(epicsUInt64 *)arg = dev->stamps[dev->stampOut];
+                dev->stampOut = (dev->stampOut + 1) % IP520_STAMPS;
+            }
+            intUnlock(key);
+            break;
         default:
             status = tyIoctl(&dev->tyDev, request, arg);
             break;
@@ -919,254 +1068,1404 @@ STATUS IP520Config(char *name, int baud, char parity, int stop, int bits, char f
     return(OK);
 }
 
-/*****************************************************************************
- * IP520Int - interrupt level processing
+/******************************************************************************
  *
- * LOGIC
- * Loop through each of the 8 serial ports, until no Rx or Tx processing required.
+ * IP520RxAdapt - enable or disable the adaptive Rx FIFO trigger level
  *
+ * When enabled, the interrupt routine measures the receive data rate and the
+ * proportion of receive timeout interrupts on the port every 100 msec, and
+ * moves the Rx FIFO trigger level one step up or down between 8 characters and
+ * the level IP520OptsSet() would choose for the baud rate, or 60 characters
+ * when RTS/CTS flow control is enabled. Disabling restores that fixed level.
+ *
+ * RETURNS: OK, or ERROR if the device is not found.
  */
-void IP520Int(int mod)
+STATUS IP520RxAdapt(char *name, int enable)
 {
-    MOD_TABLE *pmod = &IP520Modules[mod];
-    REGMAP *regs;
-    volatile epicsUInt8 dummy, *flush = NULL;
-    int scan = 0;
-
-    pmod->irqCount++;
+    TY_IP520_DEV *dev = (TY_IP520_DEV *) iosDevFind(name, NULL);
+    int key;
 
-    while (scan <= 7)
+    if (!dev || strcmp(dev->tyDev.devHdr.name, name) != 0)
     {
-        epicsUInt8 isr, lsr, ier;
-        TY_IP520_DEV *dev = &pmod->dev[scan];
-        int key, work = 0;
-
-        if (!dev->created)
-        {
-            scan++;
-            continue;
-        }
-
-        regs = dev->regs;
-        key = intLock(); /* Is this required? */
-        isr = regs->u.read.isr;
-        ier = regs->u.read.ier;
-        lsr = regs->u.read.lsr;
-
-        if (lsr & 0x0E)         /* Check for overrun, parity or framing error. */
-            IsrErrMsg(lsr, dev);
-
-        while (lsr & 0x01)     /* RBR has a character to read. */
-        {
-            char inChar = regs->u.read.rbr;
-
-            tyIRd(&dev->tyDev, inChar);
-            dev->readCount++;
-            work = 1;
-            lsr = regs->u.read.lsr;
-            if (lsr & 0x0E)         /* Check for overrun, parity or framing error. */
-                IsrErrMsg(lsr, dev);
-        }
-
-        if ((ier & 0x02) && (lsr & 0x40)) /* If Tx interrupts are enabled, AND, Tx is empty (TEMT). */
-        {
-            STATUS status = OK;
-            char outChar;
-            int TxCtr = 64;
-
-            while((TxCtr > 0) && ((status = tyITx(&dev->tyDev, &outChar)) == OK))
-            {
-                regs->u.write.thr = outChar;
-                dev->writeCount++;
-                TxCtr--;
-            }
-
-            if (status == ERROR)
-            {
-                if (dev->mode != RS232)
-                {
-                    regs->u.write.mcr &= ~(0x02);   /* Disable Tx transceiver */
-                    regs->u.write.mcr |= 0x01;      /* Enable  Rx transceiver */
-                }
-                /* deactivate Tx INT and disable Tx INT */
-                regs->u.write.ier &= ~(0x02);
-                ier = regs->u.read.ier;
-                flush = &regs->u.write.ier;
-            }
-            work = 1;
-        }
-
-        if (work == 0)
-            scan++;
-
-        intUnlock(key); /* Is this required? */
+        printf("%s: Device %s not found\n", fn_nm, name);
+        return(ERROR);
     }
 
-    if (flush)
-        dummy = *flush;    /* Flush last write cycle */
+    key = intLock();
+    dev->rxAdapt = (enable != 0);
+    dev->rxWinStart = tickGet();
+    dev->rxWinChars = 0;
+    dev->rxWinInts = 0;
+    dev->rxWinTimeouts = 0;
+    if (!dev->rxAdapt)
+        IP520OptsSet(dev, dev->opts);   /* Back to the fixed level. */
+    intUnlock(key);
+    return(OK);
 }
 
-
-LOCAL void IsrErrMsg(epicsUInt8 lsr, TY_IP520_DEV *dev)
+/******************************************************************************
+ *
+ * IP520Frame - set the receive framing mode of a port
+ *
+ * In a framing mode the interrupt routine collects received characters until
+ * a complete frame has arrived, then passes the whole frame to tyLib at once,
+ * so a reading task is only woken when there is a full frame to read. The
+ * modes and the meaning of arg are:
+ *
+ *  "none"   - Characters are passed up as they arrive (the default).
+ *  "term"   - A frame ends with the character whose code is arg.
+ *  "fixed"  - Every frame is arg characters long.
+ *  "length" - The first character of a frame gives the number of characters
+ *             that follow it, plus arg trailer characters (e.g. a checksum).
+ *  "gap"    - A frame ends when nothing has been received for arg msec.
+ *  "modbus" - Modbus RTU: a frame ends after 3.5 character times of silence
+ *             (1.75 msec above 19200 baud), and only frames with a good
+ *             CRC-16 are passed up. The arrival time of each frame can be
+ *             read with the IP520_MODBUS_STAMP ioctl. arg is ignored. Set
+ *             the baud rate and character format before selecting this mode.
+ *
+ * A partial fixed or length frame is discarded after a receive error, or when
+ * nothing more arrives for IP520_FRAME_RESYNC_MS (100) msec, so the next
+ * character starts a new frame. The gap, Modbus and resync timers allow for
+ * the time to fill the Rx FIFO at the current baud rate, since characters
+ * below the trigger level raise no interrupt until then; set the baud rate
+ * and character format before selecting a mode.
+ *
+ * Frames longer than IP520_FRAME_MAX characters are passed up in pieces.
+ * Any partial frame is passed up when the mode is changed.
+ *
+ * RETURNS: OK, or ERROR if the device is not found or the mode is invalid.
+ */
+STATUS IP520Frame(char *name, char *mode, int arg)
 {
-    int cnt;
-    char *errmsg;
-    static char overrunErrMsg[] = "      : Rx overrun ctr = xxx\n";
-    static char parityErrMsg[]  = "      : Rx parity  ctr = xxx\n";
-    static char framingErrMsg[] = "      : Rx framing ctr = xxx\n";
+    TY_IP520_DEV *dev = (TY_IP520_DEV *) iosDevFind(name, NULL);
+    int fmode, gap = 0;
+    double usec = 0, fill;
+    int key;
 
-    if (lsr & 0x02)         /* Check for Rx overrun. */
+    if (!dev || strcmp(dev->tyDev.devHdr.name, name) != 0)
     {
-        cnt = ++dev->overCount;
-        errmsg = overrunErrMsg;
+        printf("%s: Device %s not found\n", fn_nm, name);
+        return(ERROR);
     }
-    else if (lsr & 0x04)    /* Check for parity error. */
+
+    for (fmode = IP520_FRAME_NONE; fmode <= IP520_FRAME_MODBUS; fmode++)
     {
-        cnt = ++dev->parityCount;
-        errmsg = parityErrMsg;
+        if (mode && strcmp(mode, frameModeName[fmode]) == 0)
+            break;
     }
-    else if (lsr & 0x08)    /* Check for framing error. */
+
+    /* Characters below the trigger level raise no interrupt until the FIFO
+     * fills or the Rx timeout, so the watchdogs must allow for that. */
+    fill = IP520_FIFO_SIZE * 1000000.0 * IP520CharBits(dev) / dev->baud;
+
+    switch (fmode)
     {
-        cnt = ++dev->frameCount;
-        errmsg = framingErrMsg;
+        case IP520_FRAME_NONE:
+            break;
+        case IP520_FRAME_TERM:
+            if (arg < 0 || arg > 255)
+                fmode = -1;
+            break;
+        case IP520_FRAME_FIXED:
+            if (arg < 1 || arg > IP520_FRAME_MAX)
+                fmode = -1;
+            usec = IP520_FRAME_RESYNC_MS * 1000.0 + fill;  /* Resync when idle */
+            break;
+        case IP520_FRAME_LENGTH:
+            if (arg < 0 || arg > IP520_FRAME_MAX - 256)
+                fmode = -1;
+            usec = IP520_FRAME_RESYNC_MS * 1000.0 + fill;
+            break;
+        case IP520_FRAME_GAP:
+            if (arg < 1)
+                fmode = -1;
+            usec = arg * 1000.0 + fill;
+            break;
+        case IP520_FRAME_MODBUS:
+            /* The Rx timeout ends frames, the watchdog is a backstop. */
+            usec = (dev->baud > 19200) ? 1750 : 3500000.0 * IP520CharBits(dev) / dev->baud;
+            usec += fill;
+            break;
+        default:
+            fmode = -1;
     }
-    else
-        return;
+    if (usec > 0)
+        gap = (int) (usec * sysClkRateGet() / 1000000 + 1) + 1;
 
-    if (cnt <= 10 || isPower2(cnt))
+    if (fmode < 0)
     {
-        int size;
-        size = strlen(dev->pmod->moduleID);
-        size = (size >= 6) ? 6 : (size - 1);
-        strncpy(errmsg, dev->pmod->moduleID, size);
-        errmsg[25] = '0' + (cnt / 100) % 10;
-        errmsg[26] = '0' + (cnt / 10) % 10;
-        errmsg[27] = '0' + cnt % 10;
-        epicsInterruptContextMessage(errmsg);
+        printf("%s: Bad framing mode \"%s\" %d for %s\n", fn_nm, mode ? mode : "", arg, name);
+        errnoSet(EINVAL);
+        return(ERROR);
+    }
+
+    if (fmode != IP520_FRAME_NONE && fmode != IP520_FRAME_TERM && !dev->frameWd)
+    {
+        dev->frameWd = wdCreate();
+        if (!dev->frameWd)
+            return(ERROR);
     }
+
+    key = intLock();
+    if (dev->frameWd)
+        wdCancel(dev->frameWd);
+    if (dev->frameFill)
+        IP520FrameEnd(dev);
+    dev->frameMode = fmode;
+    dev->frameArg = arg;
+    dev->frameGap = gap;
+    dev->frameNeed = 0;
+    dev->frameCrc = 0xFFFF;
+    dev->stampIn = dev->stampOut = 0;
+    intUnlock(key);
+    return(OK);
 }
 
 /******************************************************************************
  *
- * IP520TxStartup - transmitter startup routine
- *
- * LOGIC
- *  Initialize status = OK.
- *  Disable interrupts for processing LSR and filling the Tx FIFO.
- *  Read line status register (LSR).
- *  IF LSR shows Rx Overrun error.
- *      Call IsrErrMsg().
- *  ENDIF
+ * IP520Transact - send a request and collect the reply in one operation
  *
- *  IF Transmitter Hold Register is Empty (then FIFO is also empty).
- *      Set Tx counter to 64.
- *  ELSE
- *      Set Tx counter to 0 and let ISR fill the Tx FIFO.
- *  ENDIF
+ * This routine sends wlen characters from wbuf directly from the interrupt
+ * routine, bypassing the tty write buffer. As soon as the transmitter is
+ * empty the interrupt routine switches an RS-485/RS-422 port's transceivers
+ * back to receive, then collects the reply into rbuf and wakes the caller
+ * once when it is complete. The reply is complete when:
  *
- *  WHILE (TxCtr > 0, AND, another Tx character is available)
- *      Write character to Tx holding register (THR).
- *      Decrement TxCtr.
- *  ENDWHILE
+ *  - rmax characters have arrived, or
+ *  - the port's framing mode (see IP520Frame()) has delivered one frame, or
+ *  - with no framing mode, the line has been idle for 4 character times.
  *
- *  IF another Tx character was NOT available (the tty ringbuffer is empty)
- *      Disable Tx interrupts.
- *  ELSE
- *      Enable Tx interrupts.
- *  ENDIF
+ * Characters that arrive outside a transaction go to the tty read buffer as
+ * usual. Transactions on the same port are serialized with each other and
+ * with write(), and wait for any output queued by write() to be sent first. The time taken by each stage is
+ * accumulated for IP520Report().
  *
- *  Enable interrupts.
+ * RETURNS: The number of reply characters, or ERROR if the device is not
+ * found, the arguments are invalid, or no complete reply arrived within
+ * timeout seconds (errno ETIMEDOUT).
  */
-LOCAL void IP520TxStartup(TY_IP520_DEV *dev)
+int IP520Transact
+    (
+    char *       name,          /* device name                          */
+    const char * wbuf,          /* request to send                      */
+    int          wlen,          /* request length                       */
+    char *       rbuf,          /* buffer for reply                     */
+    int          rmax,          /* reply buffer size                    */
+    double       timeout        /* seconds to wait for the reply        */
+    )
 {
-    char outChar;
-    REGMAP *regs = dev->regs;
-    int key, TxCtr;
-    STATUS status = OK;
-    epicsUInt8 lsr;
+    TY_IP520_DEV *dev = (TY_IP520_DEV *) iosDevFind(name, NULL);
+    REGMAP *regs;
+    int clkRate = sysClkRateGet();
+    int ticks = (int) (timeout * clkRate) + 1;
+    unsigned long deadline;
+    int bits, nread, key;
 
-    key = intLock();
-    lsr = regs->u.read.lsr;
-    if (lsr & 0x0E)         /* Check for overrun, parity or framing error. */
-        IsrErrMsg(lsr, dev);
+    if (!dev || strcmp(dev->tyDev.devHdr.name, name) != 0)
+    {
+        printf("%s: Device %s not found\n", fn_nm, name);
+        return(ERROR);
+    }
+    if (!wbuf || wlen < 1 || !rbuf || rmax < 1 || timeout < 0)
+    {
+        errnoSet(EINVAL);
+        return(ERROR);
+    }
+    regs = dev->regs;
 
-    if (lsr & 0x20)
-        TxCtr = 64;
-    else
-        TxCtr = 0;
+    semTake(dev->xactLock, WAIT_FOREVER);
 
-    while((TxCtr > 0) && ((status = tyITx(&dev->tyDev, &outChar)) == OK))
+    /* Let any output already queued by write() go first */
+    deadline = tickGet() + ticks;
+    while (!rngIsEmpty(dev->tyDev.wrtBuf) || (regs->u.read.ier & 0x02))
     {
-        regs->u.write.thr = outChar;
-        dev->writeCount++;
-        TxCtr--;
+        if ((long) (tickGet() - deadline) >= 0)
+        {
+            dev->xactTimeouts++;
+            semGive(dev->xactLock);
+            errnoSet(ETIMEDOUT);
+            return(ERROR);
+        }
+        taskDelay(1);
     }
+    semTake(dev->xactSem, NO_WAIT);     /* Discard a stale completion */
 
-    if ((status == ERROR) && (dev->mode == RS232))
-        regs->u.write.ier &= ~(0x02);   /* Disable Tx interrupt */
-    else
-        regs->u.write.ier |= 0x02;      /*  Enable Tx interrupt */
+    bits = IP520CharBits(dev);
+
+    key = intLock();
+    dev->xactOut = wbuf;
+    dev->xactLeft = wlen;
+    dev->xactIn = rbuf;
+    dev->xactMax = rmax;
+    dev->xactGot = 0;
+    dev->xactCharNs = 1000000000ULL * bits / dev->baud;
+    /* Reply end backstop: the Rx timeout plus time to fill the FIFO */
+    dev->xactGap = (int) (((4 + IP520_FIFO_SIZE) * dev->xactCharNs * clkRate + 999999999ULL) /
+                          1000000000ULL) + 1;
+    dev->frameFill = 0;                 /* Drop any partial frame */
+    dev->frameNeed = 0;
+    dev->xactStart = epicsMonotonicGet();
+    dev->xactState = IP520_XACT_WRITE;
 
+    if (dev->mode != RS232)
+    {
+        regs->u.write.mcr &= ~(0x01);   /* Disable Rx transceiver */
+        regs->u.write.mcr |= 0x02;      /* Enable  Tx transceiver */
+    }
+    IP520XactTx(dev, regs->u.read.lsr);
+    if (dev->xactState == IP520_XACT_WRITE)
+        regs->u.write.ier |= 0x02;      /* Enable Tx interrupt */
     intUnlock(key);
-}
 
-/* EFROn - Enable Enhanced Functions */
-LOCAL void EFROn(REGMAP *regs)
-{
-    epicsUInt8 llcr, lefr;
+    semTake(dev->xactSem, ticks);
 
-    savedlcr = regs->u.read.lcr;        /* Save LCR. */
-    regs->u.write.lcr = 0xBF;           /* Expose EFR/Xon-1/Xon-2/Xoff-1/Xoff-2; hide ISR/FCR/MCR/LSR/MSR/SCR. */
-    llcr = regs->u.read.lcr;            /* Read LCR to flush posted writes. */
-    regs->u.write.fcr |= 0x10;          /* Write to EFR; enable writes to enhanced functions. */
-    lefr = regs->u.read.isr;            /* Read EFR to flush posted writes. */
-}
+    key = intLock();
+    if (dev->xactState != IP520_XACT_IDLE)
+    {
+        wdCancel(dev->xactWd);
+        if (dev->xactState == IP520_XACT_WRITE)
+        {
+            regs->u.write.ier &= ~(0x02);   /* Disable Tx interrupt */
+            if (dev->mode != RS232)
+            {
+                regs->u.write.mcr &= ~(0x02);   /* Disable Tx transceiver */
+                regs->u.write.mcr |= 0x01;      /* Enable  Rx transceiver */
+            }
+        }
+        dev->xactState = IP520_XACT_IDLE;
+        dev->xactTimeouts++;
+        nread = ERROR;
+    }
+    else
+        nread = dev->xactGot;
+    intUnlock(key);
 
-/* EFROff - Disable Enhanced Functions */
-LOCAL void EFROff(REGMAP * regs)
-{
-    epicsUInt8 llcr, lefr;
+    /* Send any output tyLib queued during the transaction, e.g. echoes */
+    if (!rngIsEmpty(dev->tyDev.wrtBuf))
+        IP520TxStartup(dev);
 
-    regs->u.write.fcr &= ~(0x10);       /* Write to EFR:4; disable writes to enhanced functions.
-                                         * Expose RBR/THR/IER; hide DLL/DLM, AND,
-                                         * Expose ISR/FCR/MCR/LSR/MSR/SCR; hide EFR/Xon-1/Xon-2/Xoff-1/Xoff-2. */
-    lefr = regs->u.read.isr;            /* Read EFR to flush posted writes. */
-    regs->u.write.lcr = savedlcr;       /* Restore LCR to save value. */
-    llcr = regs->u.read.lcr;            /* Read LCR to flush posted writes. */
+    semGive(dev->xactLock);
+    if (nread == ERROR)
+        errnoSet(ETIMEDOUT);
+    return nread;
 }
 
-/******************************************************************************
+/*****************************************************************************
+ * IP520Int - interrupt level processing
+ *
+ * LOGIC
+ * Service the module's ports with IP520Service(), and keep track of the time
+ * spent doing so. If polled mode is configured, measure the interrupt rate
+ * over windows of about 100 msec; when it reaches pollEnter, mask the port
+ * interrupts and wake the poll task to take over.
  *
- * Command Registration with iocsh
  */
-
-/* IP520Drv */
-static const iocshArg IP520DrvArg0 = {"maxModules", iocshArgInt};
-static const iocshArg * const IP520DrvArgs[1] = {&IP520DrvArg0};
-static const iocshFuncDef IP520DrvFuncDef = {"IP520Drv", 1, IP520DrvArgs};
-static void IP520DrvCallFunc(const iocshArgBuf *args)
+void IP520Int(int mod)
 {
-    IP520Drv(args[0].ival);
-}
+    MOD_TABLE *pmod = &IP520Modules[mod];
+    epicsUInt64 start = epicsMonotonicGet();
 
-/* IP520Report */
-static const iocshFuncDef IP520ReportFuncDef = {"IP520Report", 0, NULL};
-static void IP520ReportCallFunc(const iocshArgBuf *args)
-{
-    IP520Report();
-}
+    pmod->irqCount++;
 
-/* IP520ModuleInit */
-static const iocshArg IP520ModuleInitArg0 = {"moduleID",  iocshArgString};
-static const iocshArg IP520ModuleInitArg1 = {"RS<nnn>",   iocshArgString};
-static const iocshArg IP520ModuleInitArg2 = {"intVector", iocshArgInt};
-static const iocshArg IP520ModuleInitArg3 = {"carrier#",  iocshArgInt};
-static const iocshArg IP520ModuleInitArg4 = {"slot",      iocshArgInt};
+    if (pmod->polling)
+    {
+        IP520PollMask(pmod, TRUE);  /* Stray, should be masked already */
+        return;
+    }
 
-static const iocshArg * const IP520ModuleInitArgs[5] = {&IP520ModuleInitArg0, &IP520ModuleInitArg1, &IP520ModuleInitArg2,
-                                                        &IP520ModuleInitArg3, &IP520ModuleInitArg4};
-static const iocshFuncDef IP520ModuleInitFuncDef = {"IP520ModuleInit", 5, IP520ModuleInitArgs};
-static void IP520ModuleInitCallFunc(const iocshArgBuf *args)
+    IP520Service(pmod);
+    pmod->intNs += epicsMonotonicGet() - start;
+
+    if (pmod->pollEnter > 0)
+    {
+        int clkRate = sysClkRateGet();
+        unsigned long elapsed = tickGet() - pmod->pollWinStart;
+
+        pmod->pollWinEvents++;
+        if (elapsed >= clkRate / 10 && elapsed > 0)
+        {
+            if (pmod->pollWinEvents * clkRate / elapsed >= (unsigned long) pmod->pollEnter)
+            {
+                IP520PollMask(pmod, TRUE);
+                pmod->polling = TRUE;
+                pmod->pollSwitches++;
+                semGive(pmod->pollSem);
+            }
+            pmod->pollWinStart += elapsed;
+            pmod->pollWinEvents = 0;
+        }
+    }
+}
+
+
+/*****************************************************************************
+ * IP520Service - service all ports of a module
+ *
+ * Read the ISR of each created port once to build a mask of the ports that
+ * have an interrupt pending. Only those ports are serviced, and each one stays
+ * in the mask until its ISR shows nothing more pending, or servicing it finds
+ * no Rx or Tx work to do. Idle ports cost one register read per interrupt.
+ * Called from IP520Int(), or from the poll task with the port interrupts
+ * masked.
+ *
+ * RETURNS: The number of ports that had an interrupt pending.
+ *
+ */
+LOCAL int IP520Service(MOD_TABLE *pmod)
+{
+    volatile epicsUInt8 dummy, *flush = NULL;
+    epicsUInt8 pending = 0;
+    int port, events = 0;
+
+    for (port = 0; port <= 7; port++)
+    {
+        if ((pmod->activePorts & (1 << port)) &&
+            !(pmod->dev[port].regs->u.read.isr & 0x01))   /* Interrupt pending */
+        {
+            pending |= 1 << port;
+            events++;
+        }
+    }
+
+    while (pending)
+    {
+        for (port = 0; port <= 7; port++)
+        {
+            TY_IP520_DEV *dev = &pmod->dev[port];
+
+            if (!(pending & (1 << port)))
+                continue;
+
+            pmod->portVisits++;
+            if (!IP520PortInt(dev, &flush) ||
+                (dev->regs->u.read.isr & 0x01))
+                pending &= ~(1 << port);
+        }
+    }
+
+    if (flush)
+        dummy = *flush;    /* Flush last write cycle */
+    return events;
+}
+
+
+/*****************************************************************************
+ * IP520PollMask - mask or unmask the interrupts of all ports on a module
+ *
+ * Uses the port interrupt output enable (MCR bit 3), leaving IER and the
+ * interrupt sources alone so the ISR registers still show pending work.
+ *
+ */
+LOCAL void IP520PollMask(MOD_TABLE *pmod, int mask)
+{
+    volatile epicsUInt8 dummy;
+    int port;
+
+    for (port = 0; port <= 7; port++)
+    {
+        REGMAP *regs = pmod->dev[port].regs;
+
+        if (!(pmod->activePorts & (1 << port)))
+            continue;
+        if (mask)
+            regs->u.write.mcr &= ~(0x08);
+        else
+            regs->u.write.mcr |= 0x08;
+        dummy = regs->u.read.mcr;   /* Flush posted write */
+    }
+}
+
+
+/*****************************************************************************
+ * IP520PollFits - check a poll period against the Rx FIFO fill times
+ *
+ * A port without RTS/CTS flow control overruns if it fills its 64 character
+ * FIFO between two polls, which at 115200 baud takes about 5.5 msec.
+ *
+ * RETURNS: -1 if polling every ticks clock ticks is safe for every active
+ * port, else the number of the first port that would overrun.
+ */
+LOCAL int IP520PollFits(MOD_TABLE *pmod, int ticks)
+{
+    epicsUInt64 periodNs = 1000000000ULL * ticks / sysClkRateGet();
+    int port;
+
+    for (port = 0; port <= 7; port++)
+    {
+        TY_IP520_DEV *dev = &pmod->dev[port];
+        int bits;
+
+        if (!(pmod->activePorts & (1 << port)) || dev->baud <= 0)
+            continue;
+        if (dev->mode == RS232 && !(dev->opts & CLOCAL))
+            continue;           /* Hardware flow control holds the sender off */
+
+        bits = IP520CharBits(dev);
+        if (periodNs > 1000000000ULL * IP520_FIFO_SIZE * bits / dev->baud)
+            return port;
+    }
+    return -1;
+}
+
+
+/*****************************************************************************
+ * IP520PollTask - poll a module while its interrupt rate is high
+ *
+ * Waits for IP520Int() to switch the module to polled mode, then services all
+ * its ports every pollPeriod ticks. Each poll that finds a port with work
+ * pending stands in for a module interrupt. When fewer than half the polls in
+ * a window of about 100 msec find work, polled mode is turned off, or a baud
+ * rate change means a port could now fill its FIFO between polls, the port
+ * interrupts are unmasked and the task waits again.
+ *
+ */
+LOCAL void IP520PollTask(int mod)
+{
+    MOD_TABLE *pmod = &IP520Modules[mod];
+    int clkRate = sysClkRateGet();
+    unsigned long winPolls;
+
+    for (;;)
+    {
+        semTake(pmod->pollSem, WAIT_FOREVER);
+        pmod->pollWinStart = tickGet();
+        pmod->pollWinEvents = 0;
+        winPolls = 0;
+
+        while (pmod->polling)
+        {
+            epicsUInt64 start = epicsMonotonicGet();
+            int key;
+
+            if (IP520Service(pmod) > 0)
+            {
+                pmod->intsAvoided++;
+                pmod->pollWinEvents++;
+            }
+            pmod->pollNs += epicsMonotonicGet() - start;
+            pmod->polls++;
+            winPolls++;
+
+            if (tickGet() - pmod->pollWinStart >= clkRate / 10)
+            {
+                if (pmod->pollEnter <= 0 || pmod->pollWinEvents * 2 < winPolls ||
+                    IP520PollFits(pmod, pmod->pollPeriod) >= 0)
+                {
+                    key = intLock();
+                    pmod->polling = FALSE;
+                    pmod->pollWinStart = tickGet();
+                    pmod->pollWinEvents = 0;
+                    IP520PollMask(pmod, FALSE);
+                    intUnlock(key);
+                    break;
+                }
+                pmod->pollWinStart = tickGet();
+                pmod->pollWinEvents = 0;
+                winPolls = 0;
+            }
+            taskDelay(pmod->pollPeriod);
+        }
+    }
+}
+
+
+/*****************************************************************************
+ * IP520PollConfig - configure polled mode for a module
+ *
+ * When the interrupt rate of the module reaches enterRate per second the port
+ * interrupts are masked and a task at priority IP520_POLL_PRIORITY services
+ * all the ports every periodMs msec instead, draining the FIFOs in bulk. It
+ * goes back to interrupts once most polls find nothing to do. An enterRate
+ * of 0 turns polled mode off.
+ *
+ * The period, rounded up to whole clock ticks, must be shorter than the time
+ * any active port without RTS/CTS flow control takes to fill its Rx FIFO at
+ * its current baud rate and character format. Configure the ports first.
+ *
+ * RETURNS: OK, or ERROR if the module is not found, the arguments are
+ * invalid, the period is too long, or the poll task cannot be started.
+ */
+STATUS IP520PollConfig(const char *moduleID, int periodMs, int enterRate)
+{
+    MOD_TABLE *pmod = IP520OctalFindQT(moduleID);
+    int mod, ticks;
+
+    if (!pmod || periodMs < 0 || enterRate < 0)
+    {
+        printf("%s: Bad module %s or arguments\n", fn_nm, moduleID ? moduleID : "");
+        errnoSet(EINVAL);
+        return(ERROR);
+    }
+    mod = pmod - IP520Modules;
+
+    ticks = (periodMs * sysClkRateGet() + 999) / 1000;
+    if (ticks < 1)
+        ticks = 1;
+
+    if (enterRate > 0)
+    {
+        int port = IP520PollFits(pmod, ticks);
+
+        if (port >= 0)
+        {
+            printf("%s: %d tick poll period overruns the FIFO of %s port %d\n",
+                   fn_nm, ticks, moduleID, port);
+            errnoSet(EINVAL);
+            return(ERROR);
+        }
+    }
+
+    if (enterRate > 0 && !pmod->pollSem)
+    {
+        char name[32];
+
+        pmod->pollSem = semBCreate(SEM_Q_FIFO, SEM_EMPTY);
+        if (!pmod->pollSem)
+            return(ERROR);
+        sprintf(name, "tIP520Poll%d", mod);
+        pmod->pollTask = taskSpawn(name, IP520_POLL_PRIORITY, 0, 4096, (FUNCPTR) IP520PollTask,
+                                   mod, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        if (pmod->pollTask == ERROR)
+        {
+            printf("%s: Can't start poll task\n", fn_nm);
+            return(ERROR);
+        }
+    }
+
+    pmod->pollPeriod = ticks;
+    pmod->pollWinStart = tickGet();
+    pmod->pollWinEvents = 0;
+    pmod->pollEnter = enterRate;    /* Poll task checks this each window */
+    return(OK);
+}
+
+
+/*****************************************************************************
+ * IP520PortInt - service one port with an interrupt pending
+ *
+ * When the ISR shows the Rx trigger level was reached and LSR shows no errors
+ * anywhere in the FIFO, the FIFO holds at least rxTrigger characters, so they
+ * are read in one burst without reading LSR between them. Any characters left
+ * after that are read one at a time as before. All of them are collected in a
+ * local buffer and given to tyLib together.
+ *
+ * In the modes where IP520RxHold() is true the burst stops one short, and the
+ * rest of the FIFO is only read on a receive timeout or error. The FIFO is then
+ * never left empty by a data available interrupt, so the receive timeout
+ * always marks the next gap in the data.
+ *
+ * RETURNS: Non-zero if any Rx or Tx processing was done.
+ *
+ */
+LOCAL int IP520PortInt(TY_IP520_DEV *dev, volatile epicsUInt8 **flush)
+{
+    REGMAP *regs = dev->regs;
+    epicsUInt8 isr, lsr, ier;
+    int key, work = 0;
+
+    key = intLock(); /* Is this required? */
+    isr = regs->u.read.isr;
+    ier = regs->u.read.ier;
+    lsr = regs->u.read.lsr;
+
+    if (lsr & 0x0E)         /* Check for overrun, parity or framing error. */
+        IsrErrMsg(lsr, dev);
+
+    if (lsr & 0x01)        /* RBR has a character to read. */
+    {
+        char inBuf[IP520_FIFO_SIZE];
+        unsigned long got = dev->readCount;
+        int n = 0;
+        int hold = IP520RxHold(dev);
+        int err = lsr & 0x0E;
+
+        /* Rx data available interrupt AND no errors in the FIFO. */
+        if (((isr & 0x3F) == 0x04) && !(lsr & 0x80))
+        {
+            int burst = hold ? dev->rxTrigger - 1 : dev->rxTrigger;
+
+            while (n < burst)
+                inBuf[n++] = regs->u.read.rbr;
+            dev->readCount += n;
+            dev->rxBursts++;
+            dev->rxRegsSaved += burst - 1;
+            lsr = regs->u.read.lsr;
+            err |= lsr & 0x0E;
+            if (lsr & 0x0E)         /* Check for overrun, parity or framing error. */
+                IsrErrMsg(lsr, dev);
+        }
+
+        /* Leave the rest in the FIFO until the receive timeout */
+        if (hold && (isr & 0x3F) != 0x0C && !(lsr & 0x8E))
+            lsr &= ~0x01;
+
+        while (lsr & 0x01)
+        {
+            if (n == IP520_FIFO_SIZE)
+            {
+                IP520RxPut(dev, inBuf, n);
+                n = 0;
+            }
+            inBuf[n++] = regs->u.read.rbr;
+            dev->readCount++;
+            lsr = regs->u.read.lsr;
+            err |= lsr & 0x0E;
+            if (lsr & 0x0E)         /* Check for overrun, parity or framing error. */
+                IsrErrMsg(lsr, dev);
+        }
+
+        IP520RxPut(dev, inBuf, n);
+        IP520RxAdaptCheck(dev, isr, dev->readCount - got);
+
+        /* Fixed and length framing resync after an error; IP520FrameGap()
+         * does so after IP520_FRAME_RESYNC_MS idle. */
+        if ((dev->frameMode == IP520_FRAME_FIXED || dev->frameMode == IP520_FRAME_LENGTH) &&
+            dev->frameFill && err)
+            IP520FrameResync(dev);
+
+        /* The Rx timeout means 4 character times of silence, the frame is over. */
+        if (dev->frameMode == IP520_FRAME_MODBUS && (isr & 0x3F) == 0x0C && dev->frameFill)
+        {
+            wdCancel(dev->frameWd);
+            IP520FrameEnd(dev);
+        }
+
+        /* Unframed transaction reply; it ends at a gap, detected the same way. */
+        if (dev->xactState == IP520_XACT_READ && dev->frameMode == IP520_FRAME_NONE && dev->xactGot)
+        {
+            if ((isr & 0x3F) == 0x0C)
+                IP520XactDone(dev);
+            else
+                wdStart(dev->xactWd, dev->xactGap, (FUNCPTR) IP520XactWd, (int) dev);
+        }
+        work = 1;
+    }
+
+    if (dev->xactState == IP520_XACT_WRITE)
+    {
+        if ((ier & 0x02) && ((lsr & 0x20) || (isr & 0x3F) == 0x02))
+        {
+            IP520XactTx(dev, lsr);
+            work = 1;
+        }
+    }
+    else if ((ier & 0x02) && (lsr & 0x40)) /* If Tx interrupts are enabled, AND, Tx is empty (TEMT). */
+    {
+        unsigned long sent = dev->writeCount;
+        STATUS status = IP520TxFill(dev, IP520_FIFO_SIZE);
+
+        dev->txFills++;
+        dev->txFillBytes += dev->writeCount - sent;
+
+        if (status == ERROR)
+        {
+            if (dev->mode != RS232)
+            {
+                regs->u.write.mcr &= ~(0x02);   /* Disable Tx transceiver */
+                regs->u.write.mcr |= 0x01;      /* Enable  Rx transceiver */
+            }
+            /* deactivate Tx INT and disable Tx INT */
+            regs->u.write.ier &= ~(0x02);
+            *flush = &regs->u.write.ier;
+        }
+        work = 1;
+    }
+
+    intUnlock(key); /* Is this required? */
+    return work;
+}
+
+
+/*****************************************************************************
+ * IP520RxAdaptCheck - measure Rx traffic and adjust the Rx trigger level
+ *
+ * Counts Rx interrupts, receive timeouts and characters over a window of
+ * about 100 msec. At the end of each window the interrupt rate is saved for
+ * IP520Report(), and in adaptive mode the trigger level is moved:
+ *
+ *  - up one step when the line was at least 50% busy and no more than a
+ *    quarter of the Rx interrupts were timeouts (a sustained stream, where a
+ *    higher level means fewer interrupts);
+ *  - down one step when the line was less than 10% busy or most Rx interrupts
+ *    were timeouts (bursty traffic that rarely reaches the trigger level).
+ *
+ * Latency is bounded by the receive timeout interrupt, which fires after 4
+ * character times with data sitting below the trigger level. Without flow
+ * control the level never goes above the one IP520OptsSet() chose for the
+ * baud rate, so the overrun margin is never worse than with the fixed table.
+ * With RTS/CTS it may rise to 60, above the fixed level, since auto-RTS then
+ * holds off the sender before the FIFO overruns.
+ *
+ * The arithmetic is all integer, this runs at interrupt level.
+ *
+ */
+LOCAL void IP520RxAdaptCheck(TY_IP520_DEV *dev, epicsUInt8 isr, int n)
+{
+    int clkRate = sysClkRateGet();
+    unsigned long now = tickGet();
+    unsigned long elapsed = now - dev->rxWinStart;
+    unsigned long period = clkRate / 10;
+
+    dev->rxInts++;
+    dev->rxWinInts++;
+    dev->rxWinChars += n;
+    if ((isr & 0x3F) == 0x0C)   /* Rx timeout interrupt */
+    {
+        dev->rxTimeouts++;
+        dev->rxWinTimeouts++;
+    }
+
+    if (period < 1)
+        period = 1;
+    if (elapsed < period)
+        return;
+
+    dev->rxIntRate = dev->rxWinInts * clkRate / elapsed;
+
+    if (dev->rxAdapt)
+    {
+        unsigned long capacity, util, span = elapsed;
+        int level = dev->rxLevel;
+
+        /* Characters the line could have carried; limit to 10 secs */
+        if (span > 10UL * clkRate)
+            span = 10UL * clkRate;
+        capacity = (dev->baud / 10) * span / clkRate;
+        util = capacity ? 100UL * dev->rxWinChars / capacity : 0;
+
+        if (util >= 50 && dev->rxWinTimeouts * 4 <= dev->rxWinInts)
+        {
+            if (level < dev->rxLevelMax)
+                level++;
+        }
+        else if (util < 10 || dev->rxWinTimeouts * 2 > dev->rxWinInts)
+        {
+            if (level > 0)
+                level--;
+        }
+
+        if (level != dev->rxLevel)
+        {
+            dev->regs->u.write.fcr = 0x01 | (level << 6);   /* FIFO enabled, no reset */
+            dev->rxLevel = level;
+            dev->rxTrigger = rxTriggerLevel[level];
+            dev->rxLevelChanges++;
+        }
+    }
+
+    dev->rxWinStart = now;     /* Next window starts now, even after idling */
+    dev->rxWinChars = 0;
+    dev->rxWinInts = 0;
+    dev->rxWinTimeouts = 0;
+}
+
+
+/*****************************************************************************
+ * IP520RxPut - pass received characters up, or collect them into frames
+ *
+ * With no framing mode the characters go straight to IP520RxInsert().
+ * Otherwise they are added to the frame buffer, and each frame is given to
+ * IP520RxInsert() as soon as it is complete. In gap mode the gap timer is
+ * restarted whenever characters arrive; the frame ends when it expires.
+ * Modbus mode also uses the gap timer, and updates the frame CRC with each
+ * character. The caller ends a Modbus frame early on a receive timeout.
+ *
+ */
+LOCAL void IP520RxPut(TY_IP520_DEV *dev, char *buf, int n)
+{
+    int i;
+
+    if (dev->frameMode == IP520_FRAME_NONE)
+    {
+        IP520RxInsert(dev, buf, n);
+        return;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        char c = buf[i];
+        int end = FALSE;
+
+        if (dev->frameFill == 0)
+        {
+            dev->frameStart = epicsMonotonicGet();
+            dev->frameCrc = 0xFFFF;
+        }
+        dev->frameBuf[dev->frameFill++] = c;
+
+        switch (dev->frameMode)
+        {
+            case IP520_FRAME_TERM:
+                end = ((unsigned char) c == dev->frameArg);
+                break;
+            case IP520_FRAME_FIXED:
+                end = (dev->frameFill == dev->frameArg);
+                break;
+            case IP520_FRAME_LENGTH:
+                if (dev->frameFill == 1)
+                    dev->frameNeed = 1 + (unsigned char) c + dev->frameArg;
+                end = (dev->frameFill == dev->frameNeed);
+                break;
+            case IP520_FRAME_MODBUS:
+                dev->frameCrc = (dev->frameCrc >> 8) ^
+                    crcTable[(dev->frameCrc ^ (unsigned char) c) & 0xFF];
+                break;
+        }
+
+        if (!end && dev->frameFill == IP520_FRAME_MAX)
+        {
+            dev->frameSplits++;
+            end = TRUE;
+        }
+        if (end)
+            IP520FrameEnd(dev);
+    }
+
+    if (dev->frameMode != IP520_FRAME_TERM && dev->frameFill)
+        wdStart(dev->frameWd, dev->frameGap, (FUNCPTR) IP520FrameGap, (int) dev);
+}
+
+
+/*****************************************************************************
+ * IP520FrameEnd - pass the frame collected so far up to tyLib
+ *
+ * A Modbus frame is only passed up if it has at least 4 characters and its
+ * CRC checks out (the CRC over the data and the CRC itself comes to zero);
+ * its arrival time is then queued for IP520_MODBUS_STAMP, overwriting the
+ * oldest if the reader has not collected them. Must be called with
+ * interrupts locked.
+ *
+ */
+LOCAL void IP520FrameEnd(TY_IP520_DEV *dev)
+{
+    int good = TRUE;
+
+    if (dev->frameMode == IP520_FRAME_MODBUS)
+    {
+        if (dev->frameFill < 4)
+        {
+            dev->shortFrames++;
+            good = FALSE;
+        }
+        else if (dev->frameCrc != 0)
+        {
+            dev->crcErrors++;
+            good = FALSE;
+        }
+        else
+        {
+            int next = (dev->stampIn + 1) % IP520_STAMPS;
+
+            if (next == dev->stampOut)
+            {
+                dev->stampOut = (dev->stampOut + 1) % IP520_STAMPS;
+                dev->stampsLost++;
+            }
+            dev->stamps[dev->stampIn] = dev->frameStart;
+            dev->stampIn = next;
+        }
+    }
+
+    if (good)
+    {
+        IP520RxInsert(dev, dev->frameBuf, dev->frameFill);
+        dev->frames++;
+    }
+    dev->frameFill = 0;
+    dev->frameNeed = 0;
+}
+
+
+/*****************************************************************************
+ * IP520FrameResync - discard a partial frame
+ *
+ * Called for fixed and length framing when a receive error or an idle gap
+ * shows the frame can't be completed; the next character starts a new frame.
+ * Must be called with interrupts locked.
+ *
+ */
+LOCAL void IP520FrameResync(TY_IP520_DEV *dev)
+{
+    dev->frameResyncs++;
+    dev->frameFill = 0;
+    dev->frameNeed = 0;
+}
+
+
+/*****************************************************************************
+ * IP520RxHold - does the port need the receive timeout to find gaps?
+ *
+ * Modbus frames and unframed transaction replies end at the receive timeout;
+ * their watchdogs are only a backstop, since if the FIFO were emptied mid-frame
+ * they could expire before the next trigger level interrupt.
+ *
+ */
+LOCAL int IP520RxHold(TY_IP520_DEV *dev)
+{
+    return(dev->frameMode == IP520_FRAME_MODBUS ||
+           (dev->frameMode == IP520_FRAME_NONE && dev->xactState == IP520_XACT_READ));
+}
+
+
+/*****************************************************************************
+ * IP520CharBits - bits per character in the port's current format
+ *
+ */
+LOCAL int IP520CharBits(TY_IP520_DEV *dev)
+{
+    int bits = 2 + ((dev->opts & PARENB) ? 1 : 0) + ((dev->opts & STOPB) ? 1 : 0);
+
+    switch (dev->opts & CSIZE)
+    {
+        case CS5: bits += 5; break;
+        case CS6: bits += 6; break;
+        case CS7: bits += 7; break;
+        default:  bits += 8; break;
+    }
+    return(bits);
+}
+
+
+/*****************************************************************************
+ * IP520FrameGap - gap timer expired, the frame is complete or abandoned
+ *
+ */
+LOCAL void IP520FrameGap(TY_IP520_DEV *dev)
+{
+    int key = intLock();
+
+    if ((dev->frameMode == IP520_FRAME_GAP || dev->frameMode == IP520_FRAME_MODBUS) &&
+        dev->frameFill)
+        IP520FrameEnd(dev);
+    else if ((dev->frameMode == IP520_FRAME_FIXED || dev->frameMode == IP520_FRAME_LENGTH) &&
+             dev->frameFill)
+        IP520FrameResync(dev);
+    intUnlock(key);
+}
+
+
+/*****************************************************************************
+ * IP520RxInsert - give received characters to tyLib
+ *
+ * In raw mode all but the last character are put straight into the tty read
+ * ring, then tyIRd() is given the last one so it wakes up readers as usual.
+ * Other modes need tyIRd() to process every character. While a transaction
+ * is waiting for its reply the characters go to IP520XactRx() instead.
+ *
+ */
+LOCAL void IP520RxInsert(TY_IP520_DEV *dev, char *buf, int n)
+{
+    TY_DEV *pty = &dev->tyDev;
+    int i = 0;
+
+    if (dev->xactState == IP520_XACT_READ)
+    {
+        IP520XactRx(dev, buf, n);
+        return;
+    }
+
+    if (n > 1 && !(pty->options & OPT_TERMINAL) && !pty->rdState.flushingRdBuf)
+    {
+        i = rngBufPut(pty->rdBuf, buf, n - 1);
+        dev->rxDropped += (n - 1) - i;
+        i = n - 1;
+    }
+
+    for (; i < n; i++)
+        tyIRd(pty, buf[i]);
+}
+
+
+/*****************************************************************************
+ * IP520TxFill - copy characters from the tty write ring to the Tx FIFO
+ *
+ * Unless XON/XOFF handshaking or CR/LF translation (OPT_CRMOD) is enabled,
+ * tyLib has a line feed pending, or the write buffer is being flushed,
+ * contiguous spans of the tty write ring are written straight to THR and the
+ * ring's read offset is advanced once per span, then any writers waiting for
+ * space are woken. The last character is always taken with tyITx(), so tyLib
+ * sees the ring empty and marks the transmitter idle as usual.
+ *
+ * RETURNS: OK if max characters were written, or ERROR if the ring is empty.
+ *
+ */
+LOCAL STATUS IP520TxFill(TY_IP520_DEV *dev, int max)
+{
+    TY_DEV *pty  = &dev->tyDev;
+    REGMAP *regs = dev->regs;
+    int n = 0;
+    char outChar;
+
+    if (!(pty->options & (OPT_TANDEM | OPT_CRMOD)) && !pty->wrtState.cr &&
+        !pty->wrtState.flushingWrtBuf)
+    {
+        RING_ID ring = pty->wrtBuf;
+        int from  = ring->pFromBuf;
+        int to    = ring->pToBuf;
+        int count = to - from;
+
+        if (count < 0)
+            count += ring->bufSize;
+        if (count > max)
+            count = max;
+        count--;        /* Leave the last one for tyITx() */
+
+        while (n < count)
+        {
+            int span = ((to >= from) ? to : ring->bufSize) - from;
+            const char *pch = &ring->buf[from];
+            int i;
+
+            if (span > count - n)
+                span = count - n;
+            for (i = 0; i < span; i++)
+                regs->u.write.thr = pch[i];
+            from += span;
+            if (from == ring->bufSize)
+                from = 0;
+            n += span;
+        }
+
+        if (n > 0)
+        {
+            ring->pFromBuf = from;
+            semGive(&pty->wrtSyncSem);
+            selWakeupAll(&pty->selWakeupList, SELWRITE);
+        }
+    }
+
+    while (n < max)
+    {
+        if (tyITx(pty, &outChar) != OK)
+        {
+            dev->writeCount += n;
+            return ERROR;
+        }
+        regs->u.write.thr = outChar;
+        n++;
+    }
+
+    dev->writeCount += n;
+    return OK;
+}
+
+
+/*****************************************************************************
+ * IP520XactInit - create the transaction semaphores and timer for a port
+ *
+ */
+LOCAL STATUS IP520XactInit(TY_IP520_DEV *dev)
+{
+    if (!dev->xactLock)
+        dev->xactLock = semMCreate(SEM_Q_PRIORITY | SEM_INVERSION_SAFE);
+    if (!dev->xactSem)
+        dev->xactSem = semBCreate(SEM_Q_FIFO, SEM_EMPTY);
+    if (!dev->xactWd)
+        dev->xactWd = wdCreate();
+
+    return (dev->xactLock && dev->xactSem && dev->xactWd) ? OK : ERROR;
+}
+
+
+/*****************************************************************************
+ * IP520XactLatency - add a sample to a transaction latency statistic
+ *
+ */
+LOCAL void IP520XactLatency(IP520_LAT *lat, epicsUInt64 ns)
+{
+    lat->count++;
+    lat->sum += ns;
+    if (ns > lat->max)
+        lat->max = ns;
+}
+
+
+/*****************************************************************************
+ * IP520XactTx - transmit interrupt during a transaction
+ *
+ * Refills the Tx FIFO from the request: all of it when THRE shows the FIFO is
+ * empty, otherwise only as many as the Tx trigger level guarantees room for.
+ * Once the whole request has been loaded and the FIFO has emptied only the
+ * shift register still holds a character, so waits up to one character time
+ * for it to leave (TEMT) and turns the line around. This runs with interrupts
+ * locked, so the wait is capped at IP520_XACT_SPIN_NS, one character at 9600
+ * baud; at lower baud rates the watchdog finishes the job on the next tick.
+ *
+ */
+LOCAL void IP520XactTx(TY_IP520_DEV *dev, epicsUInt8 lsr)
+{
+    REGMAP *regs = dev->regs;
+    int room = (lsr & 0x20) ? IP520_FIFO_SIZE : 8;
+    int n = 0;
+    epicsUInt64 limit;
+
+    while (dev->xactLeft > 0 && n < room)
+    {
+        regs->u.write.thr = *dev->xactOut++;
+        dev->xactLeft--;
+        n++;
+    }
+    dev->writeCount += n;
+    if (n > 0 || !(lsr & 0x20))
+        return;
+
+    dev->xactEmpty = epicsMonotonicGet();
+    limit = dev->xactEmpty + ((dev->xactCharNs < IP520_XACT_SPIN_NS) ?
+                              dev->xactCharNs : IP520_XACT_SPIN_NS);
+    while (!(lsr & 0x40) && epicsMonotonicGet() < limit)
+        lsr = regs->u.read.lsr;
+
+    regs->u.write.ier &= ~(0x02);   /* No more Tx interrupts needed */
+    if (lsr & 0x40)
+        IP520XactTurn(dev);
+    else
+        wdStart(dev->xactWd, 1, (FUNCPTR) IP520XactWd, (int) dev);
+}
+
+
+/*****************************************************************************
+ * IP520XactTurn - request sent, switch the port to receive the reply
+ *
+ */
+LOCAL void IP520XactTurn(TY_IP520_DEV *dev)
+{
+    REGMAP *regs = dev->regs;
+
+    if (dev->mode != RS232)
+    {
+        regs->u.write.mcr &= ~(0x02);   /* Disable Tx transceiver */
+        regs->u.write.mcr |= 0x01;      /* Enable  Rx transceiver */
+    }
+    dev->xactTurn = epicsMonotonicGet();
+    dev->xactState = IP520_XACT_READ;
+    IP520XactLatency(&dev->xactLat[IP520_LAT_TURN], dev->xactTurn - dev->xactEmpty);
+}
+
+
+/*****************************************************************************
+ * IP520XactRx - add reply characters to the transaction buffer
+ *
+ * With a framing mode this is called once per complete frame, which ends the
+ * reply. Otherwise the reply ends when the buffer is full, or at a gap.
+ *
+ */
+LOCAL void IP520XactRx(TY_IP520_DEV *dev, char *buf, int n)
+{
+    int room = dev->xactMax - dev->xactGot;
+
+    if (n > room)
+        n = room;
+    memcpy(dev->xactIn + dev->xactGot, buf, n);
+    dev->xactGot += n;
+
+    if (dev->frameMode != IP520_FRAME_NONE || dev->xactGot == dev->xactMax)
+        IP520XactDone(dev);
+}
+
+
+/*****************************************************************************
+ * IP520XactDone - reply complete, wake up the caller of IP520Transact()
+ *
+ */
+LOCAL void IP520XactDone(TY_IP520_DEV *dev)
+{
+    epicsUInt64 now = epicsMonotonicGet();
+
+    wdCancel(dev->xactWd);
+    dev->xactState = IP520_XACT_IDLE;
+    IP520XactLatency(&dev->xactLat[IP520_LAT_REPLY], now - dev->xactTurn);
+    IP520XactLatency(&dev->xactLat[IP520_LAT_TOTAL], now - dev->xactStart);
+    semGive(dev->xactSem);
+}
+
+
+/*****************************************************************************
+ * IP520XactWd - transaction watchdog
+ *
+ * While sending, turns the line around once TEMT is set. While receiving an
+ * unframed reply, the line has been idle long enough to end it.
+ *
+ */
+LOCAL void IP520XactWd(TY_IP520_DEV *dev)
+{
+    int key = intLock();
+
+    if (dev->xactState == IP520_XACT_WRITE)
+    {
+        if (dev->regs->u.read.lsr & 0x40)
+            IP520XactTurn(dev);
+        else
+            wdStart(dev->xactWd, 1, (FUNCPTR) IP520XactWd, (int) dev);
+    }
+    else if (dev->xactState == IP520_XACT_READ && dev->xactGot)
+        IP520XactDone(dev);
+    intUnlock(key);
+}
+
+
+LOCAL void IsrErrMsg(epicsUInt8 lsr, TY_IP520_DEV *dev)
+{
+    int cnt;
+    char *errmsg;
+    static char overrunErrMsg[] = "      : Rx overrun ctr = xxx\n";
+    static char parityErrMsg[]  = "      : Rx parity  ctr = xxx\n";
+    static char framingErrMsg[] = "      : Rx framing ctr = xxx\n";
+
+    if (lsr & 0x02)         /* Check for Rx overrun. */
+    {
+        cnt = ++dev->overCount;
+        errmsg = overrunErrMsg;
+    }
+    else if (lsr & 0x04)    /* Check for parity error. */
+    {
+        cnt = ++dev->parityCount;
+        errmsg = parityErrMsg;
+    }
+    else if (lsr & 0x08)    /* Check for framing error. */
+    {
+        cnt = ++dev->frameCount;
+        errmsg = framingErrMsg;
+    }
+    else
+        return;
+
+    if (cnt <= 10 || isPower2(cnt))
+    {
+        int size;
+        size = strlen(dev->pmod->moduleID);
+        size = (size >= 6) ? 6 : (size - 1);
+        strncpy(errmsg, dev->pmod->moduleID, size);
+        errmsg[25] = '0' + (cnt / 100) % 10;
+        errmsg[26] = '0' + (cnt / 10) % 10;
+        errmsg[27] = '0' + cnt % 10;
+        epicsInterruptContextMessage(errmsg);
+    }
+}
+
+/******************************************************************************
+ *
+ * IP520TxStartup - transmitter startup routine
+ *
+ * LOGIC
+ *  Initialize status = OK.
+ *  Disable interrupts for processing LSR and filling the Tx FIFO.
+ *  Read line status register (LSR).
+ *  IF LSR shows Rx Overrun error.
+ *      Call IsrErrMsg().
+ *  ENDIF
+ *
+ *  IF Transmitter Hold Register is Empty (then FIFO is also empty).
+ *      Set Tx counter to 64.
+ *  ELSE
+ *      Set Tx counter to 0 and let ISR fill the Tx FIFO.
+ *  ENDIF
+ *
+ *  IF TxCtr > 0
+ *      Call IP520TxFill() to write up to TxCtr characters to the Tx FIFO.
+ *  ENDIF
+ *
+ *  IF another Tx character was NOT available (the tty ringbuffer is empty)
+ *      Disable Tx interrupts.
+ *  ELSE
+ *      Enable Tx interrupts.
+ *  ENDIF
+ *
+ *  Enable interrupts.
+ *
+ *  While an IP520Transact() is in progress nothing is done; the transaction
+ *  restarts the transmitter when it ends if the tty ring isn't empty.
+ */
+LOCAL void IP520TxStartup(TY_IP520_DEV *dev)
+{
+    REGMAP *regs = dev->regs;
+    int key, TxCtr;
+    STATUS status = OK;
+    epicsUInt8 lsr;
+
+    key = intLock();
+    if (dev->xactState != IP520_XACT_IDLE)
+    {
+        intUnlock(key);
+        return;
+    }
+    lsr = regs->u.read.lsr;
+    if (lsr & 0x0E)         /* Check for overrun, parity or framing error. */
+        IsrErrMsg(lsr, dev);
+
+    if (lsr & 0x20)
+        TxCtr = IP520_FIFO_SIZE;
+    else
+        TxCtr = 0;
+
+    if (TxCtr > 0)
+        status = IP520TxFill(dev, TxCtr);
+
+    if ((status == ERROR) && (dev->mode == RS232))
+        regs->u.write.ier &= ~(0x02);   /* Disable Tx interrupt */
+    else
+        regs->u.write.ier |= 0x02;      /*  Enable Tx interrupt */
+
+    intUnlock(key);
+}
+
+/* EFROn - Enable Enhanced Functions */
+LOCAL void EFROn(REGMAP *regs)
+{
+    epicsUInt8 llcr, lefr;
+
+    savedlcr = regs->u.read.lcr;        /* Save LCR. */
+    regs->u.write.lcr = 0xBF;           /* Expose EFR/Xon-1/Xon-2/Xoff-1/Xoff-2; hide ISR/FCR/MCR/LSR/MSR/SCR. */
+    llcr = regs->u.read.lcr;            /* Read LCR to flush posted writes. */
+    regs->u.write.fcr |= 0x10;          /* Write to EFR; enable writes to enhanced functions. */
+    lefr = regs->u.read.isr;            /* Read EFR to flush posted writes. */
+}
+
+/* EFROff - Disable Enhanced Functions */
+LOCAL void EFROff(REGMAP * regs)
+{
+    epicsUInt8 llcr, lefr;
+
+    regs->u.write.fcr &= ~(0x10);       /* Write to EFR:4; disable writes to enhanced functions.
+                                         * Expose RBR/THR/IER; hide DLL/DLM, AND,
+                                         * Expose ISR/FCR/MCR/LSR/MSR/SCR; hide EFR/Xon-1/Xon-2/Xoff-1/Xoff-2. */
+    lefr = regs->u.read.isr;            /* Read EFR to flush posted writes. */
+    regs->u.write.lcr = savedlcr;       /* Restore LCR to save value. */
+    llcr = regs->u.read.lcr;            /* Read LCR to flush posted writes. */
+}
+
+/******************************************************************************
+ *
+ * Command Registration with iocsh
+ */
+
+/* IP520Drv */
+static const iocshArg IP520DrvArg0 = {"maxModules", iocshArgInt};
+static const iocshArg * const IP520DrvArgs[1] = {&IP520DrvArg0};
+static const iocshFuncDef IP520DrvFuncDef = {"IP520Drv", 1, IP520DrvArgs};
+static void IP520DrvCallFunc(const iocshArgBuf *args)
+{
+    IP520Drv(args[0].ival);
+}
+
+/* IP520Report */
+static const iocshFuncDef IP520ReportFuncDef = {"IP520Report", 0, NULL};
+static void IP520ReportCallFunc(const iocshArgBuf *args)
+{
+    IP520Report();
+}
+
+/* IP520ModuleInit */
+static const iocshArg IP520ModuleInitArg0 = {"moduleID",  iocshArgString};
+static const iocshArg IP520ModuleInitArg1 = {"RS<nnn>",   iocshArgString};
+static const iocshArg IP520ModuleInitArg2 = {"intVector", iocshArgInt};
+static const iocshArg IP520ModuleInitArg3 = {"carrier#",  iocshArgInt};
+static const iocshArg IP520ModuleInitArg4 = {"slot",      iocshArgInt};
+
+static const iocshArg * const IP520ModuleInitArgs[5] = {&IP520ModuleInitArg0, &IP520ModuleInitArg1, &IP520ModuleInitArg2,
+                                                        &IP520ModuleInitArg3, &IP520ModuleInitArg4};
+static const iocshFuncDef IP520ModuleInitFuncDef = {"IP520ModuleInit", 5, IP520ModuleInitArgs};
+static void IP520ModuleInitCallFunc(const iocshArgBuf *args)
 {
     IP520ModuleInit(args[0].sval, args[1].sval, args[2].ival, args[3].ival, args[4].ival);
 }
@@ -1216,6 +2515,36 @@ static void IP520ConfigCallFunc(const iocshArgBuf *arg)
     IP520Config(arg[0].sval, arg[1].ival, arg[2].sval[0], arg[3].ival, arg[4].ival, arg[5].sval[0]);
 }
 
+static const iocshArg IP520RxAdaptArg0 = {"devName", iocshArgString};
+static const iocshArg IP520RxAdaptArg1 = {"enable",  iocshArgInt};
+static const iocshArg * const IP520RxAdaptArgs[2] = {&IP520RxAdaptArg0, &IP520RxAdaptArg1};
+static const iocshFuncDef IP520RxAdaptFuncDef = {"IP520RxAdapt",2,IP520RxAdaptArgs};
+static void IP520RxAdaptCallFunc(const iocshArgBuf *arg)
+{
+    IP520RxAdapt(arg[0].sval, arg[1].ival);
+}
+
+static const iocshArg IP520FrameArg0 = {"devName", iocshArgString};
+static const iocshArg IP520FrameArg1 = {"mode",    iocshArgString};
+static const iocshArg IP520FrameArg2 = {"arg",     iocshArgInt};
+static const iocshArg * const IP520FrameArgs[3] = {&IP520FrameArg0, &IP520FrameArg1, &IP520FrameArg2};
+static const iocshFuncDef IP520FrameFuncDef = {"IP520Frame",3,IP520FrameArgs};
+static void IP520FrameCallFunc(const iocshArgBuf *arg)
+{
+    IP520Frame(arg[0].sval, arg[1].sval, arg[2].ival);
+}
+
+static const iocshArg IP520PollConfigArg0 = {"moduleID",  iocshArgString};
+static const iocshArg IP520PollConfigArg1 = {"periodMs",  iocshArgInt};
+static const iocshArg IP520PollConfigArg2 = {"enterRate", iocshArgInt};
+static const iocshArg * const IP520PollConfigArgs[3] = {&IP520PollConfigArg0, &IP520PollConfigArg1,
+                                                        &IP520PollConfigArg2};
+static const iocshFuncDef IP520PollConfigFuncDef = {"IP520PollConfig",3,IP520PollConfigArgs};
+static void IP520PollConfigCallFunc(const iocshArgBuf *arg)
+{
+    IP520PollConfig(arg[0].sval, arg[1].ival, arg[2].ival);
+}
+
 static void IP520Registrar(void) {
     iocshRegister(&IP520DrvFuncDef,IP520DrvCallFunc);
     iocshRegister(&IP520ReportFuncDef,IP520ReportCallFunc);
@@ -1223,5 +2552,8 @@ static void IP520Registrar(void) {
     iocshRegister(&IP520DevCreateFuncDef,IP520DevCreateCallFunc);
     iocshRegister(&IP520DevCreateAllFuncDef, IP520DevCreateAllCallFunc);
     iocshRegister(&IP520ConfigFuncDef,IP520ConfigCallFunc);
+    iocshRegister(&IP520RxAdaptFuncDef,IP520RxAdaptCallFunc);
+    iocshRegister(&IP520FrameFuncDef,IP520FrameCallFunc);
+    iocshRegister(&IP520PollConfigFuncDef,IP520PollConfigCallFunc);
 }
 epicsExportRegistrar(IP520Registrar);
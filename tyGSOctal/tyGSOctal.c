@@ -66,8 +66,11 @@
 #include <tyLib.h>
 #include <sioLib.h>
 #include <vxLib.h>
+#include <rngLib.h>
+#include <wdLib.h>
 #include <epicsTypes.h>
 #include <epicsString.h>
+#include <epicsTime.h>
 
 #include "ip_modules.h"     /* GreenSpring IP modules */
 #include "scc2698.h"        /* SCC 2698 UART register map */
@@ -97,6 +100,10 @@ int tyGSOctalLastModule;
 
 LOCAL int tyGSOctalDrvNum;  /* driver number assigned to this driver */
 
+/* Maximum characters handled per interrupt, summed over all ports */
+int tyGSOctalIntBudget = 32;
+epicsExportAddress(int, tyGSOctalIntBudget);
+
 /*
  * forward declarations
  */
@@ -111,6 +118,52 @@ LOCAL void   tyGSOctalStartup(TY_GSOCTAL_DEV *);
 LOCAL STATUS tyGSOctalBaudSet(TY_GSOCTAL_DEV *, int);
 LOCAL void   tyGSOctalOptsSet(TY_GSOCTAL_DEV *, int);
 LOCAL void   tyGSOctalSetmr(TY_GSOCTAL_DEV *, int, int);
+LOCAL void   tyGSOctalFrameChar(TY_GSOCTAL_DEV *, char);
+LOCAL void   tyGSOctalFrameEnd(TY_GSOCTAL_DEV *);
+LOCAL void   tyGSOctalFrameGap(TY_GSOCTAL_DEV *);
+LOCAL void   tyGSOctalFrameResync(TY_GSOCTAL_DEV *);
+LOCAL void   tyGSOctalCtSet(TY_GSOCTAL_DEV *, int);
+
+/* Receive framing mode names, indexed by TYGS_FRAME_xxx */
+LOCAL const char * const tyGSOctalFrameModes[] = {
+    "none", "term", "fixed", "length", "gap", "modbus"
+};
+
+/* Modbus CRC-16 (polynomial 0xA001, reflected) lookup table */
+LOCAL const epicsUInt16 tyGSOctalCrcTable[256] = {
+    0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+    0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+    0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+    0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+    0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+    0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+    0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+    0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+    0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+    0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+    0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+    0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+    0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+    0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+    0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+    0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+    0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+    0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+    0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+    0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+    0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+    0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+    0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+    0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+    0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+    0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+    0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+    0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+    0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+    0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+    0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+    0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
+};
 
 /******************************************************************************
  *
@@ -159,6 +212,29 @@ STATUS tyGSOctalDrv
     return tyGSOctalDrvNum == ERROR ? ERROR : OK;
 }
 
+LOCAL void tyGSOctalWorkReport(QUAD_TABLE *qt)
+{
+    int bin;
+
+    if (!qt->interruptCount)
+        return;
+
+    printf("  %lu hit the budget of %d chars, chars per interrupt:\n   ",
+        qt->budgetCount, tyGSOctalIntBudget);
+    for (bin = 0; bin < TYGS_WORK_BINS; bin++) {
+        if (bin == 0)
+            printf(" 0:%lu", qt->workHist[bin]);
+        else if (bin == TYGS_WORK_BINS - 1)
+            printf(" %d+:%lu", 1 << (bin - 1), qt->workHist[bin]);
+        else if (bin == 1)
+            printf(" 1:%lu", qt->workHist[bin]);
+        else
+            printf(" %d-%d:%lu", 1 << (bin - 1), (1 << bin) - 1,
+                qt->workHist[bin]);
+    }
+    printf("\n");
+}
+
 void tyGSOctalReport(void)
 {
     int mod;
@@ -169,13 +245,27 @@ void tyGSOctalReport(void)
 
         printf("Module %d: carrier=%d slot=%d\n  %lu interrupts\n",
             mod, qt->carrier, qt->slot, qt->interruptCount);
+        tyGSOctalWorkReport(qt);
 
         for (port=0; port < 8; port++) {
             TY_GSOCTAL_DEV *dev = &qt->dev[port];
 
-            if (dev->created)
-                printf("  Port %d: %lu chars in, %lu chars out, %lu errors\n",
-                    port, dev->readCount, dev->writeCount, dev->errorCount);
+            if (!dev->created)
+                continue;
+
+            printf("  Port %d: %lu chars in, %lu chars out, %lu errors\n",
+                port, dev->readCount, dev->writeCount, dev->errorCount);
+            if (dev->frameMode != TYGS_FRAME_NONE)
+                printf("  Port %d: framing %s %d, %lu frames, %lu split, "
+                    "%lu resyncs, %lu chars dropped, %d chars pending\n",
+                    port, tyGSOctalFrameModes[dev->frameMode], dev->frameArg,
+                    dev->frames, dev->frameSplits, dev->frameResyncs,
+                    dev->frameDropped, dev->frameFill);
+            if (dev->frameMode == TYGS_FRAME_MODBUS)
+                printf("  Port %d: Modbus %lu CRC errors, %lu short frames, "
+                    "%lu timestamps lost, gap timed by %s\n", port,
+                    dev->crcErrors, dev->shortFrames, dev->stampsLost,
+                    qt->ctDev[dev->block] == dev ? "counter/timer" : "watchdog");
         }
     }
 }
@@ -549,8 +639,8 @@ LOCAL void tyGSOctalInitChannel
 
     dev->irqEnable = ((port%2 == 0) ? SCC_ISR_TXRDY_A : SCC_ISR_TXRDY_B);
 
-    /* choose set 2 BRG */
-    dev->regs->u.w.acr = 0x80;
+    /* choose set 2 BRG, keep the C/T mode if a Modbus port is using it */
+    dev->regs->u.w.acr = qt->ctDev[block] ? 0xb0 : 0x80;
 
     dev->chan->u.w.cr = 0x1a; /* disable trans/recv, reset pointer */
     dev->chan->u.w.cr = 0x20; /* reset recv */
@@ -789,6 +879,18 @@ LOCAL STATUS tyGSOctalIoctl
     case SIO_HW_OPTS_GET:
         *(int *)arg = dev->opts;
         break;
+    case TYGS_MODBUS_STAMP:
+        key = intLock ();
+        if (dev->stampOut == dev->stampIn) {
+            errnoSet(EAGAIN);
+            status = ERROR;
+        }
+        else {
+            *(epicsUInt64 *)arg = dev->stamps[dev->stampOut];
+            dev->stampOut = (dev->stampOut + 1) % TYGS_STAMPS;
+        }
+        intUnlock (key);
+        break;
     default:
         status = tyIoctl (&dev->tyDev, request, arg);
         break;
@@ -855,9 +957,191 @@ STATUS tyGSOctalConfig (
     return OK;
 }
 
+/******************************************************************************
+ *
+ * tyGSOctalFrame - set the receive framing mode of a port
+ *
+ * In a framing mode the interrupt routine collects received characters until
+ * a complete frame has arrived, then passes the whole frame to tyLib at once,
+ * so a reading task is only woken when there is a full frame to read.  The
+ * modes and the meaning of arg are:
+ *
+ *  "none"   - characters are passed up as they arrive (the default)
+ *  "term"   - a frame ends with the character whose code is arg
+ *  "fixed"  - every frame is arg characters long
+ *  "length" - the first character of a frame gives the number of characters
+ *             that follow it, plus arg trailer characters (e.g. a checksum)
+ *  "gap"    - a frame ends when nothing has been received for arg msec
+ *  "modbus" - Modbus RTU: a frame ends after 3.5 character times of silence
+ *             (1.75 msec above 19200 baud), and only frames with a good
+ *             CRC-16 are passed up.  The arrival time of each frame can be
+ *             read with the TYGS_MODBUS_STAMP ioctl.  arg is ignored.  Set
+ *             the baud rate and character format before selecting this mode.
+ *
+ * The first Modbus port in each pair (block) of ports times the silence with
+ * that block's counter/timer, counting the 3.6864MHz crystal divided by 16.
+ * If the other port of the pair also selects Modbus it uses a watchdog
+ * timer instead, which has system clock tick resolution.
+ *
+ * A partial fixed or length frame is discarded after a receive error, or
+ * when nothing more arrives for TYGS_FRAME_RESYNC_MS (100) msec, so the next
+ * character starts a new frame.
+ *
+ * Frames longer than TYGS_FRAME_MAX characters are passed up in pieces.
+ * Any partial frame is passed up when the mode is changed.
+ *
+ * RETURNS: OK, or ERROR if the device is not found or the mode is invalid.
+ */
+STATUS tyGSOctalFrame (
+    char *name,
+    char *mode,
+    int arg
+) {
+    TY_GSOCTAL_DEV *dev = (TY_GSOCTAL_DEV *) iosDevFind(name, NULL);
+    int fmode, gap = 0, count = 0;
+    int bits, key;
+
+    if (!dev || strcmp(dev->tyDev.devHdr.name, name)) {
+        printf("%s: Device %s not found\n", fn_nm, name);
+        return ERROR;
+    }
+
+    for (fmode = TYGS_FRAME_NONE; fmode <= TYGS_FRAME_MODBUS; fmode++) {
+        if (mode && strcmp(mode, tyGSOctalFrameModes[fmode]) == 0)
+            break;
+    }
+
+    /* Bits per character */
+    bits = 2 + ((dev->opts & PARENB) ? 1 : 0) + ((dev->opts & STOPB) ? 1 : 0);
+    switch (dev->opts & CSIZE) {
+    case CS5: bits += 5; break;
+    case CS6: bits += 6; break;
+    case CS7: bits += 7; break;
+    default:  bits += 8; break;
+    }
+
+    switch (fmode) {
+    case TYGS_FRAME_NONE:
+        break;
+    case TYGS_FRAME_TERM:
+        if (arg < 0 || arg > 255)
+            fmode = -1;
+        break;
+    case TYGS_FRAME_FIXED:
+        if (arg < 1 || arg > TYGS_FRAME_MAX)
+            fmode = -1;
+        /* resync after TYGS_FRAME_RESYNC_MS idle */
+        gap = (TYGS_FRAME_RESYNC_MS * sysClkRateGet() + 999) / 1000 + 1;
+        break;
+    case TYGS_FRAME_LENGTH:
+        if (arg < 0 || arg > TYGS_FRAME_MAX - 256)
+            fmode = -1;
+        gap = (TYGS_FRAME_RESYNC_MS * sysClkRateGet() + 999) / 1000 + 1;
+        break;
+    case TYGS_FRAME_GAP:
+        if (arg < 1)
+            fmode = -1;
+        else
+            gap = (arg * sysClkRateGet() + 999) / 1000 + 1;
+        break;
+    case TYGS_FRAME_MODBUS: {
+        int usec;
+
+        if (dev->baud > 19200) {
+            usec = 1750;
+            count = 403;                /* 230400 Hz * 1.75 msec */
+        }
+        else {
+            usec = 3500000 / dev->baud * bits;
+            count = 806400 * bits / dev->baud;  /* 230400 Hz * 3.5 chars */
+        }
+        gap = (usec * sysClkRateGet() + 999999) / 1000000 + 1;
+        break;
+    }
+    default:
+        fmode = -1;
+    }
+
+    if (fmode < 0) {
+        printf("%s: Bad framing mode \"%s\" %d for %s\n", fn_nm,
+            mode ? mode : "", arg, name);
+        errnoSet(EINVAL);
+        return ERROR;
+    }
+
+    if (fmode != TYGS_FRAME_NONE && fmode != TYGS_FRAME_TERM &&
+        !dev->frameWd) {
+        dev->frameWd = wdCreate();
+        if (!dev->frameWd)
+            return ERROR;
+    }
+
+    key = intLock();
+    if (dev->frameWd)
+        wdCancel(dev->frameWd);
+    if (dev->frameFill)
+        tyGSOctalFrameEnd(dev);
+    dev->frameMode = fmode;
+    dev->frameArg = arg;
+    dev->frameGap = gap;
+    dev->frameNeed = 0;
+    dev->frameCrc = 0xffff;
+    dev->frameCount = count;
+    dev->stampIn = dev->stampOut = 0;
+    tyGSOctalCtSet(dev, fmode == TYGS_FRAME_MODBUS);
+    intUnlock(key);
+    return OK;
+}
+
+/*****************************************************************************
+ * tyGSOctalCtSet - claim or release the block's counter/timer for Modbus
+ *
+ * The C/T runs in counter mode from X1/CLK / 16, preset to the Modbus gap,
+ * and is restarted whenever characters arrive.  Reaching terminal count
+ * raises the block's counter ready interrupt.  Call with interrupts locked.
+ *
+ * NOMANUAL
+ */
+LOCAL void tyGSOctalCtSet
+    (
+    TY_GSOCTAL_DEV *dev,
+    int modbus
+    )
+{
+    QUAD_TABLE *qt = dev->qt;
+    SCC2698 *regs = dev->regs;
+    int block = dev->block;
+    epicsUInt8 dummy;
+
+    if (modbus && (!qt->ctDev[block] || qt->ctDev[block] == dev)) {
+        qt->ctDev[block] = dev;
+        regs->u.w.ctu = dev->frameCount >> 8;
+        regs->u.w.ctl = dev->frameCount & 0xff;
+        regs->u.w.acr = 0xb0;           /* BRG set 2, counter X1/CLK / 16 */
+        qt->imr[block] |= SCC_ISR_CTRRDY;
+    }
+    else if (!modbus && qt->ctDev[block] == dev) {
+        qt->ctDev[block] = NULL;
+        dummy = regs->u.r.cts;          /* stop counter, clear CTRRDY */
+        regs->u.w.acr = 0x80;
+        qt->imr[block] &= ~SCC_ISR_CTRRDY;
+    }
+    else
+        return;
+
+    regs->u.w.imr = qt->imr[block];
+    dummy = regs->u.r.isr;              /* flush */
+}
+
 /*****************************************************************************
  * tyGSOctalInt - interrupt level processing
  *
+ * Each pass visits all the ports on the module, draining the receiver and
+ * refilling the transmitter of any that need it.  Passes are repeated until
+ * one finds nothing to do or tyGSOctalIntBudget characters have been handled
+ * in this interrupt.  The port each pass starts with rotates on every
+ * interrupt so no port is always served last when the budget runs out.
+ *
  * NOMANUAL
  */
 void tyGSOctalInt
@@ -869,84 +1153,273 @@ void tyGSOctalInt
     QUAD_TABLE *qt = &tyGSOctalModules[mod];
     SCC2698 *regs;
     volatile epicsUInt8 *flush = NULL;
+    int budget = tyGSOctalIntBudget > 0 ? tyGSOctalIntBudget : 1;
+    int work = 0;
+    int busy;
     int scan;
+    int bin;
 
     qt->interruptCount++;
 
+    do {
+        busy = 0;
 
-    /*
-     * Check each port for work, stop when we find some.
-     * Next time we're called for this module, continue
-     * scanning with the next port (enforce fairness).
-     */
-    for (scan = 1; scan <= 8; scan++) {
-        int port = (qt->scan + scan) & 7;
-        TY_GSOCTAL_DEV *dev = &qt->dev[port];
-        SCC2698_CHAN *chan;
-        int block;
-        int key;
+        for (scan = 1; scan <= 8 && work < budget; scan++) {
+            int port = (qt->scan + scan) & 7;
+            TY_GSOCTAL_DEV *dev = &qt->dev[port];
+            SCC2698_CHAN *chan;
+            epicsUInt8 err;
+            int block;
+            int key;
+
+            if (!dev->created)
+                continue;
+
+            block = dev->block;
+            chan = dev->chan;
+            regs = dev->regs;
+
+            key = intLock();
+            sr = chan->u.r.sr;
+            err = sr & 0xf0;
+
+            /* Only examine the active interrupts */
+            isr = regs->u.r.isr & qt->imr[block];
+
+            /* Counter/timer reached terminal count, the Modbus frame is over */
+            if ((isr & SCC_ISR_CTRRDY) && qt->ctDev[block] == dev) {
+                (void) regs->u.r.cts;           /* stop counter, clear CTRRDY */
+                if (dev->frameFill)
+                    tyGSOctalFrameEnd(dev);
+                busy = 1;
+            }
 
-        if (!dev->created)
-            continue;
+            /* Channel B interrupt data is on the upper nibble */
+            if ((port % 2) == 1)
+                isr >>= 4;
+
+            if (isr & 0x02) /* bytes need to be read */
+            {
+                do {
+                    char inChar = chan->u.r.rhr;
+
+                    if (dev->frameMode != TYGS_FRAME_NONE)
+                        tyGSOctalFrameChar(dev, inChar);
+                    else
+                        tyIRd(&dev->tyDev, inChar);
+                    dev->readCount++;
+                    work++;
+                    sr = chan->u.r.sr;
+                    err |= sr & 0xf0;
+                } while ((sr & 0x01) && work < budget);     /* RxRDY */
+                busy = 1;
+
+                if (dev->frameMode == TYGS_FRAME_MODBUS &&
+                    qt->ctDev[block] == dev)
+                    (void) regs->u.r.ctg;       /* restart counter */
+                else if (dev->frameMode != TYGS_FRAME_NONE &&
+                         dev->frameMode != TYGS_FRAME_TERM &&
+                         dev->frameFill)
+                    wdStart(dev->frameWd, dev->frameGap,
+                        (FUNCPTR) tyGSOctalFrameGap, (int) dev);
+
+                /* fixed and length framing resync after an error */
+                if ((dev->frameMode == TYGS_FRAME_FIXED ||
+                     dev->frameMode == TYGS_FRAME_LENGTH) &&
+                    dev->frameFill && err)
+                    tyGSOctalFrameResync(dev);
+            }
 
-        block = dev->block;
-        chan = dev->chan;
-        regs = dev->regs;
+            if (isr & 0x01) /* bytes need to be sent */
+            {
+                char outChar;
+
+                do {
+                    if (tyITx(&dev->tyDev, &outChar) != OK) {
+                        /* deactivate Tx INT and disable Tx INT */
+                        qt->imr[block] &= ~dev->irqEnable;
+                        regs->u.w.imr = qt->imr[block];
+                        flush = &regs->u.w.imr;
+                        break;
+                    }
+                    chan->u.w.thr = outChar;
+                    dev->writeCount++;
+                    work++;
+                    busy = 1;
+                    chan->u.w.cr = 0;   /* Null command */
+                    flush = &chan->u.w.cr;
+                } while ((chan->u.r.sr & 0x04) && work < budget); /* TxRDY */
+            }
 
-        key = intLock();
-        sr = chan->u.r.sr;
+            /* Reset errors */
+            if (err) {
+                dev->errorCount++;
+                chan->u.w.cr = 0x40;
+                flush = &chan->u.w.cr;
+            }
 
-        /* Only examine the active interrupts */
-        isr = regs->u.r.isr & qt->imr[block];
+            intUnlock(key);
+        }
+    } while (busy && work < budget);
 
-        /* Channel B interrupt data is on the upper nibble */
-        if ((port % 2) == 1)
-            isr >>= 4;
+    if (work >= budget)
+        qt->budgetCount++;
 
-        if (isr & 0x02) /* a byte needs to be read */
-        {
-            char inChar = chan->u.r.rhr;
+    /* Start with the next port next time */
+    qt->scan = (qt->scan + 1) & 7;
 
-            tyIRd(&dev->tyDev, inChar);
-            dev->readCount++;
-        }
+    for (bin = 0; bin < TYGS_WORK_BINS - 1 && work > 0; bin++)
+        work >>= 1;
+    qt->workHist[bin]++;
 
-        if (isr & 0x01) /* a byte needs to be sent */
-        {
-            char outChar;
+    if (flush)
+        isr = *flush;    /* Flush last write cycle */
+}
 
-            if (tyITx(&dev->tyDev, &outChar) == OK) {
-                chan->u.w.thr = outChar;
-                dev->writeCount++;
-                chan->u.w.cr = 0;   /* Null command */
-                flush = &chan->u.w.cr;
-            }
-            else {
-                /* deactivate Tx INT and disable Tx INT */
-                qt->imr[block] &= ~dev->irqEnable;
-                regs->u.w.imr = qt->imr[block];
-                flush = &regs->u.w.imr;
-            }
-        }
+/*****************************************************************************
+ * tyGSOctalFrameChar - add a received character to the current frame
+ *
+ * Passes the frame up as soon as it is complete, or when the frame buffer
+ * is full.
+ *
+ * NOMANUAL
+ */
+LOCAL void tyGSOctalFrameChar
+    (
+    TY_GSOCTAL_DEV *dev,
+    char inChar
+    )
+{
+    int end = FALSE;
 
-        /* Reset errors */
-        if (sr & 0xf0) {
-            dev->errorCount++;
-            chan->u.w.cr = 0x40;
-            flush = &chan->u.w.cr;
-        }
+    if (dev->frameFill == 0) {
+        dev->frameStart = epicsMonotonicGet();
+        dev->frameCrc = 0xffff;
+    }
+    dev->frameBuf[dev->frameFill++] = inChar;
 
-        intUnlock(key);
+    switch (dev->frameMode) {
+    case TYGS_FRAME_TERM:
+        end = ((unsigned char) inChar == dev->frameArg);
+        break;
+    case TYGS_FRAME_FIXED:
+        end = (dev->frameFill == dev->frameArg);
+        break;
+    case TYGS_FRAME_LENGTH:
+        if (dev->frameFill == 1)
+            dev->frameNeed = 1 + (unsigned char) inChar + dev->frameArg;
+        end = (dev->frameFill == dev->frameNeed);
+        break;
+    case TYGS_FRAME_MODBUS:
+        dev->frameCrc = (dev->frameCrc >> 8) ^
+            tyGSOctalCrcTable[(dev->frameCrc ^ (unsigned char) inChar) & 0xff];
+        break;
+    }
 
-        /* Exit after processing one channel */
-        if ((isr & 0x03) || (sr & 0xf0)) {
-            qt->scan = port;
-            break;
+    if (!end && dev->frameFill == TYGS_FRAME_MAX) {
+        dev->frameSplits++;
+        end = TRUE;
+    }
+    if (end)
+        tyGSOctalFrameEnd(dev);
+}
+
+/*****************************************************************************
+ * tyGSOctalFrameEnd - pass the frame collected so far up to tyLib
+ *
+ * In raw mode all but the last character go straight into the tty read
+ * ring, and tyIRd() is given the last one so readers are woken once for the
+ * whole frame.  Other modes need tyIRd() to see every character.  A Modbus
+ * frame is dropped unless it has at least 4 characters and its CRC checks
+ * out; its arrival time is queued for TYGS_MODBUS_STAMP, overwriting the
+ * oldest if the reader has not collected them.  Must be called with
+ * interrupts locked.
+ *
+ * NOMANUAL
+ */
+LOCAL void tyGSOctalFrameEnd
+    (
+    TY_GSOCTAL_DEV *dev
+    )
+{
+    TY_DEV *pty = &dev->tyDev;
+    int n = dev->frameFill;
+    int i = 0;
+
+    if (dev->frameMode == TYGS_FRAME_MODBUS) {
+        if (n < 4) {
+            dev->shortFrames++;
+            n = 0;
+        }
+        else if (dev->frameCrc != 0) {
+            dev->crcErrors++;
+            n = 0;
+        }
+        else {
+            int next = (dev->stampIn + 1) % TYGS_STAMPS;
+
+            if (next == dev->stampOut) {
+                dev->stampOut = (dev->stampOut + 1) % TYGS_STAMPS;
+                dev->stampsLost++;
+            }
+            dev->stamps[dev->stampIn] = dev->frameStart;
+            dev->stampIn = next;
         }
     }
 
-    if (flush)
-        isr = *flush;    /* Flush last write cycle */
+    if (n > 1 && !(pty->options & OPT_TERMINAL) &&
+        !pty->rdState.flushingRdBuf) {
+        i = rngBufPut(pty->rdBuf, dev->frameBuf, n - 1);
+        dev->frameDropped += (n - 1) - i;
+        i = n - 1;
+    }
+    for (; i < n; i++)
+        tyIRd(pty, dev->frameBuf[i]);
+
+    if (n)
+        dev->frames++;
+    dev->frameFill = 0;
+    dev->frameNeed = 0;
+}
+
+/*****************************************************************************
+ * tyGSOctalFrameGap - gap timer expired, the frame is complete or abandoned
+ *
+ * NOMANUAL
+ */
+LOCAL void tyGSOctalFrameGap
+    (
+    TY_GSOCTAL_DEV *dev
+    )
+{
+    int key = intLock();
+
+    if ((dev->frameMode == TYGS_FRAME_GAP ||
+         dev->frameMode == TYGS_FRAME_MODBUS) && dev->frameFill)
+        tyGSOctalFrameEnd(dev);
+    else if ((dev->frameMode == TYGS_FRAME_FIXED ||
+              dev->frameMode == TYGS_FRAME_LENGTH) && dev->frameFill)
+        tyGSOctalFrameResync(dev);
+    intUnlock(key);
+}
+
+/*****************************************************************************
+ * tyGSOctalFrameResync - discard a partial frame
+ *
+ * Used by fixed and length framing when a receive error or an idle gap
+ * shows the frame can't be completed, so the next character starts a new
+ * frame.  Call with interrupts locked.
+ *
+ * NOMANUAL
+ */
+LOCAL void tyGSOctalFrameResync
+    (
+    TY_GSOCTAL_DEV *dev
+    )
+{
+    dev->frameResyncs++;
+    dev->frameFill = 0;
+    dev->frameNeed = 0;
 }
 
 /******************************************************************************
@@ -1076,6 +1549,19 @@ static void tyGSOctalConfigCallFunc(const iocshArgBuf *arg)
         arg[3].ival, arg[4].ival, arg[5].sval[0]);
 }
 
+/* tyGSOctalFrame */
+static const iocshArg tyGSOctalFrameArg0 = {"devName",iocshArgString};
+static const iocshArg tyGSOctalFrameArg1 = {"mode", iocshArgString};
+static const iocshArg tyGSOctalFrameArg2 = {"arg", iocshArgInt};
+static const iocshArg * const tyGSOctalFrameArgs[3] = {
+    &tyGSOctalFrameArg0, &tyGSOctalFrameArg1, &tyGSOctalFrameArg2};
+static const iocshFuncDef tyGSOctalFrameFuncDef =
+    {"tyGSOctalFrame",3,tyGSOctalFrameArgs};
+static void tyGSOctalFrameCallFunc(const iocshArgBuf *arg)
+{
+    tyGSOctalFrame(arg[0].sval, arg[1].sval, arg[2].ival);
+}
+
 static void tyGSOctalRegistrar(void) {
     iocshRegister(&tyGSOctalDrvFuncDef,tyGSOctalDrvCallFunc);
     iocshRegister(&tyGSOctalReportFuncDef,tyGSOctalReportCallFunc);
@@ -1083,5 +1569,6 @@ static void tyGSOctalRegistrar(void) {
     iocshRegister(&tyGSOctalDevCreateFuncDef,tyGSOctalDevCreateCallFunc);
     iocshRegister(&tyGSOctalDevCreateAllFuncDef, tyGSOctalDevCreateAllCallFunc);
     iocshRegister(&tyGSOctalConfigFuncDef,tyGSOctalConfigCallFunc);
+    iocshRegister(&tyGSOctalFrameFuncDef,tyGSOctalFrameCallFunc);
 }
 epicsExportRegistrar(tyGSOctalRegistrar);
@@ -23,6 +23,26 @@
 
 typedef enum { RS485,RS232 } RSmode;
 
+/* Received characters are passed up from the ISR in batches of up to */
+#define TYGS_RX_STAGE 16
+
+/* Receive framing modes (vxWorks only), see tyGSOctalFrame() */
+#define TYGS_FRAME_NONE     0   /* pass characters up as they arrive */
+#define TYGS_FRAME_TERM     1   /* frame ends with a terminator */
+#define TYGS_FRAME_FIXED    2   /* frames are a fixed length */
+#define TYGS_FRAME_LENGTH   3   /* first character gives the length */
+#define TYGS_FRAME_GAP      4   /* frame ends after an idle gap */
+#define TYGS_FRAME_MODBUS   5   /* Modbus RTU, 3.5 char gap and CRC-16 */
+
+#define TYGS_FRAME_MAX    512   /* longer frames are split */
+#define TYGS_STAMPS        16   /* Modbus frame timestamps kept */
+#define TYGS_FRAME_RESYNC_MS 100  /* idle time that abandons a fixed/length frame */
+
+/* ioctl() request in Modbus RTU framing mode: fetch the arrival time of the
+ * oldest frame not yet asked about, as an epicsUInt64 from epicsMonotonicGet()
+ */
+#define TYGS_MODBUS_STAMP  0x2698
+
 typedef struct ty_gsoctal_dev {
     TY_DEV          tyDev;
     SCC2698*        regs;
@@ -38,8 +58,37 @@ typedef struct ty_gsoctal_dev {
     unsigned long   readCount;
     unsigned long   writeCount;
     unsigned long   errorCount;
+    unsigned long   rxBatches;          /* termios enqueue calls */
+    unsigned long   txBatches;          /* termios dequeue calls */
+    int             txCount;            /* chars given to the UART */
+    int             rxStaged;           /* chars in rxStage */
+    char            rxStage[TYGS_RX_STAGE];
+    int             frameMode;          /* TYGS_FRAME_xxx */
+    int             frameArg;           /* terminator, length or trailer */
+    int             frameGap;           /* idle gap in ticks */
+#ifdef vxWorks
+    WDOG_ID         frameWd;            /* gap timer */
+#endif
+    int             frameFill;          /* chars in frameBuf */
+    int             frameNeed;          /* length of this frame, if known */
+    unsigned long   frames;             /* frames passed up */
+    unsigned long   frameSplits;        /* frames split at TYGS_FRAME_MAX */
+    unsigned long   frameResyncs;       /* partial frames discarded */
+    unsigned long   frameDropped;       /* frame chars lost, rdBuf full */
+    char            frameBuf[TYGS_FRAME_MAX];
+    epicsUInt16     frameCrc;           /* Modbus CRC so far */
+    epicsUInt16     frameCount;         /* counter/timer preset for gap */
+    epicsUInt64     frameStart;         /* arrival time of this frame */
+    unsigned long   crcErrors;          /* Modbus frames with a bad CRC */
+    unsigned long   shortFrames;        /* Modbus frames under 4 chars */
+    unsigned long   stampsLost;         /* timestamps overwritten unread */
+    int             stampIn, stampOut;
+    epicsUInt64     stamps[TYGS_STAMPS];
 } TY_GSOCTAL_DEV;
 
+/* Histogram of characters handled per interrupt: 0, 1, 2-3, 4-7 ... 64+ */
+#define TYGS_WORK_BINS 8
+
 typedef struct quadTable {
     const char    *moduleID;
     TY_GSOCTAL_DEV dev[8];              /* one per port */
@@ -48,8 +97,11 @@ typedef struct quadTable {
     epicsUInt16    slot;
     epicsUInt16    scan;
     epicsUInt8     imr[4];              /* one per block */
+    TY_GSOCTAL_DEV *ctDev[4];           /* Modbus port using block's C/T */
     int 
     unsigned long  interruptCount;
+    unsigned long  budgetCount;         /* interrupts that hit the budget */
+    unsigned long  workHist[TYGS_WORK_BINS];
 } QUAD_TABLE;
 
 int tyGSOctalDrv(int);
@@ -57,4 +109,6 @@ int tyGSOctalModuleInit(const char *, const char *, int, int, int);
 const char *tyGSOctalDevCreate(char *, const char *, int, int, int);
 void tyGSOctalReport(void);
 
+extern int tyGSOctalIntBudget;
+
 #endif
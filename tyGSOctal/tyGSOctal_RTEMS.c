@@ -46,8 +46,32 @@ static int tyGSOctalMaxModules;
 static int tyGSOctalLastModule;
 rtems_device_major_number tyGsOctalMajor;
 
+/* Maximum characters handled per interrupt, summed over all ports */
+int tyGSOctalIntBudget = 32;
+epicsExportAddress(int, tyGSOctalIntBudget);
+
+/*
+ * Hand the staged received characters to termios in one call
+ */
+static void
+tyGSOctalRxFlush(TY_GSOCTAL_DEV *dev)
+{
+    if (dev->tyDev) {
+        rtems_termios_enqueue_raw_characters(dev->tyDev,
+            dev->rxStage, dev->rxStaged);
+        dev->rxBatches++;
+    }
+    dev->rxStaged = 0;
+}
+
 /*
  * Interrupt handler
+ *
+ * Each pass visits all the ports on the module, draining the receiver and
+ * refilling the transmitter of any that need it, until a pass finds nothing
+ * to do or the budget is used up.  The starting port rotates every time.
+ * Received characters are staged per port and passed to termios when the
+ * stage fills up or at the end of the interrupt.
  */
 static void
 tyGSOctalInt(int mod)
@@ -56,80 +80,115 @@ tyGSOctalInt(int mod)
     QUAD_TABLE *qt = &tyGSOctalModules[mod];
     SCC2698 *regs;
     volatile epicsUInt8 *flush = NULL;
+    int budget = tyGSOctalIntBudget > 0 ? tyGSOctalIntBudget : 1;
+    int work = 0;
+    int busy;
     int scan;
+    int bin;
 
     qt->interruptCount++;
 
-    /*
-     * Check each port for work, stop when we find some.
-     * Next time we're called for this module, continue
-     * scanning with the next port (enforce fairness).
-     */
-    for (scan = 1; scan <= 8; scan++) {
-        int port = (qt->scan + scan) & 7;
-        TY_GSOCTAL_DEV *dev = &qt->dev[port];
-        SCC2698_CHAN *chan;
-        int block;
-        int key;
-
-        if (!dev->created)
-            continue;
-
-        block = dev->block;
-        chan = dev->chan;
-        regs = dev->regs;
-
-        key = epicsInterruptLock();
-        sr = chan->u.r.sr;
-
-        /* Only examine the active interrupts */
-        isr = regs->u.r.isr & qt->imr[block];
-
-        /* Channel B interrupt status is in the upper nibble */
-        if ((port % 2) == 1)
-            isr >>= 4;
-
-        /*
-         * If receiver is ready, read the character and push it up
-         */
-        if (isr & 0x02) {
-            char inChar = chan->u.r.rhr;
-
-            dev->readCount++;
-            flush = NULL;
-            if (dev->tyDev)
-                rtems_termios_enqueue_raw_characters(dev->tyDev, &inChar, 1);
-        }
+    do {
+        busy = 0;
 
-        /*
-         * If transmiter is ready tell termios that character has been sent.
-         */
-        if (isr & 0x1) {
-            qt->imr[block] &= ~dev->irqEnable; /* deactivate Tx interrupt */
-            regs->u.w.imr = qt->imr[block];       /* disable Tx interrupt */
-            flush = &regs->u.w.imr;
-            dev->writeCount++;
-            if (dev->tyDev)
-                rtems_termios_dequeue_characters(dev->tyDev, 1);
-        }
+        for (scan = 1; scan <= 8 && work < budget; scan++) {
+            int port = (qt->scan + scan) & 7;
+            TY_GSOCTAL_DEV *dev = &qt->dev[port];
+            SCC2698_CHAN *chan;
+            epicsUInt8 err;
+            int block;
+            int key;
+
+            if (!dev->created)
+                continue;
+
+            block = dev->block;
+            chan = dev->chan;
+            regs = dev->regs;
+
+            key = epicsInterruptLock();
+            sr = chan->u.r.sr;
+            err = sr & 0xf0;
+
+            /* Only examine the active interrupts */
+            isr = regs->u.r.isr & qt->imr[block];
+
+            /* Channel B interrupt status is in the upper nibble */
+            if ((port % 2) == 1)
+                isr >>= 4;
+
+            /*
+             * While the receiver is ready, read characters and push them up
+             */
+            if (isr & 0x02) {
+                do {
+                    dev->rxStage[dev->rxStaged++] = chan->u.r.rhr;
+                    if (dev->rxStaged == TYGS_RX_STAGE)
+                        tyGSOctalRxFlush(dev);
+
+                    dev->readCount++;
+                    work++;
+                    flush = NULL;
+                    sr = chan->u.r.sr;
+                    err |= sr & 0xf0;
+                } while ((sr & 0x01) && work < budget);     /* RxRDY */
+                busy = 1;
+            }
 
-        /*
-         * Reset errors
-         */
-        if (sr & 0xf0) {
-            dev->errorCount++;
-            chan->u.w.cr = 0x40;
-            flush = &chan->u.w.cr;
-        }
+            /*
+             * If transmiter is ready tell termios how many characters were
+             * sent.  If that gave us more which the transmitter has already
+             * accepted, carry on.
+             */
+            if (isr & 0x1) {
+                do {
+                    int sent = dev->txCount;
+
+                    qt->imr[block] &= ~dev->irqEnable; /* deactivate Tx int */
+                    regs->u.w.imr = qt->imr[block];    /* disable Tx int */
+                    flush = &regs->u.w.imr;
+                    dev->txCount = 0;
+                    dev->writeCount += sent;
+                    work += sent ? sent : 1;
+                    if (dev->tyDev && sent) {
+                        dev->txBatches++;
+                        rtems_termios_dequeue_characters(dev->tyDev, sent);
+                    }
+                } while ((qt->imr[block] & dev->irqEnable) &&
+                         (chan->u.r.sr & 0x04) && work < budget); /* TxRDY */
+                busy = 1;
+            }
 
-        epicsInterruptUnlock(key);
+            /*
+             * Reset errors
+             */
+            if (err) {
+                dev->errorCount++;
+                chan->u.w.cr = 0x40;
+                flush = &chan->u.w.cr;
+            }
 
-        /* Exit after processing one channel */
-        if ((isr & 0x03) || (sr & 0xf0)) {
-            qt->scan = port;
-            break;
+            epicsInterruptUnlock(key);
         }
+    } while (busy && work < budget);
+
+    for (scan = 0; scan < 8; scan++) {
+        TY_GSOCTAL_DEV *dev = &qt->dev[scan];
+
+        if (dev->rxStaged)
+            tyGSOctalRxFlush(dev);
     }
+
+    if (work >= budget)
+        qt->budgetCount++;
+
+    /* Start with the next port next time */
+    qt->scan = (qt->scan + 1) & 7;
+
+    for (bin = 0; bin < TYGS_WORK_BINS - 1 && work > 0; bin++)
+        work >>= 1;
+    qt->workHist[bin]++;
+
     if (flush)
         isr = *flush;    /* Flush last write cycle */
 }
@@ -167,9 +226,20 @@ tyGsOctalCallbackWrite(int minor, const char *buf, size_t len)
     SCC2698 *regs = dev->regs;
     int block = dev->block;
     int key;
+    int n;
 
+    if (len == 0)
+        return 0;
+
+    /*
+     * Give the UART as many characters as it will take; the Tx interrupt
+     * tells termios how many went.
+     */
     key = epicsInterruptLock();
-    chan->u.w.thr = *buf;
+    chan->u.w.thr = buf[0];
+    for (n = 1; n < len && (chan->u.r.sr & 0x04); n++)  /* TxRDY */
+        chan->u.w.thr = buf[n];
+    dev->txCount = n;
     qt->imr[block] |= dev->irqEnable;  /* activate Tx interrupt */
     regs->u.w.imr = qt->imr[block];             /* enable Tx interrupt */
     epicsInterruptUnlock(key);
@@ -352,6 +422,30 @@ tyGSOctalDrv(int maxModules)
     return 0;
 }
 
+static void
+tyGSOctalWorkReport(QUAD_TABLE *qt)
+{
+    int bin;
+
+    if (!qt->interruptCount)
+        return;
+
+    printf("  %lu hit the budget of %d chars, chars per interrupt:\n   ",
+        qt->budgetCount, tyGSOctalIntBudget);
+    for (bin = 0; bin < TYGS_WORK_BINS; bin++) {
+        if (bin == 0)
+            printf(" 0:%lu", qt->workHist[bin]);
+        else if (bin == TYGS_WORK_BINS - 1)
+            printf(" %d+:%lu", 1 << (bin - 1), qt->workHist[bin]);
+        else if (bin == 1)
+            printf(" 1:%lu", qt->workHist[bin]);
+        else
+            printf(" %d-%d:%lu", 1 << (bin - 1), (1 << bin) - 1,
+                qt->workHist[bin]);
+    }
+    printf("\n");
+}
+
 void tyGSOctalReport()
 {
     int mod;
@@ -362,13 +456,16 @@ void tyGSOctalReport()
 
         printf("Module %d: carrier=%d slot=%d\n  %lu interrupts\n",
             mod, qt->carrier, qt->slot, qt->interruptCount);
+        tyGSOctalWorkReport(qt);
 
         for (port = 0; port < 8; port++) {
             TY_GSOCTAL_DEV *dev = &qt->dev[port];
 
             if (dev->created)
-                printf("  Port %d: %lu chars in, %lu chars out, %lu errors\n",
-                    port, dev->readCount, dev->writeCount, dev->errorCount);
+                printf("  Port %d: %lu chars in, %lu chars out, %lu errors\n"
+                    "          %lu rx batches, %lu tx batches\n",
+                    port, dev->readCount, dev->writeCount, dev->errorCount,
+                    dev->rxBatches, dev->txBatches);
         }
     }
 }